@@ -0,0 +1,617 @@
+#include "cpurasterizer.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define CPURASTERIZER_USE_SSE2
+#endif
+
+//! edge length of the square screen tiles in image pixels, rasterized independently of each other
+static const int TILE_SIZE = 64;
+//! pixel centers this far outside of a triangle (in barycentric coordinates) are still covered, avoids cracks between strip triangles
+static const float COVERAGE_EPSILON = -1e-6f;
+
+typedef CpuRasterizer::ClipVertex ClipVertex;
+
+//! \brief The RasterizerJob class. One stage of a CpuRasterizer frame for one track range or tile
+class RasterizerJob : public QRunnable
+{
+public:
+	enum Stage
+	{
+		TRANSFORM,
+		COUNT,
+		BIN,
+		RASTERIZE
+	};
+
+	RasterizerJob(CpuRasterizer *rasterizer, Stage stage, int index)
+		: rasterizer(rasterizer), stage(stage), index(index)
+	{
+	}
+
+	void run()
+	{
+		switch (stage) {
+		case TRANSFORM:
+			rasterizer->transformVertices(index);
+			break;
+		case COUNT:
+			rasterizer->countSegments(index);
+			break;
+		case BIN:
+			rasterizer->binSegments(index);
+			break;
+		case RASTERIZE:
+			rasterizer->rasterizeTile(index);
+			break;
+		}
+	}
+
+private:
+	CpuRasterizer *rasterizer;
+	Stage stage;
+	int index;
+};
+
+//! \brief a clip space vertex mapped to the (supersampled) image, y pointing down like in the image
+struct ScreenVertex
+{
+	double x;
+	double y;
+	float z; //!< normalized device coordinate depth
+	float invW; //!< for perspective correct interpolation
+	float vOverW;
+};
+
+//! \brief a screen space linear function a*x + b*y + c
+struct Plane
+{
+	float a;
+	float b;
+	float c;
+};
+
+//! \brief the fragment shader parameters of a frame
+struct FragmentConstants
+{
+	float nearPlane;
+	float farPlane;
+	bool orthogonal;
+	float lineWidthPercentageBlack;
+	float lineWidthDepthCueingFactor;
+	float lineHaloMaxDepth;
+	uint32_t colorLine;
+	uint32_t colorHalo;
+};
+
+//! \brief color and depth buffer of a tile, in supersampled pixels
+struct TileBuffer
+{
+	int originX; //!< of the tile in the supersampled image
+	int originY;
+	int size; //!< width and height of the buffers, a multiple of 4
+	int maxX; //!< last pixel of the tile inside of the image
+	int maxY;
+	float *depth;
+	uint32_t *color;
+};
+
+//! \brief outside bits of a clip space position for the 6 clip planes
+static inline int getOutcode(const glm::vec4 &p)
+{
+	return (p.x < -p.w ? 1 : 0) | (p.x > p.w ? 2 : 0) | (p.y < -p.w ? 4 : 0) | (p.y > p.w ? 8 : 0) | (p.z < -p.w ? 16 : 0) | (p.z > p.w ? 32 : 0);
+}
+
+//! \brief clip a triangle at the near plane, other planes are handled per pixel
+//! \param polygon the clipped polygon, up to 4 vertices
+//! \return number of polygon vertices, 0 if the triangle is in front of the near plane
+static int clipNearPlane(const ClipVertex *const triangle[3], ClipVertex *polygon)
+{
+	int numVertices = 0;
+	for (int i = 0; i < 3; ++i) {
+		const ClipVertex &a = *triangle[i];
+		const ClipVertex &b = *triangle[(i + 1) % 3];
+		const float distanceA = a.position.z + a.position.w;
+		const float distanceB = b.position.z + b.position.w;
+		if (distanceA >= 0)
+			polygon[numVertices++] = a;
+		if ((distanceA >= 0) != (distanceB >= 0)) {
+			const float t = distanceA / (distanceA - distanceB);
+			ClipVertex &clipped = polygon[numVertices++];
+			clipped.position = a.position + t * (b.position - a.position);
+			clipped.v = a.v + t * (b.v - a.v);
+			clipped.discard = 0;
+		}
+	}
+	return numVertices;
+}
+
+//! \brief viewport transformation of a clip space vertex in front of the near plane
+static inline ScreenVertex toScreen(const ClipVertex &vertex, int width, int height)
+{
+	ScreenVertex screen;
+	screen.invW = 1.0f / vertex.position.w;
+	screen.x = (vertex.position.x * screen.invW * 0.5 + 0.5) * width;
+	screen.y = (0.5 - vertex.position.y * screen.invW * 0.5) * height;
+	screen.z = vertex.position.z * screen.invW;
+	screen.vOverW = vertex.v * screen.invW;
+	return screen;
+}
+
+//! \brief linearized depth in [0,1] like getLinearizedFragmentDepth() of the fragment shader
+static inline float getLinearizedDepth(float zNDC, const FragmentConstants &constants)
+{
+	float viewZ;
+	if (constants.orthogonal)
+		viewZ = -0.5f * (zNDC * (constants.farPlane - constants.nearPlane) + constants.farPlane + constants.nearPlane);
+	else
+		viewZ = -2.0f * constants.farPlane * constants.nearPlane / (constants.farPlane + constants.nearPlane - zNDC * (constants.farPlane - constants.nearPlane));
+	return -(viewZ / 2.0f + 0.5f);
+}
+
+//! \brief rasterize a triangle into a tile with the depth-dependent halo shading of shader_lines_with_halos.frag
+static void rasterizeTriangle(const ScreenVertex &s0, const ScreenVertex &s1, const ScreenVertex &s2, const FragmentConstants &constants, TileBuffer &tile)
+{
+	// tile local coordinates keep the float plane equations precise
+	const double x0 = s0.x - tile.originX, y0 = s0.y - tile.originY;
+	const double x1 = s1.x - tile.originX, y1 = s1.y - tile.originY;
+	const double x2 = s2.x - tile.originX, y2 = s2.y - tile.originY;
+	const double area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+	if (!(std::abs(area) > 1e-12))
+		return;
+
+	// pixels whose centers are inside of the bounding box
+	const int minX = static_cast<int>(std::max(0.0, std::ceil(std::min(std::min(x0, x1), x2) - 0.5)));
+	const int maxX = static_cast<int>(std::min(double(tile.maxX), std::floor(std::max(std::max(x0, x1), x2) - 0.5)));
+	const int minY = static_cast<int>(std::max(0.0, std::ceil(std::min(std::min(y0, y1), y2) - 0.5)));
+	const int maxY = static_cast<int>(std::min(double(tile.maxY), std::floor(std::max(std::max(y0, y1), y2) - 0.5)));
+	if (minX > maxX || minY > maxY)
+		return;
+
+	// barycentric coordinates as planes, they are positive inside of the triangle for both windings
+	const double a[3] = { (y1 - y2) / area, (y2 - y0) / area, (y0 - y1) / area };
+	const double b[3] = { (x2 - x1) / area, (x0 - x2) / area, (x1 - x0) / area };
+	const double c[3] = { (x1 * y2 - y1 * x2) / area, (x2 * y0 - y2 * x0) / area, (x0 * y1 - y0 * x1) / area };
+	Plane barycentric[3];
+	for (int i = 0; i < 3; ++i)
+		barycentric[i] = { float(a[i]), float(b[i]), float(c[i]) };
+
+	// z is linear in screen space, v is interpolated perspective correct through v/w and 1/w
+	auto interpolate = [&](float f0, float f1, float f2) {
+		Plane plane = { float(f0 * a[0] + f1 * a[1] + f2 * a[2]), float(f0 * b[0] + f1 * b[1] + f2 * b[2]), float(f0 * c[0] + f1 * c[1] + f2 * c[2]) };
+		return plane;
+	};
+	const Plane z = interpolate(s0.z, s1.z, s2.z);
+	const Plane invW = interpolate(s0.invW, s1.invW, s2.invW);
+	const Plane vOverW = interpolate(s0.vOverW, s1.vOverW, s2.vOverW);
+
+#ifdef CPURASTERIZER_USE_SSE2
+	const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 epsilon = _mm_set1_ps(COVERAGE_EPSILON);
+	const __m128 one = _mm_set1_ps(1.0f);
+	const __m128 minusOne = _mm_set1_ps(-1.0f);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+	const __m128 nearPlane = _mm_set1_ps(constants.nearPlane);
+	const __m128 farPlane = _mm_set1_ps(constants.farPlane);
+	const __m128 percentageBlack = _mm_set1_ps(constants.lineWidthPercentageBlack);
+	const __m128 depthCueingFactor = _mm_set1_ps(constants.lineWidthDepthCueingFactor);
+	const __m128 haloMaxDepth = _mm_set1_ps(constants.lineHaloMaxDepth);
+	const __m128i colorLine = _mm_set1_epi32(static_cast<int>(constants.colorLine));
+	const __m128i colorHalo = _mm_set1_epi32(static_cast<int>(constants.colorHalo));
+
+	for (int y = minY; y <= maxY; ++y) {
+		const float centerY = y + 0.5f;
+		const __m128 b0Row = _mm_set1_ps(barycentric[0].b * centerY + barycentric[0].c);
+		const __m128 b1Row = _mm_set1_ps(barycentric[1].b * centerY + barycentric[1].c);
+		const __m128 b2Row = _mm_set1_ps(barycentric[2].b * centerY + barycentric[2].c);
+		const __m128 zRow = _mm_set1_ps(z.b * centerY + z.c);
+		const __m128 invWRow = _mm_set1_ps(invW.b * centerY + invW.c);
+		const __m128 vOverWRow = _mm_set1_ps(vOverW.b * centerY + vOverW.c);
+		float *depthRow = tile.depth + y * tile.size;
+		uint32_t *colorRow = tile.color + y * tile.size;
+
+		// 4 pixels at a time, the tile buffers are padded to a multiple of 4
+		for (int x = minX & ~3; x <= maxX; x += 4) {
+			const __m128 centerX = _mm_add_ps(_mm_set1_ps(float(x)), laneOffsets);
+
+			// EDGE FUNCTIONS
+			const __m128 b0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(barycentric[0].a), centerX), b0Row);
+			const __m128 b1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(barycentric[1].a), centerX), b1Row);
+			const __m128 b2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(barycentric[2].a), centerX), b2Row);
+			__m128 covered = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(b0, epsilon), _mm_cmpge_ps(b1, epsilon)), _mm_cmpge_ps(b2, epsilon));
+			if (_mm_movemask_ps(covered) == 0)
+				continue;
+
+			// clip at the far plane (and near plane rounding) like the clipper does
+			const __m128 zNDC = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(z.a), centerX), zRow);
+			covered = _mm_and_ps(covered, _mm_and_ps(_mm_cmpge_ps(zNDC, minusOne), _mm_cmple_ps(zNDC, one)));
+
+			// LINEARIZED DEPTH
+			__m128 viewZ;
+			if (constants.orthogonal)
+				viewZ = _mm_mul_ps(_mm_set1_ps(-0.5f), _mm_add_ps(_mm_mul_ps(zNDC, _mm_sub_ps(farPlane, nearPlane)), _mm_add_ps(farPlane, nearPlane)));
+			else
+				viewZ = _mm_div_ps(_mm_set1_ps(-2.0f * constants.farPlane * constants.nearPlane),
+								   _mm_sub_ps(_mm_add_ps(farPlane, nearPlane), _mm_mul_ps(zNDC, _mm_sub_ps(farPlane, nearPlane))));
+			const __m128 depth = _mm_sub_ps(zero, _mm_add_ps(_mm_mul_ps(viewZ, half), half));
+
+			// DEPTH-DEPENDENT HALOS
+			const __m128 invWValue = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(invW.a), centerX), invWRow);
+			const __m128 vOverWValue = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(vOverW.a), centerX), vOverWRow);
+			const __m128 v = _mm_div_ps(vOverWValue, invWValue);
+			const __m128 offset = _mm_mul_ps(_mm_set1_ps(2.0f), _mm_and_ps(_mm_sub_ps(v, half), absMask));
+			const __m128 offsetThreshold = _mm_mul_ps(percentageBlack, _mm_sub_ps(one, _mm_mul_ps(depth, depthCueingFactor)));
+			const __m128 isLine = _mm_cmplt_ps(offset, offsetThreshold);
+			__m128 fragmentDepth = _mm_or_ps(_mm_and_ps(isLine, depth), _mm_andnot_ps(isLine, _mm_add_ps(depth, _mm_mul_ps(offset, haloMaxDepth))));
+			fragmentDepth = _mm_min_ps(_mm_max_ps(fragmentDepth, zero), one); // depth buffer range
+
+			// DEPTH TEST (GL_LESS)
+			const __m128 oldDepth = _mm_loadu_ps(depthRow + x);
+			const __m128 pass = _mm_and_ps(covered, _mm_cmplt_ps(fragmentDepth, oldDepth));
+			_mm_storeu_ps(depthRow + x, _mm_or_ps(_mm_and_ps(pass, fragmentDepth), _mm_andnot_ps(pass, oldDepth)));
+
+			const __m128i passMask = _mm_castps_si128(pass);
+			const __m128i lineMask = _mm_castps_si128(isLine);
+			const __m128i color = _mm_or_si128(_mm_and_si128(lineMask, colorLine), _mm_andnot_si128(lineMask, colorHalo));
+			const __m128i oldColor = _mm_loadu_si128(reinterpret_cast<const __m128i*>(colorRow + x));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(colorRow + x), _mm_or_si128(_mm_and_si128(passMask, color), _mm_andnot_si128(passMask, oldColor)));
+		}
+	}
+#else
+	for (int y = minY; y <= maxY; ++y) {
+		const float centerY = y + 0.5f;
+		float *depthRow = tile.depth + y * tile.size;
+		uint32_t *colorRow = tile.color + y * tile.size;
+		for (int x = minX; x <= maxX; ++x) {
+			const float centerX = x + 0.5f;
+			if (barycentric[0].a * centerX + barycentric[0].b * centerY + barycentric[0].c < COVERAGE_EPSILON
+					|| barycentric[1].a * centerX + barycentric[1].b * centerY + barycentric[1].c < COVERAGE_EPSILON
+					|| barycentric[2].a * centerX + barycentric[2].b * centerY + barycentric[2].c < COVERAGE_EPSILON)
+				continue;
+			const float zNDC = z.a * centerX + z.b * centerY + z.c;
+			if (zNDC < -1.0f || zNDC > 1.0f)
+				continue;
+
+			const float depth = getLinearizedDepth(zNDC, constants);
+			const float v = (vOverW.a * centerX + vOverW.b * centerY + vOverW.c) / (invW.a * centerX + invW.b * centerY + invW.c);
+			const float offset = 2.0f * std::abs(v - 0.5f);
+			const float offsetThreshold = constants.lineWidthPercentageBlack * (1.0f - depth * constants.lineWidthDepthCueingFactor);
+			const bool isLine = offset < offsetThreshold;
+			const float fragmentDepth = glm::clamp(isLine ? depth : depth + offset * constants.lineHaloMaxDepth, 0.0f, 1.0f);
+			if (fragmentDepth < depthRow[x]) {
+				depthRow[x] = fragmentDepth;
+				colorRow[x] = isLine ? constants.colorLine : constants.colorHalo;
+			}
+		}
+	}
+#endif
+}
+
+//! \brief pack a color with components in [0,1]
+static inline uint32_t packColor(const glm::vec3 &color)
+{
+	glm::vec3 c = glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f;
+	return qRgb(int(c.r), int(c.g), int(c.b));
+}
+
+CpuRasterizer::CpuRasterizer(int width, int height, int samples)
+		: PoseRenderer(width, height)
+{
+	supersampling = std::max(1, static_cast<int>(std::floor(std::sqrt(float(std::max(samples, 1))) + 0.5f)));
+	numTilesX = (width + TILE_SIZE - 1) / TILE_SIZE;
+	numTilesY = (height + TILE_SIZE - 1) / TILE_SIZE;
+	frameParameters = nullptr;
+	frameBits = nullptr;
+	frameBytesPerLine = 0;
+	jobFirstTracks.assign(1, 0); // no tracks until setLines()
+	tileJobOffsets.assign(1, 0);
+}
+
+void CpuRasterizer::setLines(const LineData &lines)
+{
+	const size_t numPoints = lines.positions.size();
+	lineVertices.resize(2 * numPoints);
+	if (numPoints > 0)
+		generateTrackLineVerticesParallel(&lines.positions[0], &lines.trackOffsets[0], lines.getNumTracks(), &lineVertices[0]);
+
+	// each track is its own triangle strip, the tracks of a group are drawn together like in OffscreenRenderer
+	std::vector<LineGroup> groups;
+	appendLineGroups(lines, 0, groups);
+	trackFirstVertices.clear();
+	trackNumVertices.clear();
+	jobFirstTracks.clear();
+	jobBoundsMin.clear();
+	jobBoundsMax.clear();
+
+	// split the tracks of each group into ranges of similar vertex count, a few per thread to balance groups of different size,
+	// a job has the bounds of its group, so jobs outside of the view frustum are skipped
+	const int64_t jobNumVertices = std::max<int64_t>(lineVertices.size() / (4 * std::max(threadPool.maxThreadCount(), 1)), 1 << 15);
+	for (const LineGroup &group : groups) {
+		int64_t jobVertices = jobNumVertices;
+		for (size_t i = 0; i < group.trackFirstVertices.size(); ++i) {
+			if (jobVertices >= jobNumVertices) {
+				jobFirstTracks.push_back(trackFirstVertices.size());
+				jobBoundsMin.push_back(group.boundsMin);
+				jobBoundsMax.push_back(group.boundsMax);
+				jobVertices = 0;
+			}
+			trackFirstVertices.push_back(static_cast<uint32_t>(group.trackFirstVertices[i]));
+			trackNumVertices.push_back(static_cast<uint32_t>(group.trackNumVertices[i]));
+			jobVertices += group.trackNumVertices[i];
+		}
+	}
+	jobFirstTracks.push_back(trackFirstVertices.size());
+	jobVisible.assign(jobBoundsMin.size(), 0);
+
+	clipVertices.resize(lineVertices.size());
+	const size_t numBins = (jobFirstTracks.size() - 1) * numTilesX * numTilesY;
+	jobTileCounts.assign(numBins, 0);
+	tileJobOffsets.assign(numBins + 1, 0);
+	std::vector<uint32_t>().swap(binnedSegments);
+}
+
+QImage CpuRasterizer::renderFrame(const LineRenderParameters &parameters)
+{
+	frameParameters = &parameters;
+	const int numJobs = static_cast<int>(jobFirstTracks.size()) - 1;
+
+	// the view aligned strips extend half their width beyond the line points
+	glm::vec4 frustumPlanes[6];
+	getFrustumPlanes(parameters.viewProjMat, frustumPlanes);
+	for (int job = 0; job < numJobs; ++job) {
+		jobVisible[job] = isBoxInFrustum(jobBoundsMin[job] - 0.5f * parameters.lineTriangleStripWidth,
+										 jobBoundsMax[job] + 0.5f * parameters.lineTriangleStripWidth, frustumPlanes) ? 1 : 0;
+	}
+
+	for (int job = 0; job < numJobs; ++job)
+		threadPool.start(new RasterizerJob(this, RasterizerJob::TRANSFORM, job));
+	threadPool.waitForDone();
+
+	for (int job = 0; job < numJobs; ++job)
+		threadPool.start(new RasterizerJob(this, RasterizerJob::COUNT, job));
+	threadPool.waitForDone();
+
+	// the segments of a tile are contiguous, ordered by job like they are drawn.
+	// the counts of a job become its write positions in each tile
+	const int numTiles = numTilesX * numTilesY;
+	size_t numBinned = 0;
+	for (int tile = 0; tile < numTiles; ++tile) {
+		for (int job = 0; job < numJobs; ++job) {
+			size_t &count = jobTileCounts[job * numTiles + tile];
+			tileJobOffsets[tile * numJobs + job] = numBinned;
+			numBinned += count;
+			count = tileJobOffsets[tile * numJobs + job];
+		}
+	}
+	tileJobOffsets[numTiles * numJobs] = numBinned;
+
+	// zoomed in views bin many segments into several tiles, do not keep far more memory than the current frame needs
+	if (binnedSegments.capacity() > 2 * numBinned)
+		std::vector<uint32_t>().swap(binnedSegments);
+	binnedSegments.resize(numBinned);
+	for (int job = 0; job < numJobs; ++job)
+		threadPool.start(new RasterizerJob(this, RasterizerJob::BIN, job));
+	threadPool.waitForDone();
+
+	// the tiles write disjoint pixels of the image, so it is detached once here instead of in each tile
+	QImage image(width, height, QImage::Format_RGB32);
+	frameBits = image.bits();
+	frameBytesPerLine = image.bytesPerLine();
+	for (int tile = 0; tile < numTilesX * numTilesY; ++tile)
+		threadPool.start(new RasterizerJob(this, RasterizerJob::RASTERIZE, tile));
+	threadPool.waitForDone();
+
+	frameParameters = nullptr;
+	frameBits = nullptr;
+	return image;
+}
+
+void CpuRasterizer::setMaxThreadCount(int maxThreadCount)
+{
+	threadPool.setMaxThreadCount(maxThreadCount);
+}
+
+void CpuRasterizer::transformVertices(int job)
+{
+	// VIEW ALIGNED TRIANGLE STRIPS, see shader_lines_with_halos.vert
+	if (!jobVisible[job])
+		return;
+
+	const LineRenderParameters &parameters = *frameParameters;
+	for (size_t track = jobFirstTracks[job]; track < jobFirstTracks[job + 1]; ++track) {
+		const uint32_t end = trackFirstVertices[track] + trackNumVertices[track];
+		for (uint32_t i = trackFirstVertices[track]; i < end; ++i) {
+			const LineVertex &vertex = lineVertices[i];
+			glm::vec3 perpendicular = glm::cross(vertex.pos - parameters.cameraPos, vertex.directionToNext);
+			const float length = glm::length(perpendicular);
+			perpendicular = length > 0 ? perpendicular / length : glm::vec3(0);
+			const glm::vec3 viewAlignedPosition = vertex.pos + perpendicular * (vertex.uv.y - 0.5f) * parameters.lineTriangleStripWidth;
+
+			ClipVertex &clipVertex = clipVertices[i];
+			clipVertex.position = parameters.viewProjMat * glm::vec4(viewAlignedPosition, 1.0f);
+			clipVertex.v = vertex.uv.y;
+			clipVertex.discard = glm::dot(viewAlignedPosition, parameters.clipPlaneNormal) > parameters.clipPlaneDistance ? 1 : 0;
+		}
+	}
+}
+
+bool CpuRasterizer::getSegmentTiles(uint32_t first, int tiles[4]) const
+{
+	const int superWidth = width * supersampling;
+	const int superHeight = height * supersampling;
+	const int tileSize = TILE_SIZE * supersampling;
+
+	// a segment is the quad of the two strip triangles between two line points
+	const ClipVertex *vertices = &clipVertices[first];
+
+	// the fragment shader discards a triangle if any of its vertices is behind the clip plane
+	if ((vertices[0].discard | vertices[1].discard | vertices[2].discard) & (vertices[1].discard | vertices[2].discard | vertices[3].discard))
+		return false;
+	if (getOutcode(vertices[0].position) & getOutcode(vertices[1].position) & getOutcode(vertices[2].position) & getOutcode(vertices[3].position))
+		return false;
+
+	double minX = std::numeric_limits<double>::max(), maxX = -minX, minY = minX, maxY = -minX;
+	auto extend = [&](const ClipVertex &vertex) {
+		ScreenVertex screen = toScreen(vertex, superWidth, superHeight);
+		minX = std::min(minX, screen.x);
+		maxX = std::max(maxX, screen.x);
+		minY = std::min(minY, screen.y);
+		maxY = std::max(maxY, screen.y);
+	};
+	bool crossesNearPlane = false;
+	for (int i = 0; i < 4; ++i)
+		crossesNearPlane |= vertices[i].position.z + vertices[i].position.w < 0;
+	if (!crossesNearPlane) {
+		for (int i = 0; i < 4; ++i)
+			extend(vertices[i]);
+	}
+	else {
+		for (int i = 0; i < 2; ++i) {
+			const ClipVertex *triangle[3] = { &vertices[i], &vertices[i + 1], &vertices[i + 2] };
+			ClipVertex polygon[4];
+			const int numVertices = clipNearPlane(triangle, polygon);
+			for (int j = 0; j < numVertices; ++j)
+				extend(polygon[j]);
+		}
+		if (minX > maxX)
+			return false;
+	}
+
+	// tiles with pixel centers inside of the bounding box
+	const double firstPixelX = std::max(0.0, std::ceil(minX - 0.5));
+	const double lastPixelX = std::min(double(superWidth - 1), std::floor(maxX - 0.5));
+	const double firstPixelY = std::max(0.0, std::ceil(minY - 0.5));
+	const double lastPixelY = std::min(double(superHeight - 1), std::floor(maxY - 0.5));
+	if (firstPixelX > lastPixelX || firstPixelY > lastPixelY)
+		return false;
+	tiles[0] = static_cast<int>(firstPixelX) / tileSize;
+	tiles[1] = static_cast<int>(lastPixelX) / tileSize;
+	tiles[2] = static_cast<int>(firstPixelY) / tileSize;
+	tiles[3] = static_cast<int>(lastPixelY) / tileSize;
+	return true;
+}
+
+void CpuRasterizer::countSegments(int job)
+{
+	const int numTiles = numTilesX * numTilesY;
+	size_t *counts = &jobTileCounts[job * numTiles];
+	std::fill(counts, counts + numTiles, 0);
+	if (!jobVisible[job])
+		return;
+
+	int tiles[4];
+	for (size_t track = jobFirstTracks[job]; track < jobFirstTracks[job + 1]; ++track) {
+		const uint32_t end = trackFirstVertices[track] + trackNumVertices[track];
+		for (uint32_t first = trackFirstVertices[track]; first + 3 < end; first += 2) {
+			if (!getSegmentTiles(first, tiles))
+				continue;
+			for (int tileY = tiles[2]; tileY <= tiles[3]; ++tileY) {
+				for (int tileX = tiles[0]; tileX <= tiles[1]; ++tileX)
+					++counts[tileY * numTilesX + tileX];
+			}
+		}
+	}
+}
+
+void CpuRasterizer::binSegments(int job)
+{
+	// the same segments as countSegments(), each job and tile writes its own range of binnedSegments
+	if (!jobVisible[job])
+		return;
+
+	size_t *positions = &jobTileCounts[job * numTilesX * numTilesY];
+	int tiles[4];
+	for (size_t track = jobFirstTracks[job]; track < jobFirstTracks[job + 1]; ++track) {
+		const uint32_t end = trackFirstVertices[track] + trackNumVertices[track];
+		for (uint32_t first = trackFirstVertices[track]; first + 3 < end; first += 2) {
+			if (!getSegmentTiles(first, tiles))
+				continue;
+			for (int tileY = tiles[2]; tileY <= tiles[3]; ++tileY) {
+				for (int tileX = tiles[0]; tileX <= tiles[1]; ++tileX)
+					binnedSegments[positions[tileY * numTilesX + tileX]++] = first;
+			}
+		}
+	}
+}
+
+void CpuRasterizer::rasterizeTile(int tile)
+{
+	const LineRenderParameters &parameters = *frameParameters;
+	FragmentConstants constants;
+	constants.nearPlane = parameters.nearPlane;
+	constants.farPlane = parameters.farPlane;
+	constants.orthogonal = parameters.orthogonal != 0;
+	constants.lineWidthPercentageBlack = parameters.lineWidthPercentageBlack;
+	constants.lineWidthDepthCueingFactor = parameters.lineWidthDepthCueingFactor;
+	constants.lineHaloMaxDepth = parameters.lineHaloMaxDepth;
+	constants.colorLine = packColor(parameters.colorLine);
+	constants.colorHalo = packColor(parameters.colorHalo);
+
+	const int superWidth = width * supersampling;
+	const int superHeight = height * supersampling;
+	const int tileX = tile % numTilesX;
+	const int tileY = tile / numTilesX;
+	TileBuffer buffer;
+	buffer.size = TILE_SIZE * supersampling;
+	buffer.originX = tileX * buffer.size;
+	buffer.originY = tileY * buffer.size;
+	buffer.maxX = std::min(buffer.size, superWidth - buffer.originX) - 1;
+	buffer.maxY = std::min(buffer.size, superHeight - buffer.originY) - 1;
+
+	// cleared like the framebuffer of OffscreenRenderer: white, far depth
+	std::vector<float> depth(buffer.size * buffer.size, 1.0f);
+	std::vector<uint32_t> color(buffer.size * buffer.size, qRgb(255, 255, 255));
+	buffer.depth = &depth[0];
+	buffer.color = &color[0];
+
+	// the segments of all jobs in drawing order
+	const size_t numJobs = jobFirstTracks.size() - 1;
+	for (size_t i = tileJobOffsets[tile * numJobs]; i < tileJobOffsets[(tile + 1) * numJobs]; ++i) {
+		for (uint32_t first = binnedSegments[i]; first < binnedSegments[i] + 2; ++first) {
+			const ClipVertex *triangle[3] = { &clipVertices[first], &clipVertices[first + 1], &clipVertices[first + 2] };
+			if (triangle[0]->discard | triangle[1]->discard | triangle[2]->discard)
+				continue;
+
+			if (triangle[0]->position.z + triangle[0]->position.w >= 0 && triangle[1]->position.z + triangle[1]->position.w >= 0
+					&& triangle[2]->position.z + triangle[2]->position.w >= 0) {
+				rasterizeTriangle(toScreen(*triangle[0], superWidth, superHeight), toScreen(*triangle[1], superWidth, superHeight),
+								  toScreen(*triangle[2], superWidth, superHeight), constants, buffer);
+				continue;
+			}
+
+			// clipped at the near plane into a fan of up to two triangles
+			ClipVertex polygon[4];
+			const int numVertices = clipNearPlane(triangle, polygon);
+			for (int j = 2; j < numVertices; ++j) {
+				rasterizeTriangle(toScreen(polygon[0], superWidth, superHeight), toScreen(polygon[j - 1], superWidth, superHeight),
+								  toScreen(polygon[j], superWidth, superHeight), constants, buffer);
+			}
+		}
+	}
+
+	// resolve the samples of each pixel into the image
+	const int numSamples = supersampling * supersampling;
+	for (int y = 0; y * supersampling <= buffer.maxY; ++y) {
+		uint32_t *imageRow = reinterpret_cast<uint32_t*>(frameBits + (tileY * TILE_SIZE + y) * frameBytesPerLine) + tileX * TILE_SIZE;
+		for (int x = 0; x * supersampling <= buffer.maxX; ++x) {
+			int red = 0, green = 0, blue = 0;
+			for (int sampleY = 0; sampleY < supersampling; ++sampleY) {
+				const uint32_t *samples = &color[(y * supersampling + sampleY) * buffer.size + x * supersampling];
+				for (int sampleX = 0; sampleX < supersampling; ++sampleX) {
+					red += qRed(samples[sampleX]);
+					green += qGreen(samples[sampleX]);
+					blue += qBlue(samples[sampleX]);
+				}
+			}
+			imageRow[x] = qRgb((red + numSamples / 2) / numSamples, (green + numSamples / 2) / numSamples, (blue + numSamples / 2) / numSamples);
+		}
+	}
+}
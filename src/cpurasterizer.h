@@ -0,0 +1,92 @@
+#ifndef CPURASTERIZER_H
+#define CPURASTERIZER_H
+
+#include <QImage>
+#include <QThreadPool>
+
+#include <vector>
+#include <stdint.h>
+
+#include "linedata.h"
+#include "linevertex.h"
+#include "offscreenrenderer.h"
+
+class RasterizerJob;
+
+//! \brief The CpuRasterizer class.
+//!
+//! Renders lines with depth-dependent halos without any GPU, reproducing shader_lines_with_halos.vert/.frag:
+//! view aligned triangle strips, the black line and white halo split by lineWidthPercentageBlack,
+//! depth-cued line thinning and the depth displacement of halo fragments.
+//! A frame is rendered in three parallel stages on a thread pool:
+//! the strip vertices of the line groups inside of the view frustum are transformed like in the vertex shader,
+//! the strip segments (two triangles between two line points) are binned into the screen tiles they overlap
+//! (counted per job and tile first, then written into one flat array in drawing order),
+//! then each tile rasterizes its segments in drawing order into its own color and depth buffer,
+//! evaluating edge functions and depth of 4 pixels at a time with SSE2.
+//! Tiles share no state, so rendering scales with the number of cores.
+//! Antialiasing supersamples each pixel on a regular grid instead of MSAA, scalars are not drawn.
+class CpuRasterizer : public PoseRenderer
+{
+	friend class RasterizerJob;
+
+public:
+	//! \param samples samples per pixel, rounded to a square supersampling grid (8 samples become 3x3), 0 disables antialiasing
+	CpuRasterizer(int width, int height, int samples);
+
+	//! \brief generate the strip vertices of the tracks, replaces the previous ones
+	void setLines(const LineData &lines);
+
+	QImage renderFrame(const LineRenderParameters &parameters);
+
+	//! \brief number of threads rendering a frame, the number of cores by default
+	void setMaxThreadCount(int maxThreadCount);
+
+	//! \brief The ClipVertex struct. A strip vertex transformed by the vertex shader
+	struct ClipVertex
+	{
+		glm::vec4 position; //!< clip space position
+		float v; //!< uv v-coordinate, side of the triangle strip
+		uint32_t discard; //!< behind the clip plane
+	};
+
+private:
+
+	//! \brief transform the strip vertices of the tracks of a job into clipVertices
+	void transformVertices(int job);
+	//! \brief count the strip segments of the tracks of a job in each tile they overlap
+	void countSegments(int job);
+	//! \brief write the strip segments of the tracks of a job into binnedSegments at the offsets of their tiles
+	void binSegments(int job);
+	//! \brief tiles overlapped by the strip segment starting at the given strip vertex
+	//! \param tiles first and last tile along x, first and last tile along y
+	//! \return false if the segment is not drawn
+	bool getSegmentTiles(uint32_t first, int tiles[4]) const;
+	//! \brief rasterize all segments binned into a tile into the frame image
+	void rasterizeTile(int tile);
+
+	int supersampling; // samples per pixel along x and y
+	int numTilesX;
+	int numTilesY;
+
+	std::vector<LineVertex> lineVertices; // two strip vertices per line point, see generateTrackLineVertices()
+	std::vector<uint32_t> trackFirstVertices; // first strip vertex of each track with at least 2 points
+	std::vector<uint32_t> trackNumVertices; // number of strip vertices of each track
+	std::vector<size_t> jobFirstTracks; // tracks of job i are jobFirstTracks[i] to jobFirstTracks[i+1], one more than jobs
+	std::vector<glm::vec3> jobBoundsMin; // bounding box of the line group of each job
+	std::vector<glm::vec3> jobBoundsMax;
+	std::vector<char> jobVisible; // whether the bounding box of each job is inside of the view frustum of the current frame
+
+	std::vector<ClipVertex> clipVertices; // of the current frame, same indices as lineVertices
+	std::vector<size_t> jobTileCounts; // per job and tile: number of binned segments, then the next write position in binnedSegments
+	std::vector<size_t> tileJobOffsets; // per tile and job: first binned segment in binnedSegments, one more than tiles*jobs
+	std::vector<uint32_t> binnedSegments; // first strip vertex of the segments of each tile, in drawing order
+	const LineRenderParameters *frameParameters; // of the current frame
+	uchar *frameBits; // pixels of the image of the current frame
+	int frameBytesPerLine;
+
+	QThreadPool threadPool;
+
+};
+
+#endif // CPURASTERIZER_H
@@ -2,11 +2,30 @@
 
 #include <QMouseEvent>
 #include <QDir>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 
 #include "mainwindow.h"
 
+//! uniform buffer binding point of the LineRenderParameters block
+static const GLuint LINE_RENDER_PARAMETERS_BINDING = 0;
+
+//! the camera is considered to have stopped when it did not change for this many milliseconds
+static const int INTERACTION_END_DELAY = 150;
+//! refinement after the camera stopped is done in at most this many frames
+static const int MAX_REFINEMENT_FRAMES = 4;
+
+//! interactionPointBudget is adapted between these limits
+static const size_t MIN_INTERACTION_POINT_BUDGET = 100000;
+static const size_t MAX_INTERACTION_POINT_BUDGET = 100000000;
+//! lodPixelError is adapted between these limits, at the lower one decimation is not noticeable
+static const float MIN_LOD_PIXEL_ERROR = 0.5f;
+static const float MAX_LOD_PIXEL_ERROR = 4.0f;
+
 GLWidget::GLWidget(QWidget *parent, MainWindow *mainWindow)
 		: QOpenGLWidget(parent)
 {
@@ -17,7 +36,9 @@ GLWidget::GLWidget(QWidget *parent, MainWindow *mainWindow)
 	connect(this, &GLWidget::totalGPUMemoryChanged, mainWindow, &MainWindow::displayTotalGPUMemory);
 	connect(this, &GLWidget::usedGPUMemoryChanged, mainWindow, &MainWindow::displayUsedGPUMemory);
 	connect(this, &GLWidget::fpsChanged, mainWindow, &MainWindow::displayFPS);
+	connect(this, &GLWidget::frameTimeChanged, mainWindow, &MainWindow::displayFrameTime);
 	connect(this, &GLWidget::graphicsDeviceInfoChanged, mainWindow, &MainWindow::displayGraphicsDeviceInfo);
+	connect(this, &GLWidget::lineVertexFormatChanged, mainWindow, &MainWindow::displayLineVertexFormat);
 
 	renderMode = RenderMode::NONE;
 	lineTriangleStripWidth = 0.03f;
@@ -27,8 +48,36 @@ GLWidget::GLWidget(QWidget *parent, MainWindow *mainWindow)
 	enableClipping = false;
 	updateClipPlaneNormal();
 	clipPlaneDistance = 0;
-
-	nrLines = 0;
+	colorByScalar = false;
+	scalarRange = glm::vec2(0, 1);
+
+	lineData = nullptr;
+	lineVertexFormat = LineVertexFormat::PULLED_POSITIONS;
+	numLinePoints = 0;
+	linePointCapacity = 0;
+	lineStreamCapacity = 0;
+	lodPixelError = 0.5f;
+	interactionPointBudget = 2000000;
+	adaptiveQuality = true;
+	targetFrameTime = 16.0f;
+	cameraMoving = false;
+	refining = false;
+	progressiveFrame = 0;
+	interactionTimer.setSingleShot(true);
+	connect(&interactionTimer, &QTimer::timeout, this, &GLWidget::interactionEnded);
+
+	// keep the framebuffer between frames, refinement frames draw on top of the previous ones
+	setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+	numLineScalars = 0;
+	lineRange.firstPoint = 0;
+	lineRange.numPoints = 0;
+	lineRange.tolerance = 0;
+	gl33 = nullptr;
+	tboLinePositions = 0;
+	tboLineScalars = 0;
+	tboLineTrackFlags = 0;
+	uboLineRenderParameters = 0;
+	lineRenderParametersValid = false;
 
 }
 
@@ -45,6 +94,71 @@ void GLWidget::initShaders()
 	shaderLinesWithHalos->addShaderFromSourceFile(QOpenGLShader::Fragment, buildDir + "/shaders/shader_lines_with_halos.frag");
 	shaderLinesWithHalos->link();
 
+	shaderLinesWithHalosPulled = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
+	shaderLinesWithHalosPulled->addShaderFromSourceFile(QOpenGLShader::Vertex, buildDir + "/shaders/shader_lines_with_halos_pulled.vert");
+	shaderLinesWithHalosPulled->addShaderFromSourceFile(QOpenGLShader::Fragment, buildDir + "/shaders/shader_lines_with_halos.frag");
+	shaderLinesWithHalosPulled->link();
+
+	shaderLinesWithHalosPacked = new QOpenGLShaderProgram(QOpenGLContext::currentContext());
+	shaderLinesWithHalosPacked->addShaderFromSourceFile(QOpenGLShader::Vertex, buildDir + "/shaders/shader_lines_with_halos_packed.vert");
+	shaderLinesWithHalosPacked->addShaderFromSourceFile(QOpenGLShader::Fragment, buildDir + "/shaders/shader_lines_with_halos.frag");
+	shaderLinesWithHalosPacked->link();
+
+	// uniform locations are resolved once here: the per frame state is in a uniform block, the samplers never change
+	bindLineRenderParameters(shaderLinesWithHalos);
+	bindLineRenderParameters(shaderLinesWithHalosPulled);
+	bindLineRenderParameters(shaderLinesWithHalosPacked);
+
+	// line points, scalars and track flags are fetched from buffer textures in texture units 0, 1 and 2
+	shaderLinesWithHalosPulled->bind();
+	shaderLinesWithHalosPulled->setUniformValue(shaderLinesWithHalosPulled->uniformLocation("linePositions"), 0);
+	shaderLinesWithHalosPulled->setUniformValue(shaderLinesWithHalosPulled->uniformLocation("lineScalars"), 1);
+	shaderLinesWithHalosPulled->setUniformValue(shaderLinesWithHalosPulled->uniformLocation("lineTrackFlags"), 2);
+	shaderLinesWithHalosPulled->release();
+
+}
+
+void GLWidget::bindLineRenderParameters(QOpenGLShaderProgram *shader)
+{
+	QOpenGLExtraFunctions *glx = QOpenGLContext::currentContext()->extraFunctions();
+	GLuint blockIndex = glx->glGetUniformBlockIndex(shader->programId(), "LineRenderParameters");
+	if (blockIndex == GL_INVALID_INDEX) {
+		qDebug() << "line shader has no LineRenderParameters uniform block";
+		return;
+	}
+	glx->glUniformBlockBinding(shader->programId(), blockIndex, LINE_RENDER_PARAMETERS_BINDING);
+}
+
+bool GLWidget::updateLineRenderParameters()
+{
+	LineRenderParameters parameters;
+	parameters.viewProjMat = camera.getProjectionMatrix() * camera.getViewMatrix();
+	parameters.cameraPos = camera.getPosition();
+	parameters.lineTriangleStripWidth = lineTriangleStripWidth;
+	parameters.clipPlaneNormal = enableClipping ? clipPlaneNormal : glm::vec3(0);
+	parameters.clipPlaneDistance = clipPlaneDistance;
+	parameters.colorLine = glm::vec3(0.0f, 0.0f, 0.0f);
+	parameters.lineWidthPercentageBlack = lineWidthPercentageBlack;
+	parameters.colorHalo = glm::vec3(1.0f, 1.0f, 1.0f);
+	parameters.lineWidthDepthCueingFactor = lineWidthDepthCueingFactor;
+	parameters.scalarRange = scalarRange;
+	parameters.lineHaloMaxDepth = lineHaloMaxDepth;
+	parameters.positionRange = packedPositionRange;
+	parameters.nearPlane = camera.getNearPlane();
+	parameters.farPlane = camera.getFarPlane();
+	parameters.orthogonal = camera.isOrthogonal() ? 1 : 0;
+	parameters.colorByScalar = colorByScalar && numLineScalars > 0 ? 1 : 0;
+
+	// all members are 4 byte scalars without padding, so equal values compare equal bytewise
+	if (lineRenderParametersValid && memcmp(&parameters, &lineRenderParameters, sizeof(parameters)) == 0)
+		return false;
+
+	glBindBuffer(GL_UNIFORM_BUFFER, uboLineRenderParameters);
+	glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(parameters), &parameters);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	lineRenderParameters = parameters;
+	lineRenderParametersValid = true;
+	return true;
 }
 
 void GLWidget::cleanup()
@@ -53,7 +167,17 @@ void GLWidget::cleanup()
 	makeCurrent();
 
 	vaoLines.destroy();
+	vaoLinesPulled.destroy();
+	if (gl33) {
+		gl33->glDeleteTextures(1, &tboLinePositions);
+		gl33->glDeleteTextures(1, &tboLineScalars);
+		gl33->glDeleteTextures(1, &tboLineTrackFlags);
+		gl33->glDeleteQueries(2, frameTimeQueries);
+	}
+	glDeleteBuffers(1, &uboLineRenderParameters);
 	shaderLinesWithHalos = nullptr;
+	shaderLinesWithHalosPulled = nullptr;
+	shaderLinesWithHalosPacked = nullptr;
 
 	doneCurrent();
 }
@@ -76,12 +200,34 @@ void GLWidget::initializeGL()
 	connect(logger, &QOpenGLDebugLogger::messageLogged, this, &GLWidget::printDebugMsg);
 	logger->startLogging();
 
-	if (!vaoLines.create()) {
+	if (!vaoLines.create() || !vaoLinesPulled.create()) {
 		qDebug() << "error creating vao";
 	}
 
+	// buffer textures for pulling line points in the vertex shader
+	gl33 = context()->versionFunctions<QOpenGLFunctions_3_3_Core>();
+	if (gl33 && gl33->initializeOpenGLFunctions()) {
+		gl33->glGenTextures(1, &tboLinePositions);
+		gl33->glGenTextures(1, &tboLineScalars);
+		gl33->glGenTextures(1, &tboLineTrackFlags);
+		gl33->glGenQueries(2, frameTimeQueries);
+	}
+	else {
+		gl33 = nullptr;
+		lineVertexFormat = LineVertexFormat::FLOAT_VERTICES;
+		qDebug() << "OpenGL 3.3 core functions not available, using float line vertices";
+	}
+
 	initShaders();
 
+	// per frame shader parameters, bound once to the binding point all line shaders read them from
+	glGenBuffers(1, &uboLineRenderParameters);
+	glBindBuffer(GL_UNIFORM_BUFFER, uboLineRenderParameters);
+	glBufferData(GL_UNIFORM_BUFFER, sizeof(LineRenderParameters), nullptr, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	context()->extraFunctions()->glBindBufferBase(GL_UNIFORM_BUFFER, LINE_RENDER_PARAMETERS_BINDING, uboLineRenderParameters);
+	lineRenderParametersValid = false;
+
 	// get graphics device and opengl info
 	QString extensions = QString((const char*)glGetString(GL_EXTENSIONS));
 	QString glversion = QString((const char*)glGetString(GL_VERSION));
@@ -113,57 +259,343 @@ void GLWidget::initializeGL()
 	emit totalGPUMemoryChanged(total_mem_mb);
 	emit usedGPUMemoryChanged(0);
 
-	// start scene update and paint timer
-	connect(&paintTimer, SIGNAL(timeout()), this, SLOT(update()));
-	paintTimer.start(16); // draw one frame each interval of 0.016 seconds, 1/0.016 yields about 60 fps
+	// frames are drawn on demand: camera, parameter, data and size changes call update() (resizing repaints by itself)
+	// otherwise QOpenGLWidget keeps presenting the last frame from its framebuffer without calling paintGL()
 	previousTimeFPS = 0;
 	fpsTimer.start();
+	fpsIdleTimer.setSingleShot(true);
+	connect(&fpsIdleTimer, &QTimer::timeout, this, &GLWidget::fpsIdle);
 
 	qDebug() << ""; // newline
 
 }
 
 
-void GLWidget::initLineRenderMode(std::vector<std::vector<LineVertex> > *lines)
+void GLWidget::initLineRenderMode(LineData *lineData)
+{
+	// allocate for all points and upload them at once
+	beginLineStream(lineData, lineData->positions.size());
+	appendLineData(*lineData);
+}
+
+void GLWidget::allocateGPUBufferLineData()
 {
 	// makes the widget's rendering context the current OpenGL rendering context
 	makeCurrent();
 
-	this->lines = lines;
+	// note: all lines of the loaded dataset are stored in a single vbo, each one is drawn as its own triangle strip
+	// with a single glMultiDrawArrays call (see drawLines), so there are no triangles between separate lines.
+	numLinePoints = 0;
+	lineRange.firstPoint = 0;
+	lineRange.numPoints = 0;
+	lineRange.tolerance = 0;
+	lineRange.groups.clear();
+	numLineScalars = 0; // scalar buffer is allocated with the first scalars in writeLineScalars
+	colorByScalar = false;
+
+	// the buffer texture of PULLED_POSITIONS cannot address more than GL_MAX_TEXTURE_BUFFER_SIZE texels (often 2^27, about 44.7M points),
+	// texelFetch beyond it returns 0 and the remaining tracks would collapse to the origin. all is uploaded in PACKED_VERTICES instead
+	if (lineVertexFormat == LineVertexFormat::PULLED_POSITIONS) {
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		if (3 * linePointCapacity > static_cast<size_t>(maxTexels)) {
+			qDebug() << linePointCapacity << "line points exceed the max buffer texture size of" << maxTexels << "texels, using packed line vertices";
+			lineVertexFormat = LineVertexFormat::PACKED_VERTICES;
+			if (lineData)
+				packedPositionRange = getPackedPositionRange(*lineData, packedPositionRange);
+			emit lineVertexFormatChanged(lineVertexFormat);
+		}
+	}
+
+	// ALLOCATE VERTEX BUFFER FOR ALL LINE POINTS, data is uploaded chunk by chunk in appendLineData
+	if (lineVertexFormat == LineVertexFormat::PULLED_POSITIONS) {
+		// 3 floats per line point, no vertex attributes: the vertex shader fetches them through a R32F buffer texture
+		vboLines.create();
+		vboLines.bind();
+		allocateVertexBuffer(linePointCapacity * sizeof(glm::vec3));
+		vboLines.release();
+
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, tboLinePositions);
+		gl33->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, vboLines.bufferId());
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+		// the shader needs the track ends to not compute directions from points of neighboring tracks
+		vboLineTrackFlags.create();
+		vboLineTrackFlags.bind();
+		allocateVertexBuffer(linePointCapacity * sizeof(uint8_t));
+		vboLineTrackFlags.release();
+
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, tboLineTrackFlags);
+		gl33->glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, vboLineTrackFlags.bufferId());
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	else {
+		QOpenGLVertexArrayObject::Binder vaoBinder(&vaoLines); // destructor unbinds (i.e. when out of scope)
+
+		// each vertex has 8 floats: 3 pos, 3 direction to next, 2 uv for triangle strip texturing (12 bytes if packed)
+		// we store all three attributes interleaved on single vbo [<posdirectionuv><posdirectionuv>...]
+		// NOTE: we store two sequential copies of each vertex (one with v = 0, one with v = 1) to draw lines as triangle strips
+		const size_t vertexSize = lineVertexFormat == LineVertexFormat::PACKED_VERTICES ? sizeof(PackedLineVertex) : sizeof(LineVertex);
+		vboLines.create();
+		vboLines.bind();
+		allocateVertexBuffer(2 * linePointCapacity * vertexSize);
+
+		// BIND VERTEX BUFFER TO SHADER ATTRIBUTES
+		setLineVertexAttributes();
+
+		// unbind buffer
+		vboLines.release();
+	}
+
+	// display memory usage
+	if (GL_NVX_gpu_memory_info_supported) {
+		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total_mem_kb);
+		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &cur_avail_mem_kb);
+	}
+	// check OpenGL error
+	GLenum err;
+	while ((err = glGetError()) != GL_NO_ERROR) {
+		qDebug() << "OpenGL error:" << err;
+	}
+
+	emit usedGPUMemoryChanged(float(total_mem_kb - cur_avail_mem_kb) / 1024.0f);
+}
+
+bool GLWidget::allocateVertexBuffer(size_t size)
+{
+	// large datasets exceed 2 GiB, e.g. 33M points of FLOAT_VERTICES, GL_OUT_OF_MEMORY is reported by the caller
+	if (size > static_cast<size_t>(std::numeric_limits<GLsizeiptr>::max())) {
+		qDebug() << "vertex buffer of" << size << "bytes is too large for this platform";
+		glBufferData(GL_ARRAY_BUFFER, 0, nullptr, GL_STATIC_DRAW);
+		return false;
+	}
+	glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(size), nullptr, GL_STATIC_DRAW);
+	return true;
+}
+
+void GLWidget::writeVertexBuffer(size_t offset, const void *data, size_t size)
+{
+	glBufferSubData(GL_ARRAY_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size), data);
+}
+
+void GLWidget::beginLineStream(LineData *lineData, size_t numPointsTotal)
+{
+	this->lineData = lineData;
+	lineStreamCapacity = numPointsTotal;
+	linePointCapacity = numPointsTotal;
+	packedPositionRange = PackedLineVertex::POSITION_RANGE;
+	lineLods.clear(); // decimation levels of the previous dataset
+	lineLodRanges.clear();
 	renderMode = RenderMode::LINES;
 
-	// allocate data
 	allocateGPUBufferLineData();
+
+	update();
 }
 
-void GLWidget::allocateGPUBufferLineData()
+void GLWidget::appendLineData(const LineData &lines)
+{
+	const size_t numPoints = lines.positions.size();
+	if (numPoints == 0)
+		return;
+	// positions outside of the packed range (e.g. tracks outside of the header volume) would be clamped
+	const bool exceedsPackedRange = lineVertexFormat == LineVertexFormat::PACKED_VERTICES && getPackedPositionRange(lines, packedPositionRange) > packedPositionRange;
+	if (numLinePoints + numPoints > lineStreamCapacity || exceedsPackedRange) {
+		// more points than announced (e.g. resampled tracks), grow the buffers and upload everything so far again,
+		// or pack everything so far again with a larger range
+		if (numLinePoints + numPoints > lineStreamCapacity)
+			lineStreamCapacity = std::max(numLinePoints + numPoints, lineStreamCapacity * 3 / 2);
+		if (exceedsPackedRange) {
+			packedPositionRange = getPackedPositionRange(lines, packedPositionRange);
+			qDebug() << "line positions exceed the packed vertex range, using a range of" << packedPositionRange;
+		}
+		uploadLines();
+	}
+
+	// upload behind the points already in the buffer, everything uploaded so far is drawn
+	writeLineData(lines, numLinePoints);
+	appendLineGroups(lines, numLinePoints, lineRange.groups);
+
+	// scalars must be contiguous with the points, chunks without scalars end coloring by scalar
+	if (lines.scalars.size() == numPoints && numLineScalars == numLinePoints) {
+		writeLineScalars(lines.scalars, numLinePoints);
+		numLineScalars += numPoints;
+		colorByScalar = true;
+	}
+	numLinePoints += numPoints;
+	lineRange.numPoints = numLinePoints;
+
+	// the tracks of the groups changed, refinement starts over
+	progressiveFrame = 0;
+	update();
+}
+
+void GLWidget::setLineLods(LineLods lods)
+{
+	lineLods = lods;
+
+	// the levels are stored behind the full resolution points, all is uploaded again into a larger buffer
+	if (renderMode == RenderMode::LINES && lineData)
+		uploadLines();
+}
+
+void GLWidget::uploadLines()
+{
+	// full resolution points stay at the start of the buffer, loading may still append to them
+	linePointCapacity = lineStreamCapacity;
+	if (lineLods) {
+		for (const LineLod &lod : *lineLods)
+			linePointCapacity += lod.lines.positions.size();
+	}
+	if (lineVertexFormat == LineVertexFormat::PACKED_VERTICES)
+		packedPositionRange = getPackedPositionRange(*lineData, packedPositionRange);
+	allocateGPUBufferLineData();
+	appendLineData(*lineData);
+
+	lineLodRanges.clear();
+	if (lineLods) {
+		size_t firstPoint = lineStreamCapacity;
+		for (const LineLod &lod : *lineLods) {
+			const size_t numPoints = lod.lines.positions.size();
+			writeLineData(lod.lines, firstPoint);
+			if (numLineScalars > 0 && lod.lines.scalars.size() == numPoints)
+				writeLineScalars(lod.lines.scalars, firstPoint);
+
+			LineRange range;
+			range.firstPoint = firstPoint;
+			range.numPoints = numPoints;
+			range.tolerance = lod.tolerance;
+			appendLineGroups(lod.lines, firstPoint, range.groups);
+			lineLodRanges.push_back(range);
+			firstPoint += numPoints;
+		}
+	}
+
+	update();
+}
+
+void GLWidget::writeLineData(const LineData &lines, size_t firstPoint)
 {
+	const size_t numPoints = lines.positions.size();
+	if (numPoints == 0)
+		return;
+
 	// makes the widget's rendering context the current OpenGL rendering context
 	makeCurrent();
 
-	// load lines
-	// note: we draw all separates lines of the loaded dataset as a single line (single vertex array in vbo)
-	// this allows for much faster drawing. we discard fragments connecting start and end vertices of separate lines.
-	nrLines = lines->size();
+	const size_t numTracks = lines.getNumTracks();
 
-	std::vector<LineVertex> line1 = (*lines)[0];
+	vboLines.bind();
+	if (lineVertexFormat == LineVertexFormat::PULLED_POSITIONS) {
+		writeVertexBuffer(firstPoint * sizeof(glm::vec3), &lines.positions[0], numPoints * sizeof(glm::vec3));
+
+		// flag first and last point of each track, a single point track has both flags
+		std::vector<uint8_t> trackFlags(numPoints, 0);
+		for (size_t i = 0; i < numTracks; ++i) {
+			if (lines.trackOffsets[i + 1] > lines.trackOffsets[i]) {
+				trackFlags[lines.trackOffsets[i]] |= 1;
+				trackFlags[lines.trackOffsets[i + 1] - 1] |= 2;
+			}
+		}
+		vboLineTrackFlags.bind();
+		writeVertexBuffer(firstPoint * sizeof(uint8_t), &trackFlags[0], numPoints * sizeof(uint8_t));
+		vboLineTrackFlags.release();
+	}
+	else {
+		std::vector<LineVertex> vertices(2 * numPoints);
+		generateTrackLineVerticesParallel(&lines.positions[0], &lines.trackOffsets[0], numTracks, &vertices[0]);
+		if (lineVertexFormat == LineVertexFormat::PACKED_VERTICES) {
+			std::vector<PackedLineVertex> packedVertices(vertices.size());
+			packLineVertices(&vertices[0], vertices.size(), packedPositionRange, &packedVertices[0]);
+			writeVertexBuffer(2 * firstPoint * sizeof(PackedLineVertex), &packedVertices[0], packedVertices.size() * sizeof(PackedLineVertex));
+		}
+		else {
+			writeVertexBuffer(2 * firstPoint * sizeof(LineVertex), &vertices[0], vertices.size() * sizeof(LineVertex));
+		}
+	}
+	vboLines.release();
+}
 
-	//qDebug() << "line number of vertices (duplicated to draw as triangle strips):" << line1.size();
+bool GLWidget::isLineGroupVisible(const LineGroup &group, const glm::vec4 frustumPlanes[6])
+{
+	// the view aligned strips extend half their width beyond the line points
+	const glm::vec3 boundsMin = group.boundsMin - 0.5f * lineTriangleStripWidth;
+	const glm::vec3 boundsMax = group.boundsMax + 0.5f * lineTriangleStripWidth;
+
+	if (!isBoxInFrustum(boundsMin, boundsMax, frustumPlanes))
+		return false;
+
+	// the shader discards everything farther than clipPlaneDistance along clipPlaneNormal, test the nearest corner
+	if (enableClipping) {
+		glm::vec3 corner(clipPlaneNormal.x >= 0 ? boundsMin.x : boundsMax.x, clipPlaneNormal.y >= 0 ? boundsMin.y : boundsMax.y, clipPlaneNormal.z >= 0 ? boundsMin.z : boundsMax.z);
+		if (glm::dot(clipPlaneNormal, corner) > clipPlaneDistance)
+			return false;
+	}
 
-	QOpenGLVertexArrayObject::Binder vaoBinder(&vaoLines); // destructor unbinds (i.e. when out of scope)
-	QOpenGLFunctions *f = QOpenGLContext::currentContext()->functions();
+	return true;
+}
 
-	// ALLOCATE VERTEX DATA ON BUFFER
-	// allocate line vertex data to vertex buffer object
-	// each vertex has 8 floats: 3 pos, 3 direction to next, 2 uv for triangle strip texturing
-	// we store all three attributes interleaved on single vbo [<posdirectionuv><posdirectionuv>...]
-	// NOTE: we store two sequential copies of each vertex (one with v = 0, one with v = 1) to draw lines as triangle strips
-	vboLines.create();
-	vboLines.bind();
-	vboLines.setUsagePattern(QOpenGLBuffer::StaticDraw);
-	vboLines.allocate(&line1[0], line1.size() * 8 * sizeof(GLfloat));
+void GLWidget::writeLineScalars(const std::vector<uint16_t> &scalars, size_t firstPoint)
+{
+	// makes the widget's rendering context the current OpenGL rendering context
+	makeCurrent();
+
+	const bool pulled = lineVertexFormat == LineVertexFormat::PULLED_POSITIONS;
+	const size_t scalarsPerPoint = pulled ? 1 : 2; // one per line vertex, i.e. twice per point for FLOAT_VERTICES and PACKED_VERTICES
+
+	// allocate for all line points with the first chunk, then upload chunk by chunk like the line points
+	// decimation levels are only written once the full resolution scalars are there
+	if (numLineScalars == 0) {
+		vboLineScalars.create();
+		vboLineScalars.bind();
+		allocateVertexBuffer(scalarsPerPoint * linePointCapacity * sizeof(uint16_t));
+
+		if (pulled) {
+			gl33->glBindTexture(GL_TEXTURE_BUFFER, tboLineScalars);
+			gl33->glTexBuffer(GL_TEXTURE_BUFFER, GL_R16F, vboLineScalars.bufferId());
+			gl33->glBindTexture(GL_TEXTURE_BUFFER, 0);
+		}
+		else {
+			QOpenGLVertexArrayObject::Binder vaoBinder(&vaoLines); // destructor unbinds (i.e. when out of scope)
+			shaderLinesWithHalos->bind();
+			shaderLinesWithHalos->enableAttributeArray(3); // assume shader attribute "scalar" at index 3
+			shaderLinesWithHalos->setAttributeBuffer(3, GL_HALF_FLOAT, 0, 1, sizeof(uint16_t)); // 1 half float, tightly packed
+			shaderLinesWithHalos->release();
+		}
+	}
+	else {
+		vboLineScalars.bind();
+	}
+	if (pulled) {
+		writeVertexBuffer(firstPoint * sizeof(uint16_t), &scalars[0], scalars.size() * sizeof(uint16_t));
+	}
+	else {
+		std::vector<uint16_t> vertexScalars(2 * scalars.size());
+		for (size_t i = 0; i < scalars.size(); ++i)
+			vertexScalars[2*i] = vertexScalars[2*i + 1] = scalars[i];
+		writeVertexBuffer(2 * firstPoint * sizeof(uint16_t), &vertexScalars[0], vertexScalars.size() * sizeof(uint16_t));
+	}
+	vboLineScalars.release();
+}
+
+void GLWidget::setLineVertexFormat(LineVertexFormat format)
+{
+	if (format == lineVertexFormat)
+		return;
+	if (format == LineVertexFormat::PULLED_POSITIONS && !gl33) {
+		qDebug() << "pulled line vertices need OpenGL 3.3 buffer textures";
+		return;
+	}
+	lineVertexFormat = format;
 
-	// BIND VERTEX BUFFER TO SHADER ATTRIBUTES
+	// upload what is loaded so far again, chunks still being streamed are appended in the new format
+	if (renderMode == RenderMode::LINES && lineData)
+		uploadLines();
+}
+
+void GLWidget::setLineVertexAttributes()
+{
+	// note: vaoLines and vboLines must be bound
 	shaderLinesWithHalos->bind();
 
 	// important: offset is meant between shader attributes! not between data of individual vertices!
@@ -171,35 +603,42 @@ void GLWidget::allocateGPUBufferLineData()
 	// however here for interleaved attribute storage [xyzxyzuv...xyzxyzuv...], i.e. sequential vertex data storage
 	// we must use the stride to indicate the size of the vertex data (here 8 floats) and attribute offset inside the stride
 	// attributeStartPos(vertexindex) = vertexindex*stride + offset
-	shaderLinesWithHalos->enableAttributeArray(0); // assume shader attribute "position" at index 0
-	shaderLinesWithHalos->setAttributeBuffer(0, GL_FLOAT, 0*sizeof(GLfloat), 3, 8 * sizeof(GL_FLOAT)); // attribute offset 0 byte, 3 floats xyz, vertex stride 8*4 byte
-	shaderLinesWithHalos->enableAttributeArray(1); // assume shader attribute "direction" at index 1
-	shaderLinesWithHalos->setAttributeBuffer(1, GL_FLOAT, 3*sizeof(GLfloat), 3, 8 * sizeof(GL_FLOAT)); // attribute offset 3*4 byte, 3 floats xyz, vertex stride 8*4 byte
-	shaderLinesWithHalos->enableAttributeArray(2); // assume shader attribute "uv" at index 2
-	shaderLinesWithHalos->setAttributeBuffer(2, GL_FLOAT, 6*sizeof(GLfloat), 2, 8 * sizeof(GL_FLOAT)); // attribute offset 6*4 byte, 2 floats uv, vertex stride 8*4 byte
-
-	// unbind buffer and shader program
-	vboLines.release();
-	shaderLinesWithHalos->release();
-
-	// display memory usage
-	if (GL_NVX_gpu_memory_info_supported) {
-		glGetIntegerv(GL_GPU_MEMORY_INFO_TOTAL_AVAILABLE_MEMORY_NVX, &total_mem_kb);
-		glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &cur_avail_mem_kb);
+	if (lineVertexFormat == LineVertexFormat::PACKED_VERTICES) {
+		// PackedLineVertex: normalized shorts, the shader decodes them (see shader_lines_with_halos_packed.vert)
+		shaderLinesWithHalos->enableAttributeArray(0); // assume shader attribute "packedPosition" at index 0
+		shaderLinesWithHalos->setAttributeBuffer(0, GL_SHORT, 0, 3, sizeof(PackedLineVertex)); // attribute offset 0 byte, 3 snorm16 xyz, vertex stride 12 byte
+		shaderLinesWithHalos->enableAttributeArray(1); // assume shader attribute "packedDirection" at index 1
+		shaderLinesWithHalos->setAttributeBuffer(1, GL_SHORT, 4*sizeof(GLshort), 2, sizeof(PackedLineVertex)); // attribute offset 8 byte, 2 snorm16 octahedral, vertex stride 12 byte
+		shaderLinesWithHalos->enableAttributeArray(2); // assume shader attribute "packedUFlags" at index 2
+		shaderLinesWithHalos->setAttributeBuffer(2, GL_UNSIGNED_SHORT, 3*sizeof(GLshort), 1, sizeof(PackedLineVertex)); // attribute offset 6 byte, 1 unorm16 u and flags, vertex stride 12 byte
 	}
-	// check OpenGL error
-	GLenum err;
-	while ((err = glGetError()) != GL_NO_ERROR) {
-		qDebug() << "OpenGL error:" << err;
+	else {
+		shaderLinesWithHalos->enableAttributeArray(0); // assume shader attribute "position" at index 0
+		shaderLinesWithHalos->setAttributeBuffer(0, GL_FLOAT, 0*sizeof(GLfloat), 3, 8 * sizeof(GL_FLOAT)); // attribute offset 0 byte, 3 floats xyz, vertex stride 8*4 byte
+		shaderLinesWithHalos->enableAttributeArray(1); // assume shader attribute "direction" at index 1
+		shaderLinesWithHalos->setAttributeBuffer(1, GL_FLOAT, 3*sizeof(GLfloat), 3, 8 * sizeof(GL_FLOAT)); // attribute offset 3*4 byte, 3 floats xyz, vertex stride 8*4 byte
+		shaderLinesWithHalos->enableAttributeArray(2); // assume shader attribute "uv" at index 2
+		shaderLinesWithHalos->setAttributeBuffer(2, GL_FLOAT, 6*sizeof(GLfloat), 2, 8 * sizeof(GL_FLOAT)); // attribute offset 6*4 byte, 2 floats uv, vertex stride 8*4 byte
 	}
+	shaderLinesWithHalos->disableAttributeArray(3); // optional "scalar" at index 3 is enabled by writeLineScalars
 
-	emit usedGPUMemoryChanged(float(total_mem_kb - cur_avail_mem_kb) / 1024.0f);
+	// unbind shader program
+	shaderLinesWithHalos->release();
 }
 
 void GLWidget::paintGL()
 {
 	calculateFPS();
 
+	// results of the previous frames that are not available yet are skipped instead of waiting for the GPU
+	readFrameTime();
+	frameTimer.start();
+	frameContent = FULL_FRAME;
+	if (gl33) {
+		frameTimeQueryPending[frameTimeQueryIndex] = false;
+		gl33->glBeginQuery(GL_TIME_ELAPSED, frameTimeQueries[frameTimeQueryIndex]);
+	}
+
 	switch (renderMode) {
 		case(RenderMode::NONE):
 			break; // do nothing
@@ -212,56 +651,172 @@ void GLWidget::paintGL()
 		default:
 			break;
 	}
+
+	if (gl33) {
+		gl33->glEndQuery(GL_TIME_ELAPSED);
+		frameTimeQueryPending[frameTimeQueryIndex] = true;
+		frameTimeQueryContent[frameTimeQueryIndex] = frameContent;
+		frameTimeQueryIndex ^= 1;
+	}
+	else {
+		float frameTime = frameTimer.nsecsElapsed() / 1e6f;
+		emit frameTimeChanged(frameTime);
+		adaptQuality(frameTime, frameContent);
+	}
 }
 
 
 void GLWidget::drawLines()
 {
 	QOpenGLFunctions *glf = QOpenGLContext::currentContext()->functions();
+	const bool pulled = lineVertexFormat == LineVertexFormat::PULLED_POSITIONS;
+	QOpenGLShaderProgram *shader = pulled ? shaderLinesWithHalosPulled : shaderLinesWithHalos;
+	if (lineVertexFormat == LineVertexFormat::PACKED_VERTICES)
+		shader = shaderLinesWithHalosPacked;
 
 	// BIND BUFFERS AND INIT SHADER UNIFORMS
 
 	// bind vertex array object to bind all vbos associated with it
-	QOpenGLVertexArrayObject::Binder vaoBinder(&vaoLines); // destructor unbinds (i.e. when out of scope)
-
-	// bind shader program and set shader uniforms
-	// note that glm uses column vectors, qt uses row vectors, thus transpose
-	shaderLinesWithHalos->bind();
-	QMatrix4x4 viewMat = QMatrix4x4(glm::value_ptr(camera.getViewMatrix())).transposed();
-	QMatrix4x4 projMat = QMatrix4x4(glm::value_ptr(camera.getProjectionMatrix())).transposed();
-	glm::vec3 camPosGLM = camera.getPosition();
-	QVector3D camPos = QVector3D(camPosGLM.x,camPosGLM.y,camPosGLM.z);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("viewMat"), viewMat);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("projMat"), projMat);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("inverseProjMat"), projMat.inverted());
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("cameraPos"), camPos);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("colorLine"), 0.0f, 0.0f, 0.0f);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("colorHalo"), 1.0f, 1.0f, 1.0f);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("lineTriangleStripWidth"), lineTriangleStripWidth);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("lineWidthPercentageBlack"), lineWidthPercentageBlack);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("lineWidthDepthCueingFactor"), lineWidthDepthCueingFactor);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("lineHaloMaxDepth"), lineHaloMaxDepth);
-	QVector3D clipPlaneN = QVector3D(clipPlaneNormal.x, clipPlaneNormal.y, clipPlaneNormal.z);
-	if (!enableClipping)
-		clipPlaneN = QVector3D(0,0,0);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("clipPlaneNormal"), clipPlaneN);
-	shaderLinesWithHalos->setUniformValue(shaderLinesWithHalos->uniformLocation("clipPlaneDistance"), clipPlaneDistance);
+	QOpenGLVertexArrayObject::Binder vaoBinder(pulled ? &vaoLinesPulled : &vaoLines); // destructor unbinds (i.e. when out of scope)
+
+	// bind shader program, its uniforms are in uboLineRenderParameters which is only written when they changed
+	// refinement starts over if anything else changed, the image accumulated so far is outdated
+	shader->bind();
+	if (updateLineRenderParameters() && refining)
+		progressiveFrame = 0;
+
+	// line points, scalars and track flags are fetched from buffer textures in texture units 0, 1 and 2
+	if (pulled) {
+		gl33->glActiveTexture(GL_TEXTURE0);
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, tboLinePositions);
+		gl33->glActiveTexture(GL_TEXTURE1);
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, tboLineScalars);
+		gl33->glActiveTexture(GL_TEXTURE2);
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, tboLineTrackFlags);
+	}
 
 
 	// DRAW
 
-	glf->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glf->glDrawArrays(GL_TRIANGLE_STRIP, 0, (*lines)[0].size());
+	// fraction of the tracks drawn this frame, a subset while the camera moves or while refining large datasets
+	const LineRange &range = selectLineLod();
+	float fraction = 1;
+	bool clear = true;
+	if ((cameraMoving || refining) && range.numPoints > interactionPointBudget) {
+		fraction = static_cast<float>(interactionPointBudget) / range.numPoints;
+		if (refining) {
+			fraction = std::max(fraction, 1.0f / MAX_REFINEMENT_FRAMES);
+			clear = progressiveFrame == 0;
+		}
+	}
 
-	shaderLinesWithHalos->release();
+	if (clear)
+		glf->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	if (cameraMoving)
+		frameContent = INTERACTION_FRAME;
+	else if (fraction < 1)
+		frameContent = REFINEMENT_FRAME;
+
+	glm::vec4 frustumPlanes[6];
+	getFrustumPlanes(lineRenderParameters.viewProjMat, frustumPlanes);
+
+	// one triangle strip per track of each group that is not culled
+	for (const LineGroup &group : range.groups) {
+		if (!group.trackFirstVertices.empty() && isLineGroupVisible(group, frustumPlanes))
+			drawLineGroup(group, fraction, progressiveFrame, cameraMoving);
+	}
+
+	// refinement goes on until the windows of all frames since the camera stopped cover all tracks
+	++progressiveFrame;
+	if (refining) {
+		if (fraction * progressiveFrame >= 1)
+			refining = false;
+		else
+			update();
+	}
+
+	if (pulled) {
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, 0);
+		gl33->glActiveTexture(GL_TEXTURE1);
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, 0);
+		gl33->glActiveTexture(GL_TEXTURE0);
+		gl33->glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	shader->release();
+}
+
+void GLWidget::drawLineGroup(const LineGroup &group, float fraction, size_t window, bool cycle)
+{
+	// each group draws the same fraction of its tracks, so every part of the dataset is represented in a subset
+	const size_t numTracks = group.trackFirstVertices.size();
+	size_t firstTrack = 0;
+	size_t numWindowTracks = numTracks;
+	if (fraction < 1) {
+		numWindowTracks = std::min(numTracks, static_cast<size_t>(std::ceil(numTracks * fraction)));
+		if (cycle)
+			window %= (numTracks + numWindowTracks - 1) / numWindowTracks;
+		firstTrack = window * numWindowTracks;
+		if (firstTrack >= numTracks)
+			return;
+		numWindowTracks = std::min(numWindowTracks, numTracks - firstTrack);
+	}
+
+	QOpenGLFunctions *glf = QOpenGLContext::currentContext()->functions();
+	if (gl33) {
+		gl33->glMultiDrawArrays(GL_TRIANGLE_STRIP, &group.trackFirstVertices[firstTrack], &group.trackNumVertices[firstTrack], static_cast<GLsizei>(numWindowTracks));
+	}
+	else {
+		for (size_t i = firstTrack; i < firstTrack + numWindowTracks; ++i)
+			glf->glDrawArrays(GL_TRIANGLE_STRIP, group.trackFirstVertices[i], group.trackNumVertices[i]);
+	}
+}
+
+void GLWidget::cameraChanged()
+{
+	if (!cameraMoving)
+		progressiveFrame = 0;
+	cameraMoving = true;
+	refining = false;
+	interactionTimer.start(INTERACTION_END_DELAY);
+	update();
+}
+
+void GLWidget::interactionEnded()
+{
+	cameraMoving = false;
+	refining = true;
+	progressiveFrame = 0;
+	update();
+}
+
+const GLWidget::LineRange &GLWidget::selectLineLod()
+{
+	if (lineLodRanges.empty() || camera.isOrthogonal())
+		return lineRange;
+
+	// size of a pixel at the camera target (the center of the normalized dataset), zooming narrows the field of view
+	float targetDistance = glm::length(camera.getTarget() - camera.getPosition());
+	float pixelSize = 2.0f * targetDistance * tanf(glm::radians(camera.getFieldOfView()) / 2.0f) / std::max(height(), 1);
+
+	// coarsest level whose error stays below lodPixelError pixels, levels are sorted from fine to coarse
+	const LineRange *range = &lineRange;
+	for (const LineRange &lod : lineLodRanges) {
+		if (lod.tolerance > lodPixelError * pixelSize)
+			break;
+		range = &lod;
+	}
+	return *range;
 }
 
 void GLWidget::calculateFPS()
 {
 	++frameCount;
 
-	// calculate time passed since last frame
+	// calculate time passed since last frame, counting starts again with the first frame after being idle
 	qint64 currentTime = fpsTimer.elapsed(); // in milliseconds
+	if (previousTimeFPS < 0)
+		previousTimeFPS = currentTime;
 	qint64 timeInterval = currentTime - previousTimeFPS;
 
 	// when timeInterval reaches one second
@@ -276,11 +831,72 @@ void GLWidget::calculateFPS()
 
 	emit fpsChanged(fps);
 
+	// restarted with each frame, times out when the window is idle
+	fpsIdleTimer.start(1000);
+}
+
+void GLWidget::fpsIdle()
+{
+	// report the GPU time of the last frame that was drawn before becoming idle
+	makeCurrent();
+	readFrameTime();
+	doneCurrent();
+
+	fps = 0;
+	frameCount = 0;
+	previousTimeFPS = -1;
+	emit fpsChanged(fps);
+}
+
+void GLWidget::readFrameTime()
+{
+	// the query of the next frame is the older one
+	for (int i = 0; i < 2; ++i) {
+		const int query = frameTimeQueryIndex ^ i;
+		if (!frameTimeQueryPending[query])
+			continue;
+
+		GLuint available = GL_FALSE;
+		gl33->glGetQueryObjectuiv(frameTimeQueries[query], GL_QUERY_RESULT_AVAILABLE, &available);
+		if (!available)
+			continue;
+
+		GLuint64 nanoseconds = 0;
+		gl33->glGetQueryObjectui64v(frameTimeQueries[query], GL_QUERY_RESULT, &nanoseconds);
+		frameTimeQueryPending[query] = false;
+		emit frameTimeChanged(nanoseconds / 1e6f);
+		adaptQuality(nanoseconds / 1e6f, frameTimeQueryContent[query]);
+	}
+}
+
+void GLWidget::adaptQuality(float frameTime, FrameContent content)
+{
+	if (!adaptiveQuality || frameTime <= 0)
+		return;
+
+	// the load is about proportional to the number of points drawn, correct by the ratio to the target
+	// with damping (square root) and limited steps so single slow frames do not make the quality jump
+	const float ratio = glm::clamp(targetFrameTime / frameTime, 0.5f, 2.0f);
+	if (content == INTERACTION_FRAME) {
+		double budget = interactionPointBudget * std::sqrt(ratio);
+		interactionPointBudget = static_cast<size_t>(glm::clamp(budget, double(MIN_INTERACTION_POINT_BUDGET), double(MAX_INTERACTION_POINT_BUDGET)));
+	}
+	else if (content == FULL_FRAME) {
+		// coarser decimation levels when too slow, finer ones again when there is plenty of headroom
+		if (frameTime > targetFrameTime)
+			lodPixelError = std::min(lodPixelError * 1.5f, MAX_LOD_PIXEL_ERROR);
+		else if (frameTime < 0.5f * targetFrameTime)
+			lodPixelError = std::max(lodPixelError / 1.5f, MIN_LOD_PIXEL_ERROR);
+	}
+	// refinement frames draw a fixed share of the dataset to finish in a few frames, their time controls nothing
 }
 
 void GLWidget::resizeGL(int w, int h)
 {
 	camera.setAspect(float(w) / h);
+
+	// the framebuffer is new, refinement must draw everything again
+	progressiveFrame = 0;
 }
 
 void GLWidget::mousePressEvent(QMouseEvent *event)
@@ -291,7 +907,7 @@ void GLWidget::mousePressEvent(QMouseEvent *event)
 void GLWidget::wheelEvent(QWheelEvent *event)
 {
 	camera.zoom(event->delta() / 30);
-	update();
+	cameraChanged();
 }
 
 void GLWidget::mouseMoveEvent(QMouseEvent *event)
@@ -306,7 +922,7 @@ void GLWidget::mouseMoveEvent(QMouseEvent *event)
 	}
 
 	lastMousePos = event->pos();
-	update();
+	cameraChanged();
 }
 
 void GLWidget::keyPressEvent(QKeyEvent *event)
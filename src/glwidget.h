@@ -4,6 +4,8 @@
 #include <QCoreApplication>
 #include <QOpenGLWidget>
 #include <QOpenGLFunctions>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLExtraFunctions>
 #include <QOpenGLDebugLogger>
 #include <QOpenGLVertexArrayObject>
 #include <QOpenGLBuffer>
@@ -13,7 +15,8 @@
 #include <QTimer>
 
 #include "camera.h"
-#include "linevertex.h"
+#include "linedata.h"
+#include "linelod.h"
 
 class MainWindow;
 
@@ -30,12 +33,44 @@ public:
 	GLWidget(QWidget *parent, MainWindow *mainWindow);
 	~GLWidget();
 
+	//! \brief LineVertexFormat enum
+	//! how the line data is stored on the GPU
+	enum LineVertexFormat
+	{
+		PULLED_POSITIONS, //!< each line point stored once (3 floats) in a buffer texture, the vertex shader fetches it by gl_VertexID/2 and computes the direction from the neighboring points
+		FLOAT_VERTICES, //!< two LineVertex (8 floats each) per line point as interleaved vertex attributes
+		PACKED_VERTICES //!< two PackedLineVertex (12 bytes each) per line point as interleaved normalized short vertex attributes
+	};
+
 	//! \brief set up OpenGL buffers and shaders to render lines
-	//! \param lines vector of lines (vector of vector of line vertices)
-	//! each vertex has 8 floats: 3 pos, 3 direction to next, 2 uv for triangle strip texturing
-	//! we store all three attributes interleaved on single vbo [<posdirectionuv><posdirectionuv>...]
-	//! NOTE: we store two sequential copies of each vertex (one with v = 0, one with v = 1) to draw lines as triangle strips
-	void initLineRenderMode(std::vector<std::vector<LineVertex> > *lines);
+	//! \param lineData tracks to draw, must be kept alive by the caller
+	void initLineRenderMode(LineData *lineData);
+
+	//! \brief set up OpenGL buffers and shaders to render lines that are streamed in chunks
+	//! \param lineData line data the streamed chunks are appended to, must be kept alive by the caller
+	//! \param numPointsTotal number of line points that will be appended in total
+	//! the buffers are allocated for all points once, appendLineData() then uploads the chunks into them (and grows them if needed)
+	void beginLineStream(LineData *lineData, size_t numPointsTotal);
+
+	//! \brief upload a chunk of whole tracks behind the already uploaded ones and redraw
+	//! \param lines line positions and track offsets of the chunk, and optional scalars which enable coloring by scalar
+	//! the vertices of the current line vertex format are generated from the positions while uploading
+	//! the buffers grow if more points arrive than announced, so the line data must not contain the chunk yet
+	void appendLineData(const LineData &lines);
+
+	//! \brief switch how the line data is stored on the GPU, the line data is uploaded again in the new format
+	//! PULLED_POSITIONS falls back to PACKED_VERTICES if the points exceed the max buffer texture size
+	void setLineVertexFormat(LineVertexFormat format);
+
+	inline LineVertexFormat getLineVertexFormat() const
+	{
+		return lineVertexFormat;
+	}
+
+	//! \brief set decimation levels of the current line data, they are uploaded behind the full resolution points
+	//! \param lods levels from fine to coarse, built from the line data passed to initLineRenderMode() or beginLineStream()
+	//! each frame the coarsest level whose error is below lodPixelError on screen is drawn (see selectLineLod())
+	void setLineLods(LineLods lods);
 
 	float lineTriangleStripWidth; //!< total width of triangle strip (black line + white halo)
 	float lineWidthPercentageBlack; //!< percentage of triangle strip drawn black to represent line (rest is white halo)
@@ -46,6 +81,16 @@ public:
 	glm::vec3 clipPlaneNormal; //!< direction along which to clip. note: no real clipping we only discard fragments
 	float clipPlaneDistance; //!< distance from origin in direction of clipPlaneNormal beyond which to clip
 
+	bool colorByScalar; //!< color lines by their per vertex scalar, only if scalars were uploaded
+	glm::vec2 scalarRange; //!< scalars mapped to the color ramp
+
+	float lodPixelError; //!< max error in pixels at the camera target of the decimation level drawn
+	size_t interactionPointBudget; //!< max line points drawn per frame while the camera moves, the rest is drawn in refinement frames
+
+	//! adapt interactionPointBudget and lodPixelError to the measured GPU frame time, see adaptQuality()
+	bool adaptiveQuality;
+	float targetFrameTime; //!< GPU time per frame in milliseconds adaptiveQuality aims for
+
 	//! \brief getImage
 	//! \return an image snapshot of the current OpenGL framebuffer
 	inline QImage getImage()
@@ -77,7 +122,10 @@ signals:
 	void usedGPUMemoryChanged(float size);
 	void totalGPUMemoryChanged(float size);
 	void fpsChanged(int fps);
+	void frameTimeChanged(float milliseconds);
 	void graphicsDeviceInfoChanged(QString string);
+	//! \brief the line vertex format was changed by the widget, e.g. because the dataset is too large for PULLED_POSITIONS
+	void lineVertexFormatChanged(int format);
 
 protected:
 
@@ -95,48 +143,151 @@ protected slots:
 	void initializeGL() Q_DECL_OVERRIDE;
 	void resizeGL(int w, int h) Q_DECL_OVERRIDE;
 
+	//! \brief no frame was drawn for a second, report 0 fps
+	void fpsIdle();
+
+	//! \brief the camera stopped moving, refine to the full dataset over the next frames
+	void interactionEnded();
+
 private:
 
 	void initShaders();
 
+	//! \brief bind the LineRenderParameters uniform block of a line shader to uboLineRenderParameters
+	void bindLineRenderParameters(QOpenGLShaderProgram *shader);
+
+	//! \brief upload the current LineRenderParameters into uboLineRenderParameters if they changed since the last frame
+	//! \return whether the parameters changed
+	bool updateLineRenderParameters();
+
 	void allocateGPUBufferLineData();
+	//! \brief allocate the bound vertex buffer, unlike QOpenGLBuffer::allocate() the size is not limited to an int (2 GiB)
+	//! \return false if the size does not fit into GLsizeiptr
+	bool allocateVertexBuffer(size_t size);
+	//! \brief write into the bound vertex buffer, unlike QOpenGLBuffer::write() offset and size are not limited to an int
+	void writeVertexBuffer(size_t offset, const void *data, size_t size);
+	void setLineVertexAttributes();
+	void uploadLines();
+	void writeLineData(const LineData &lines, size_t firstPoint);
+	void writeLineScalars(const std::vector<uint16_t> &scalars, size_t firstPoint);
 	void drawLines();
 
+	//! \brief The LineRange struct. Points of the full resolution data or of a decimation level in vboLines
+	//! each track is drawn as its own triangle strip, so no triangles connect the end of a track with the start of the next one
+	struct LineRange
+	{
+		size_t firstPoint;
+		size_t numPoints;
+		float tolerance; //!< max error of the level in normalized line position units, 0 for full resolution
+		std::vector<LineGroup> groups; //!< one group per grid cell, see appendLineGroups(), empty until the first track is added
+	};
+
+	//! \brief whether any part of the group may be visible in the current view and on the visible side of the clip plane
+	//! \param frustumPlanes planes of the view frustum in world space, the inside has positive distance
+	bool isLineGroupVisible(const LineGroup &group, const glm::vec4 frustumPlanes[6]);
+
+	//! \brief choose the decimation level to draw from the camera distance and zoom
+	const LineRange &selectLineLod();
+
+	//! \brief draw a window of the tracks of a group
+	//! \param fraction fraction of the tracks of the group in each window, all tracks if 1
+	//! \param window index of the window, the windows tile the tracks of the group in order
+	//! \param cycle wrap window around the number of windows of the group instead of drawing nothing past the last one
+	void drawLineGroup(const LineGroup &group, float fraction, size_t window, bool cycle);
+
+	//! \brief the camera was moved by the user, draw a subset of the tracks each frame until it stops
+	void cameraChanged();
+
 	void calculateFPS();
 
+	//! \brief read the GPU times of the previous frames from frameTimeQueries whose results are available
+	//! and emit frameTimeChanged(), never waits for the GPU
+	void readFrameTime();
+
+	//! \brief FrameContent enum
+	//! which tracks a frame drew, decides which quality setting its frame time controls
+	enum FrameContent
+	{
+		FULL_FRAME, //!< all tracks of the selected decimation level
+		INTERACTION_FRAME, //!< a subset while the camera moves
+		REFINEMENT_FRAME //!< a subset drawn on top of the previous frames after the camera stopped
+	};
+
+	//! \brief closed loop control of the load per frame towards targetFrameTime
+	//! \param frameTime measured time of the last frame in milliseconds
+	//! \param content what the measured frame drew
+	void adaptQuality(float frameTime, FrameContent content);
+
 	Camera camera;
 
-	//! CPU line vertex data
-	//! each line vertex has 8 floats: 3 pos, 3 direction to next, 2 uv for triangle strip texturing
-	//! NOTE: we store two sequential copies of each vertex (one with v = 0, one with v = 1) to draw lines as triangle strips
-	std::vector<std::vector<LineVertex> > *lines;
-	size_t nrLines;
+	//! CPU line data, positions of all tracks the GPU line vertices are generated from
+	LineData *lineData;
+	LineVertexFormat lineVertexFormat;
+	size_t numLinePoints; //!< number of full resolution line points uploaded to vboLines
+	size_t lineStreamCapacity; //!< number of full resolution line points vboLines has storage for
+	size_t linePointCapacity; //!< number of line points vboLines has storage for, full resolution and decimation levels
+	size_t numLineScalars; //!< number of full resolution line points with scalars uploaded to vboLineScalars
+	float packedPositionRange = PackedLineVertex::POSITION_RANGE; //!< of PACKED_VERTICES, holds all positions of lineData
+	LineRange lineRange; //!< full resolution tracks uploaded so far
+	LineLods lineLods; //!< decimation levels of lineData
+	std::vector<LineRange> lineLodRanges; //!< where the decimation levels are stored in vboLines, from fine to coarse
 
 	// GPU line vertex data and shaders
-	// each line vertex has 8 floats: 3 pos, 3 direction to next, 2 uv for triangle strip texturing
+	// FLOAT_VERTICES: each line vertex has 8 floats: 3 pos, 3 direction to next, 2 uv for triangle strip texturing
 	// NOTE: we store two sequential copies of each vertex (one with v = 0, one with v = 1) to draw lines as triangle strips
+	// PACKED_VERTICES: same as FLOAT_VERTICES but quantized into 12 bytes per vertex, see PackedLineVertex
+	// PULLED_POSITIONS: vboLines holds 3 floats per line point, read through tboLinePositions (12 instead of 64 bytes per line point)
+	// and vboLineTrackFlags marks the first and last point of each track, so directions are not computed across tracks
 	QOpenGLShaderProgram *shaderLinesWithHalos;
+	QOpenGLShaderProgram *shaderLinesWithHalosPulled;
+	QOpenGLShaderProgram *shaderLinesWithHalosPacked;
 	QOpenGLVertexArrayObject vaoLines; // VAO remembers states of buffer objects, allowing to easily bind/unbind different buffer states for rendering different objects in a scene.
+	QOpenGLVertexArrayObject vaoLinesPulled; // no vertex attributes, everything is fetched in the vertex shader
 	QOpenGLBuffer vboLines;
+	QOpenGLBuffer vboLineScalars; // optional half float scalar per line vertex (FLOAT_VERTICES) or line point (PULLED_POSITIONS)
+	QOpenGLBuffer vboLineTrackFlags; // one byte per line point for PULLED_POSITIONS, bit 0 marks the first and bit 1 the last point of a track
+	GLuint tboLinePositions; // buffer texture views of vboLines, vboLineScalars and vboLineTrackFlags for PULLED_POSITIONS
+	GLuint tboLineScalars;
+	GLuint tboLineTrackFlags;
+	QOpenGLFunctions_3_3_Core *gl33; // buffer textures and glMultiDrawArrays, null if the context does not support OpenGL 3.3
+
+	// PROGRESSIVE REFINEMENT
+	// while the camera moves each frame draws a different window of the tracks of each group, at most interactionPointBudget points.
+	// once it stops the windows are drawn one per frame on top of each other without clearing until all tracks are drawn,
+	// the widget keeps its framebuffer between frames (QOpenGLWidget::PartialUpdate).
+	bool cameraMoving; // the camera changed less than interactionTimer ago
+	bool refining; // frames since the camera stopped accumulate windows of tracks
+	size_t progressiveFrame; // frames drawn since the camera started moving or since refining started
+	QTimer interactionTimer; // times out when the camera did not change for a moment
+	GLuint uboLineRenderParameters; // uniform buffer with the LineRenderParameters of all line shaders
+	LineRenderParameters lineRenderParameters; // last values uploaded to uboLineRenderParameters
+	bool lineRenderParametersValid; // false until the first upload
 
 	// GUI ELEMENTS
 
 	QPoint lastMousePos; // last mouse position (to determine mouse movement delta)
 
-	// vars to measure fps
+	// vars to measure fps, frames are only drawn when something changed (see update()), so idle windows report 0 fps
 	size_t frameCount = 0;
 	size_t fps = 0;
 	qint64 previousTimeFPS;
 	QElapsedTimer fpsTimer;
+	QTimer fpsIdleTimer;
+
+	// GPU time of the last frames, measured with GL_TIME_ELAPSED queries (CPU time of paintGL without OpenGL 3.3).
+	// frames alternate between two queries so the result of one can be read while the other measures
+	GLuint frameTimeQueries[2] = { 0, 0 };
+	bool frameTimeQueryPending[2] = { false, false };
+	FrameContent frameTimeQueryContent[2] = { FULL_FRAME, FULL_FRAME }; // content of the frame each query measured
+	int frameTimeQueryIndex = 0; // query of the next frame
+	QElapsedTimer frameTimer;
+	FrameContent frameContent = FULL_FRAME; // content of the frame being drawn
 
 	// memory usage
 	bool GL_NVX_gpu_memory_info_supported = false;
 	GLint total_mem_kb = 0;
 	GLint cur_avail_mem_kb = 0;
 
-	// triggers the rendering events
-	QTimer paintTimer;
-
 	QOpenGLDebugLogger *logger;
 	void printDebugMsg(const QOpenGLDebugMessage &msg) { qDebug() << qPrintable(msg.message()); }
 
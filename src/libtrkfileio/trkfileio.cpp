@@ -1,12 +1,129 @@
 #include "trkfileio.h"
+
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRK_USE_SSE2
+#endif
+
+static const int64_t TRK_SWAP_BLOCK_SIZE = 1 << 20;  ///< tracks of byte swapped files are swapped in blocks of about this size
+
+void byteSwap32(const void *pSrc, void *pDst, size_t iNumWords)
+{
+    const char* pIn = static_cast<const char*>(pSrc);
+    char* pOut = static_cast<char*>(pDst);
+    size_t i = 0;
+#ifdef TRK_USE_SSE2
+    /// swap the 16 bit halves of each word, then the bytes of each half
+    for(; i + 8 <= iNumWords; i += 8)
+    {
+        __m128i v0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 4*i));
+        __m128i v1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(pIn + 4*i + 16));
+        v0 = _mm_or_si128(_mm_slli_epi32(v0, 16), _mm_srli_epi32(v0, 16));
+        v1 = _mm_or_si128(_mm_slli_epi32(v1, 16), _mm_srli_epi32(v1, 16));
+        v0 = _mm_or_si128(_mm_slli_epi16(v0, 8), _mm_srli_epi16(v0, 8));
+        v1 = _mm_or_si128(_mm_slli_epi16(v1, 8), _mm_srli_epi16(v1, 8));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 4*i), v0);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pOut + 4*i + 16), v1);
+    }
+#endif
+    for(; i < iNumWords; ++i)
+    {
+        uint32_t w;
+        memcpy(&w, pIn + 4*i, sizeof(w));
+        w = (w >> 24) | ((w >> 8) & 0xFF00) | ((w << 8) & 0xFF0000) | (w << 24);
+        memcpy(pOut + 4*i, &w, sizeof(w));
+    }
+}
+
+void deinterleaveColumns(const void *pSrc, size_t iNumRows, int iNumColumns, float *pDst, size_t iColumnStride)
+{
+    const char* pIn = static_cast<const char*>(pSrc);
+    if( iNumColumns == 1 )
+    {
+        memcpy(pDst, pIn, iNumRows*sizeof(float));
+        return;
+    }
+    size_t i = 0;
+#ifdef TRK_USE_SSE2
+    if( iNumColumns == 2 )
+    {
+        /// 4 rows of 2 floats: even floats are the first column, odd floats the second
+        for(; i + 4 <= iNumRows; i += 4)
+        {
+            __m128 v0 = _mm_loadu_ps(reinterpret_cast<const float*>(pIn + 8*i));
+            __m128 v1 = _mm_loadu_ps(reinterpret_cast<const float*>(pIn + 8*i + 16));
+            _mm_storeu_ps(pDst + i, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(2,0,2,0)));
+            _mm_storeu_ps(pDst + iColumnStride + i, _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(3,1,3,1)));
+        }
+    }
+    else if( iNumColumns == 4 )
+    {
+        /// transpose 4 rows of 4 floats
+        for(; i + 4 <= iNumRows; i += 4)
+        {
+            __m128 v0 = _mm_loadu_ps(reinterpret_cast<const float*>(pIn + 16*i));
+            __m128 v1 = _mm_loadu_ps(reinterpret_cast<const float*>(pIn + 16*i + 16));
+            __m128 v2 = _mm_loadu_ps(reinterpret_cast<const float*>(pIn + 16*i + 32));
+            __m128 v3 = _mm_loadu_ps(reinterpret_cast<const float*>(pIn + 16*i + 48));
+            _MM_TRANSPOSE4_PS(v0, v1, v2, v3);
+            _mm_storeu_ps(pDst + i, v0);
+            _mm_storeu_ps(pDst + iColumnStride + i, v1);
+            _mm_storeu_ps(pDst + 2*iColumnStride + i, v2);
+            _mm_storeu_ps(pDst + 3*iColumnStride + i, v3);
+        }
+    }
+#endif
+    for(; i < iNumRows; ++i)
+        for(int c = 0; c < iNumColumns; ++c)
+            memcpy(pDst + c*iColumnStride + i, pIn + (i*iNumColumns + c)*sizeof(float), sizeof(float));
+}
+
+static void xByteSwap16(int16_t* pValues, size_t iNumValues)
+{
+    for(size_t i = 0; i < iNumValues; ++i)
+    {
+        uint16_t w = static_cast<uint16_t>(pValues[i]);
+        pValues[i] = static_cast<int16_t>((w >> 8) | (w << 8));
+    }
+}
+
+void TrkFileHeader::swapByteOrder()
+{
+    xByteSwap16(dim, 3);
+    byteSwap32(voxel_size, voxel_size, 3);
+    byteSwap32(origin, origin, 3);
+    xByteSwap16(&n_scalars, 1);
+    xByteSwap16(&n_properties, 1);
+    byteSwap32(vox_to_ras, vox_to_ras, 16);
+    byteSwap32(image_orientation_patient, image_orientation_patient, 6);
+    byteSwap32(&n_count, &n_count, 1);
+    byteSwap32(&version, &version, 1);
+    byteSwap32(&hdr_size, &hdr_size, 1);
+}
+
+
 TrkFileReader::TrkFileReader()
 {
+    m_pMappedData = NULL;
+    m_iMappedSize = 0;
+    m_bUseSidecarIndex = false;
+    m_bByteSwapped = false;
     xInit();
 }
 
 
 TrkFileReader::TrkFileReader(string &strFilepath)
 {
+    m_pMappedData = NULL;
+    m_iMappedSize = 0;
+    m_bUseSidecarIndex = false;
+    m_bByteSwapped = false;
     xInit();
     m_cFilepath = strFilepath;
 }
@@ -39,70 +156,388 @@ bool TrkFileReader::open()
     m_cFile.read((char*)(&m_cHeader), TRK_HEADER_SIZE);   ///< read header
     assert(m_cFile.gcount() == TRK_HEADER_SIZE);          ///< read check
 
-    if( m_cHeader.n_properties != 0 )
-        cerr << "n_properties is not 0:" << m_cHeader.n_properties << endl;
-    if( m_cHeader.n_scalars != 0 )
-        cerr << "n_scalars is not 0:" << m_cHeader.n_scalars << endl;
+    if( !xDetectByteOrder() || m_cHeader.n_scalars < 0 || m_cHeader.n_properties < 0 )
+    {
+        cerr << "invalid n_scalars or n_properties:" << m_cHeader.n_scalars << " " << m_cHeader.n_properties << endl;
+        close();
+        return false;
+    }
 
-    /// build the random access table (track number to file offset map)
-    static TrkInfo cTrkInfo;
-    m_iTrkPos = 0;
-    m_cRandomAccessMap.clear();
-    int32_t iTrkSizeInByte = 0;
-    while(!m_cFile.eof())
+    /// build the random access table (track number to file offset)
+    if( !xLoadSidecarIndex() )
+    {
+        if( !xBuildTrackIndexFromStream() )
+        {
+            close();
+            return false;
+        }
+        xSaveSidecarIndex();
+    }
+    xResetPos();
+    return true;
+
+}
+
+bool TrkFileReader::xDetectByteOrder()
+{
+    /// hdr_size is always 1000, read in the wrong byte order it is 0xE8030000
+    m_bByteSwapped = false;
+    if( m_cHeader.hdr_size == TRK_HEADER_SIZE )
+        return true;
+    int32_t iSwappedHdrSize;
+    byteSwap32(&m_cHeader.hdr_size, &iSwappedHdrSize, 1);
+    if( iSwappedHdrSize == TRK_HEADER_SIZE )
+    {
+        m_bByteSwapped = true;
+        m_cHeader.swapByteOrder();
+        return true;
+    }
+    cerr << "unexpected hdr_size, assuming native byte order:" << m_cHeader.hdr_size << endl;
+    return true;
+}
+
+bool TrkFileReader::xBuildTrackIndexFromStream()
+{
+    TrkInfo cTrkInfo;
+    m_cTrackIndex.clear();
+    m_cFile.seekg(0, ios::end);
+    const int64_t iFileSize = static_cast<int64_t>(m_cFile.tellg());
+    int64_t iOffset = TRK_HEADER_SIZE;
+    m_cFile.seekg(iOffset);
+    while( iOffset < iFileSize )
     {
         /// read track info
         m_cFile.read((char*)(&m_iPntPosMax), sizeof(int32_t));
-        iTrkSizeInByte = ((3+m_cHeader.n_scalars)*m_iPntPosMax + m_cHeader.n_properties)*sizeof(float);
+        if( m_cFile.gcount() != sizeof(int32_t) )
+        {
+            cerr << "Track" << m_cTrackIndex.size() << "is truncated" << endl;
+            return false;
+        }
+        if( m_bByteSwapped )
+            byteSwap32(&m_iPntPosMax, &m_iPntPosMax, 1);
+        iOffset += sizeof(int32_t);
+        int64_t iTrkSizeInByte = ((3+m_cHeader.n_scalars)*static_cast<int64_t>(m_iPntPosMax) + m_cHeader.n_properties)*sizeof(float);
+        if( m_iPntPosMax < 0 || iOffset + iTrkSizeInByte > iFileSize )
+        {
+            cerr << "Track" << m_cTrackIndex.size() << "is truncated or has an invalid number of points:" << m_iPntPosMax << endl;
+            return false;
+        }
         /// save track position and length in byte
         cTrkInfo.numPntsInTrk = m_iPntPosMax;
-        cTrkInfo.trackOffset = m_cFile.tellg();
+        cTrkInfo.trackOffset = iOffset;
         cTrkInfo.lengthInByte = iTrkSizeInByte;
-        m_cRandomAccessMap[m_iTrkPos] = cTrkInfo;
+        m_cTrackIndex.push_back(cTrkInfo);
         /// move to next track
-        m_cFile.seekg( iTrkSizeInByte, ios::cur);
-        m_cFile.peek();
-        ++m_iTrkPos;
+        iOffset += iTrkSizeInByte;
+        m_cFile.seekg(iOffset);
+    }
+    return true;
+}
+
+bool TrkFileReader::xGetFileStat(int64_t &iSize, int64_t &iMtime) const
+{
+    struct stat cStat;
+    if( stat(m_cFilepath.c_str(), &cStat) != 0 )
+        return false;
+    iSize = static_cast<int64_t>(cStat.st_size);
+    /// nanoseconds, a file rewritten with the same size within a second must not keep its index
+#if defined(__APPLE__)
+    iMtime = static_cast<int64_t>(cStat.st_mtimespec.tv_sec)*1000000000 + cStat.st_mtimespec.tv_nsec;
+#elif defined(_WIN32)
+    iMtime = static_cast<int64_t>(cStat.st_mtime)*1000000000;
+#else
+    iMtime = static_cast<int64_t>(cStat.st_mtim.tv_sec)*1000000000 + cStat.st_mtim.tv_nsec;
+#endif
+    return true;
+}
+
+bool TrkFileReader::saveIndex(const string &strIndexFilepath) const
+{
+    TrkIndexFileHeader cIndexHeader;
+    memset(&cIndexHeader, 0, sizeof(cIndexHeader));
+    memcpy(cIndexHeader.magic, TRK_INDEX_MAGIC, sizeof(TRK_INDEX_MAGIC));
+    cIndexHeader.version = TRK_INDEX_VERSION;
+    if( !xGetFileStat(cIndexHeader.trk_file_size, cIndexHeader.trk_file_mtime) )
+        return false;
+    cIndexHeader.n_scalars = m_cHeader.n_scalars;
+    cIndexHeader.n_properties = m_cHeader.n_properties;
+    cIndexHeader.n_tracks = static_cast<int64_t>(m_cTrackIndex.size());
+
+    /// store offsets and point numbers as two flat arrays
+    vector<int64_t> aiOffsets(m_cTrackIndex.size());
+    vector<int32_t> aiNumPnts(m_cTrackIndex.size());
+    for(size_t i = 0; i < m_cTrackIndex.size(); ++i)
+    {
+        aiOffsets[i] = m_cTrackIndex[i].trackOffset;
+        aiNumPnts[i] = m_cTrackIndex[i].numPntsInTrk;
+    }
+
+    fstream cIndexFile(strIndexFilepath.c_str(), ios::out|ios::binary|ios::trunc);
+    if( !cIndexFile.is_open() )
+    {
+        cerr << "fail to create index file " << strIndexFilepath << endl;
+        return false;
+    }
+    cIndexFile.write((char*)&cIndexHeader, sizeof(cIndexHeader));
+    cIndexFile.write((char*)aiOffsets.data(), aiOffsets.size()*sizeof(int64_t));
+    cIndexFile.write((char*)aiNumPnts.data(), aiNumPnts.size()*sizeof(int32_t));
+    return cIndexFile.good();
+}
+
+bool TrkFileReader::loadIndex(const string &strIndexFilepath)
+{
+    fstream cIndexFile(strIndexFilepath.c_str(), ios::in|ios::binary);
+    if( !cIndexFile.is_open() )
+        return false;
+
+    /// validate the index against the track file
+    TrkIndexFileHeader cIndexHeader;
+    cIndexFile.read((char*)&cIndexHeader, sizeof(cIndexHeader));
+    int64_t iFileSize, iFileMtime;
+    if( cIndexFile.gcount() != sizeof(cIndexHeader)
+        || memcmp(cIndexHeader.magic, TRK_INDEX_MAGIC, sizeof(TRK_INDEX_MAGIC)) != 0
+        || cIndexHeader.version != TRK_INDEX_VERSION
+        || !xGetFileStat(iFileSize, iFileMtime)
+        || cIndexHeader.trk_file_size != iFileSize
+        || cIndexHeader.trk_file_mtime != iFileMtime
+        || cIndexHeader.n_scalars != m_cHeader.n_scalars
+        || cIndexHeader.n_properties != m_cHeader.n_properties
+        || cIndexHeader.n_tracks < 0 )
+        return false;
+
+    /// the index must hold exactly n_tracks offsets and point numbers, checked before allocating them
+    const int64_t iIndexEntrySize = sizeof(int64_t) + sizeof(int32_t);
+    cIndexFile.seekg(0, ios::end);
+    const int64_t iIndexSize = static_cast<int64_t>(cIndexFile.tellg());
+    if( iIndexSize < static_cast<int64_t>(sizeof(cIndexHeader))
+        || cIndexHeader.n_tracks > (iIndexSize - static_cast<int64_t>(sizeof(cIndexHeader)))/iIndexEntrySize
+        || iIndexSize != static_cast<int64_t>(sizeof(cIndexHeader)) + cIndexHeader.n_tracks*iIndexEntrySize )
+        return false;
+    cIndexFile.seekg(sizeof(cIndexHeader));
+
+    size_t iNumTracks = static_cast<size_t>(cIndexHeader.n_tracks);
+    vector<int64_t> aiOffsets(iNumTracks);
+    vector<int32_t> aiNumPnts(iNumTracks);
+    cIndexFile.read((char*)aiOffsets.data(), iNumTracks*sizeof(int64_t));
+    cIndexFile.read((char*)aiNumPnts.data(), iNumTracks*sizeof(int32_t));
+    if( !cIndexFile.good() )
+        return false;
+
+    /// the tracks follow each other without gaps from the end of the header to the end of the file,
+    /// like the index builders found them, so no track can point into the header or outside of the file
+    m_cTrackIndex.resize(iNumTracks);
+    const int64_t iPntSizeInByte = (3+m_cHeader.n_scalars)*sizeof(float);
+    int64_t iNextOffset = TRK_HEADER_SIZE + sizeof(int32_t);
+    for(size_t i = 0; i < iNumTracks; ++i)
+    {
+        TrkInfo& cTrkInfo = m_cTrackIndex[i];
+        cTrkInfo.trackOffset = aiOffsets[i];
+        cTrkInfo.numPntsInTrk = aiNumPnts[i];
+        cTrkInfo.lengthInByte = iPntSizeInByte*aiNumPnts[i] + m_cHeader.n_properties*sizeof(float);
+        if( cTrkInfo.numPntsInTrk < 0 || cTrkInfo.trackOffset != iNextOffset || cTrkInfo.trackOffset + cTrkInfo.lengthInByte > iFileSize )
+        {
+            m_cTrackIndex.clear();
+            return false;
+        }
+        iNextOffset = cTrkInfo.trackOffset + cTrkInfo.lengthInByte + sizeof(int32_t);
+    }
+    if( iNextOffset - static_cast<int64_t>(sizeof(int32_t)) != iFileSize )
+    {
+        m_cTrackIndex.clear();
+        return false;
+    }
+    return true;
+}
+
+bool TrkFileReader::xLoadSidecarIndex()
+{
+    if( !m_bUseSidecarIndex )
+        return false;
+    return loadIndex(getDefaultIndexFilepath());
+}
+
+void TrkFileReader::xSaveSidecarIndex()
+{
+    if( !m_bUseSidecarIndex )
+        return;
+    /// failing to save is not an error, the index is simply rebuilt next time
+    if( !saveIndex(getDefaultIndexFilepath()) )
+        cerr << "could not save track index next to " << m_cFilepath << endl;
+}
+
+bool TrkFileReader::openMapped()
+{
+#ifdef _WIN32
+    cerr << "memory-mapped reading is not supported on this platform" << endl;
+    return false;
+#else
+    /// map the whole trk file read-only
+    int iFd = ::open(m_cFilepath.c_str(), O_RDONLY);
+    if( iFd < 0 )
+    {
+        cerr << "fail to open file" << endl;
+        return false;
+    }
+    struct stat cStat;
+    if( fstat(iFd, &cStat) != 0 || cStat.st_size < TRK_HEADER_SIZE )
+    {
+        cerr << "file is too small to be a track file" << endl;
+        ::close(iFd);
+        return false;
+    }
+    void* pMapping = mmap(NULL, static_cast<size_t>(cStat.st_size), PROT_READ, MAP_PRIVATE, iFd, 0);
+    ::close(iFd);   ///< the mapping keeps its own reference to the file
+    if( pMapping == MAP_FAILED )
+    {
+        cerr << "fail to map file" << endl;
+        return false;
+    }
+    madvise(pMapping, static_cast<size_t>(cStat.st_size), MADV_SEQUENTIAL);
+    m_pMappedData = static_cast<const char*>(pMapping);
+    m_iMappedSize = static_cast<size_t>(cStat.st_size);
+
+    assert(sizeof(m_cHeader) == TRK_HEADER_SIZE);             ///< make sure header is 1000 bytes
+    memcpy(&m_cHeader, m_pMappedData, TRK_HEADER_SIZE);       ///< read header
+
+    if( !xDetectByteOrder() || m_cHeader.n_scalars < 0 || m_cHeader.n_properties < 0 )
+    {
+        cerr << "invalid n_scalars or n_properties:" << m_cHeader.n_scalars << " " << m_cHeader.n_properties << endl;
+        close();
+        return false;
+    }
+
+    if( !xLoadSidecarIndex() )
+    {
+        if( !xBuildTrackIndexFromMapping() )
+        {
+            close();
+            return false;
+        }
+        xSaveSidecarIndex();
     }
     xResetPos();
     return true;
+#endif
+}
+
+bool TrkFileReader::xBuildTrackIndexFromMapping()
+{
+    /// walk the track headers in memory, no stream state and no seeks involved
+    TrkInfo cTrkInfo;
+    m_cTrackIndex.clear();
+    size_t iOffset = TRK_HEADER_SIZE;
+    while( iOffset < m_iMappedSize )
+    {
+        if( iOffset + sizeof(int32_t) > m_iMappedSize )
+        {
+            cerr << "Track" << m_cTrackIndex.size() << "is truncated" << endl;
+            return false;
+        }
+        int32_t iNumPnts;
+        memcpy(&iNumPnts, m_pMappedData + iOffset, sizeof(int32_t));
+        if( m_bByteSwapped )
+            byteSwap32(&iNumPnts, &iNumPnts, 1);
+        iOffset += sizeof(int32_t);
+        size_t iTrkSizeInByte = (static_cast<size_t>(3+m_cHeader.n_scalars)*iNumPnts + m_cHeader.n_properties)*sizeof(float);
+        if( iNumPnts < 0 || iOffset + iTrkSizeInByte > m_iMappedSize )
+        {
+            cerr << "Track" << m_cTrackIndex.size() << "is truncated or has an invalid number of points:" << iNumPnts << endl;
+            return false;
+        }
+        /// save track position and length in byte
+        cTrkInfo.numPntsInTrk = iNumPnts;
+        cTrkInfo.trackOffset = static_cast<int64_t>(iOffset);
+        cTrkInfo.lengthInByte = static_cast<int64_t>(iTrkSizeInByte);
+        m_cTrackIndex.push_back(cTrkInfo);
+        /// move to next track
+        iOffset += iTrkSizeInByte;
+    }
+    return true;
+}
 
+void TrkFileReader::xUnmap()
+{
+#ifndef _WIN32
+    if( m_pMappedData != NULL )
+        munmap(const_cast<char*>(m_pMappedData), m_iMappedSize);
+#endif
+    m_pMappedData = NULL;
+    m_iMappedSize = 0;
 }
 
 void TrkFileReader::close()
 {
+    xUnmap();
     xInit();
+    m_cTrackIndex.clear();
     m_cFile.close();
 }
 
+bool TrkFileReader::getTrackView(size_t iTrkIdx, TrkView &view) const
+{
+    if( m_pMappedData == NULL || m_bByteSwapped || iTrkIdx >= m_cTrackIndex.size() )
+        return false;
+    const TrkInfo& cTrkInfo = m_cTrackIndex[iTrkIdx];
+    view.pntStride = 3+m_cHeader.n_scalars;
+    view.numPnts = cTrkInfo.numPntsInTrk;
+    view.points = reinterpret_cast<const float*>(m_pMappedData + cTrkInfo.trackOffset);  ///< 4-byte aligned, the mapping is page aligned
+    view.properties = view.points + static_cast<size_t>(view.pntStride)*view.numPnts;
+    return true;
+}
+
 bool TrkFileReader::readTrack(size_t iTrkIdx, vector<float> &points)
 {
-    map<int32_t,TrkInfo>::iterator it = m_cRandomAccessMap.find(static_cast<int32_t>(iTrkIdx));
-    if( it ==  m_cRandomAccessMap.end() )
+    if( iTrkIdx >= m_cTrackIndex.size() )
         return false;
-    TrkInfo& cTrkInfo = it->second;
+    TrkInfo& cTrkInfo = m_cTrackIndex[iTrkIdx];
     int iTotalPoints = cTrkInfo.numPntsInTrk;
-    static float afPoint[3];
-    m_cFile.seekg(cTrkInfo.trackOffset);    /// seek to track
-    points.clear();
-    for(int i = 0; i < iTotalPoints; i++)
+    size_t iTrkSizeInFloats = static_cast<size_t>(cTrkInfo.lengthInByte/sizeof(float));
+    vector<float> afTrack;
+    const float* pTrack;
+    if( m_pMappedData != NULL )
     {
-        m_cFile.read((char*)(afPoint), sizeof(float)*3);    /// read three component
-        m_cFile.seekg(sizeof(float)*m_cHeader.n_scalars, ios::cur); /// ignore scalars
-        for(int j = 0; j < 3; ++j)
-            points.push_back(afPoint[j]);
+        pTrack = reinterpret_cast<const float*>(m_pMappedData + cTrkInfo.trackOffset);
     }
+    else
+    {
+        /// read the whole track record at once, then strip the scalars
+        afTrack.resize(iTrkSizeInFloats);
+        m_cFile.seekg(cTrkInfo.trackOffset);    /// seek to track
+        m_cFile.read((char*)afTrack.data(), cTrkInfo.lengthInByte);
+        if( m_cFile.gcount() != static_cast<streamsize>(cTrkInfo.lengthInByte) )
+        {
+            m_cFile.clear();
+            return false;
+        }
+        pTrack = afTrack.data();
+    }
+    if( m_bByteSwapped )
+    {
+        afTrack.resize(iTrkSizeInFloats);
+        byteSwap32(pTrack, afTrack.data(), iTrkSizeInFloats);
+        pTrack = afTrack.data();
+    }
+    points.resize(3*static_cast<size_t>(iTotalPoints));
+    for(int i = 0; i < iTotalPoints; i++)
+        memcpy(&points[3*i], pTrack + static_cast<size_t>(i)*(3+m_cHeader.n_scalars), sizeof(float)*3);
     return true;
 
 }
 
 bool TrkFileReader::readPoint(int iTrkIdx, int iPntIdx, vector<float> &point)
 {
-    map<int32_t,TrkInfo>::iterator it = m_cRandomAccessMap.find(iTrkIdx);
-    if( it ==  m_cRandomAccessMap.end() )
+    if( iTrkIdx < 0 || static_cast<size_t>(iTrkIdx) >= m_cTrackIndex.size() )
         return false;
-    TrkInfo& rcTrk = it->second;
-    streamoff iOffset = rcTrk.trackOffset+(3+m_cHeader.n_scalars)*iPntIdx*sizeof(float);
+    TrkInfo& rcTrk = m_cTrackIndex[iTrkIdx];
+    if( m_pMappedData != NULL )
+    {
+        const float* pPoint = reinterpret_cast<const float*>(m_pMappedData + rcTrk.trackOffset) + (3+m_cHeader.n_scalars)*static_cast<size_t>(iPntIdx);
+        point.assign(pPoint, pPoint+3);
+        if( m_bByteSwapped )
+            byteSwap32(point.data(), point.data(), 3);
+        return true;
+    }
+    streamoff iOffset = rcTrk.trackOffset+(3+m_cHeader.n_scalars)*static_cast<int64_t>(iPntIdx)*sizeof(float);
     m_cFile.seekg(iOffset);
 
     float fCoord;
@@ -112,6 +547,188 @@ bool TrkFileReader::readPoint(int iTrkIdx, int iPntIdx, vector<float> &point)
         m_cFile.read((char*)(&fCoord), sizeof(float));
         point.push_back(fCoord);
     }
+    if( m_bByteSwapped )
+        byteSwap32(point.data(), point.data(), 3);
+    return true;
+}
+
+bool TrkFileReader::readAllTracks(vector<float> &positions, vector<int64_t> &trackOffsets)
+{
+    return readTracks(0, m_cTrackIndex.size(), positions, trackOffsets);
+}
+
+bool TrkFileReader::readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float> &positions, vector<int64_t> &trackOffsets)
+{
+    return readTracks(iFirstTrkIdx, iNumTrks, positions, trackOffsets, NULL, NULL);
+}
+
+/**
+ * @brief xDeinterleavePoints Split interleaved points (x, y, z, scalars) into x, y, z positions and one column per scalar
+ * @param pSrc first point
+ * @param iNumPnts number of points
+ * @param iNumScalars scalars per point
+ * @param pPos output positions, 3 floats per point
+ * @param pPosEnd end of the position buffer, 4 floats are stored per point where the buffer allows it
+ * @param pScalars first scalar column, NULL to skip scalars
+ * @param iColumnStride distance between two scalar columns in floats
+ */
+static void xDeinterleavePoints(const float* pSrc, int32_t iNumPnts, int iNumScalars, float* pPos, const float* pPosEnd, float* pScalars, size_t iColumnStride)
+{
+    const int iPntStride = 3+iNumScalars;
+    int32_t i = 0;
+#ifdef TRK_USE_SSE2
+    if( iNumScalars == 1 )
+    {
+        /// one scalar (e.g. FA): transpose 4 points of x, y, z, s, the last row is the scalar column
+        for(; i + 4 <= iNumPnts && pPos + 3*i + 13 <= pPosEnd; i += 4)
+        {
+            __m128 vP0 = _mm_loadu_ps(pSrc + 4*i);
+            __m128 vP1 = _mm_loadu_ps(pSrc + 4*i + 4);
+            __m128 vP2 = _mm_loadu_ps(pSrc + 4*i + 8);
+            __m128 vP3 = _mm_loadu_ps(pSrc + 4*i + 12);
+            _mm_storeu_ps(pPos + 3*i, vP0);     ///< the 4th float is overwritten by the next point
+            _mm_storeu_ps(pPos + 3*i + 3, vP1);
+            _mm_storeu_ps(pPos + 3*i + 6, vP2);
+            _mm_storeu_ps(pPos + 3*i + 9, vP3);
+            if( pScalars != NULL )
+            {
+                _MM_TRANSPOSE4_PS(vP0, vP1, vP2, vP3);
+                _mm_storeu_ps(pScalars + i, vP3);
+            }
+        }
+    }
+    else
+    {
+        for(; i < iNumPnts && pPos + 3*i + 4 <= pPosEnd; ++i)
+        {
+            const float* pPnt = pSrc + static_cast<size_t>(i)*iPntStride;
+            _mm_storeu_ps(pPos + 3*i, _mm_loadu_ps(pPnt));
+            if( pScalars != NULL )
+                for(int s = 0; s < iNumScalars; ++s)
+                    pScalars[s*iColumnStride + i] = pPnt[3+s];
+        }
+    }
+#endif
+    for(; i < iNumPnts; ++i)
+    {
+        const float* pPnt = pSrc + static_cast<size_t>(i)*iPntStride;
+        pPos[3*i] = pPnt[0];
+        pPos[3*i+1] = pPnt[1];
+        pPos[3*i+2] = pPnt[2];
+        if( pScalars != NULL )
+            for(int s = 0; s < iNumScalars; ++s)
+                pScalars[s*iColumnStride + i] = pPnt[3+s];
+    }
+}
+
+bool TrkFileReader::readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float> &positions, vector<int64_t> &trackOffsets, vector<float> *scalars, vector<float> *properties)
+{
+    if( !m_pMappedData && !m_cFile.is_open() )
+        return false;
+    if( iFirstTrkIdx + iNumTrks > m_cTrackIndex.size() )
+        return false;
+
+    /// track table already knows all point numbers, so allocate once
+    trackOffsets.resize(iNumTrks+1);
+    trackOffsets[0] = 0;
+    int64_t iTotalPoints = 0;
+    for(size_t i = 0; i < iNumTrks; ++i)
+    {
+        iTotalPoints += m_cTrackIndex[iFirstTrkIdx+i].numPntsInTrk;
+        trackOffsets[i+1] = iTotalPoints;
+    }
+    const int iNumScalars = m_cHeader.n_scalars;
+    const int iNumProperties = m_cHeader.n_properties;
+    positions.resize(3*static_cast<size_t>(iTotalPoints));
+    if( scalars != NULL )
+        scalars->resize(static_cast<size_t>(iNumScalars)*iTotalPoints);
+    if( properties != NULL )
+        properties->resize(static_cast<size_t>(iNumProperties)*iNumTrks);
+    if( iNumTrks == 0 )
+        return true;
+
+    const int iPntStride = 3+iNumScalars;
+    float* pDst = positions.data();
+    const float* pDstEnd = pDst + positions.size();
+    float* pScalarDst = (scalars != NULL && iNumScalars > 0) ? scalars->data() : NULL;
+    vector<float> afTrackBuffer;    ///< reused for stream reading and byte swapping
+    size_t iSwapBlockEnd = iFirstTrkIdx;    ///< tracks before this one are in the swapped block
+    int64_t iSwapBlockOffset = 0;           ///< file offset of the swapped block
+    if( m_pMappedData == NULL )
+        m_cFile.seekg(m_cTrackIndex[iFirstTrkIdx].trackOffset - static_cast<int64_t>(sizeof(int32_t)));
+
+    for(size_t iTrkIdx = iFirstTrkIdx; iTrkIdx < iFirstTrkIdx+iNumTrks; ++iTrkIdx)
+    {
+        const TrkInfo& cTrkInfo = m_cTrackIndex[iTrkIdx];
+        const float* pSrc;
+        if( m_bByteSwapped )
+        {
+            /// swap blocks of whole tracks (point numbers included) in bulk instead of single values
+            if( iTrkIdx >= iSwapBlockEnd )
+            {
+                int64_t iBlockSize = 0;
+                while( iSwapBlockEnd < iFirstTrkIdx+iNumTrks && (iBlockSize == 0 || iBlockSize < TRK_SWAP_BLOCK_SIZE) )
+                    iBlockSize += static_cast<int64_t>(sizeof(int32_t)) + m_cTrackIndex[iSwapBlockEnd++].lengthInByte;
+                iSwapBlockOffset = cTrkInfo.trackOffset - static_cast<int64_t>(sizeof(int32_t));
+                afTrackBuffer.resize(static_cast<size_t>(iBlockSize/sizeof(float)));
+                const char* pBlock;
+                if( m_pMappedData != NULL )
+                    pBlock = m_pMappedData + iSwapBlockOffset;
+                else
+                {
+                    /// the stream is at the start of the block, tracks are stored back to back
+                    m_cFile.read((char*)afTrackBuffer.data(), iBlockSize);
+                    if( m_cFile.gcount() != static_cast<streamsize>(iBlockSize) )
+                    {
+                        cerr << "Reading Fail for #:" << iTrkIdx << "Track" << endl;
+                        m_cFile.clear();
+                        xResetPos();
+                        return false;
+                    }
+                    pBlock = (const char*)afTrackBuffer.data();
+                }
+                byteSwap32(pBlock, afTrackBuffer.data(), afTrackBuffer.size());
+            }
+            pSrc = afTrackBuffer.data() + (cTrkInfo.trackOffset - iSwapBlockOffset)/sizeof(float);
+        }
+        else if( m_pMappedData != NULL )
+        {
+            pSrc = reinterpret_cast<const float*>(m_pMappedData + cTrkInfo.trackOffset);
+        }
+        else
+        {
+            /// tracks are stored back to back, so the stream is read strictly sequentially
+            size_t iTrkSizeInFloats = static_cast<size_t>(cTrkInfo.lengthInByte/sizeof(float));
+            afTrackBuffer.resize(iTrkSizeInFloats);
+            m_cFile.seekg(sizeof(int32_t), ios::cur);   ///< skip point number
+            m_cFile.read((char*)afTrackBuffer.data(), cTrkInfo.lengthInByte);
+            if( m_cFile.gcount() != static_cast<streamsize>(cTrkInfo.lengthInByte) )
+            {
+                cerr << "Reading Fail for #:" << iTrkIdx << "Track" << endl;
+                m_cFile.clear();
+                xResetPos();
+                return false;
+            }
+            pSrc = afTrackBuffer.data();
+        }
+
+        /// positions interleaved, scalars and properties into one column each
+        if( iPntStride == 3 )
+            memcpy(pDst, pSrc, sizeof(float)*3*cTrkInfo.numPntsInTrk);
+        else
+            xDeinterleavePoints(pSrc, cTrkInfo.numPntsInTrk, iNumScalars, pDst, pDstEnd, pScalarDst, static_cast<size_t>(iTotalPoints));
+        pDst += 3*static_cast<size_t>(cTrkInfo.numPntsInTrk);
+        if( pScalarDst != NULL )
+            pScalarDst += cTrkInfo.numPntsInTrk;
+        if( properties != NULL )
+        {
+            const float* pProperties = pSrc + static_cast<size_t>(iPntStride)*cTrkInfo.numPntsInTrk;
+            for(int k = 0; k < iNumProperties; ++k)
+                (*properties)[k*iNumTrks + (iTrkIdx-iFirstTrkIdx)] = pProperties[k];
+        }
+    }
+    if( m_pMappedData == NULL )
+        xResetPos();    ///< the mapped path does not modify the reader, so it can be used from several threads
     return true;
 }
 
@@ -125,18 +742,16 @@ void TrkFileReader::xResetPos()
 
 size_t TrkFileReader::getTotalTrkNum()
 {
-    return m_cRandomAccessMap.size();
+    return m_cTrackIndex.size();
 }
 
 size_t TrkFileReader::getPointNumInTrk(int iIdx)
 {
-    map<int32_t,TrkInfo>::iterator it = m_cRandomAccessMap.find(iIdx);
-    if( it ==  m_cRandomAccessMap.end() )
+    if( iIdx < 0 || static_cast<size_t>(iIdx) >= m_cTrackIndex.size() )
         return -1;
-    return it->second.numPntsInTrk;
+    return m_cTrackIndex[iIdx].numPntsInTrk;
 }
 
-
 void TrkFileReader::checkFile()
 {
     cerr << "Start Checking..." << endl;
@@ -144,6 +759,7 @@ void TrkFileReader::checkFile()
 
     assert(sizeof(m_cHeader) == TRK_HEADER_SIZE);      ///< make sure header is 1000 bytes
     m_cFile.read((char*)(&m_cHeader), TRK_HEADER_SIZE);  ///< read header
+    xDetectByteOrder();
 
     cerr << "n_count:" << m_cHeader.n_count << "\nn_scalars:" << m_cHeader.n_scalars << "\nn_properties:" << m_cHeader.n_properties << endl;
 
@@ -158,6 +774,8 @@ void TrkFileReader::checkFile()
     {
 
         m_cFile.read((char*)(&m_iPntPosMax), sizeof(int32_t));
+        if( m_bByteSwapped )
+            byteSwap32(&m_iPntPosMax, &m_iPntPosMax, 1);
         cerr << "Track" << m_iTrkPos << ":" << m_iPntPosMax << "points" << endl;
 
         for(m_iPntPos = 0; m_iPntPos < m_iPntPosMax; ++m_iPntPos)
@@ -185,13 +803,16 @@ void TrkFileReader::checkFile()
 
 TrkFileWriter::TrkFileWriter()
 {
-
+    m_iNumTrksWritten = 0;
+    m_iFlushedSize = 0;
 }
 
 
 TrkFileWriter::TrkFileWriter(string &strFilepath)
 {
     m_cFilepath = strFilepath;
+    m_iNumTrksWritten = 0;
+    m_iFlushedSize = 0;
 }
 
 
@@ -202,14 +823,20 @@ TrkFileWriter::~TrkFileWriter()
 
 bool TrkFileWriter::create()
 {
-    /// open trk file
-    m_cFile.open(m_cFilepath.c_str(), ios::out|ios::binary);
+    /// open trk file, unbuffered since we write large blocks ourselves
+    m_cFile.rdbuf()->pubsetbuf(NULL, 0);
+    m_cFile.open(m_cFilepath.c_str(), ios::out|ios::binary|ios::trunc);
     if( !m_cFile.is_open() )
     {
         cerr << "fail to open file" << endl;
         return false;
     }
+    m_iNumTrksWritten = 0;
+    m_cHeader.n_count = 0;
     xWriteHeader();
+    m_iFlushedSize = TRK_HEADER_SIZE;
+    m_acBuffer.clear();
+    m_acBuffer.reserve(TRK_WRITE_BLOCK_SIZE);
     return true;
 }
 
@@ -221,54 +848,161 @@ bool TrkFileWriter::appendTrack(vector<float> &points)
         cerr << "point number cannot divided by 3" << endl;
         return false;
     }
-    /// append
-    m_cFile.seekp(0, ios::end);
+    return appendTrack(points.data(), static_cast<int32_t>(points.size()/3));
+}
+
+bool TrkFileWriter::appendTrack(const float *points, int32_t iNumPnts, const float *scalars, const float *properties)
+{
+    /// nothing is appended after a failed write, the file would miss tracks in between
+    if( !m_cFile.is_open() || !m_cFile.good() || iNumPnts < 0 )
+        return false;
 
     /// write total point number in this track
-    int32_t iTotalPoint = static_cast<int32_t>(points.size()/3);
-    m_cFile.write((char*)&iTotalPoint, sizeof(int32_t));
+    xAppend(&iNumPnts, sizeof(int32_t));
 
-    /// write the points
+    /// write the points, each followed by its scalars
+    size_t iNumScalars = m_cHeader.n_scalars;
+    if( iNumScalars == 0 )
+        xAppend(points, 3*static_cast<size_t>(iNumPnts)*sizeof(float));
+    else
+    {
+        for(int32_t i = 0; i < iNumPnts; i++)
+        {
+            xAppend(points + 3*static_cast<size_t>(i), 3*sizeof(float));
+            if( scalars != NULL )
+                xAppend(scalars + iNumScalars*i, iNumScalars*sizeof(float));
+            else
+                xAppendZeros(iNumScalars*sizeof(float));
+        }
+    }
 
-    m_cFile.write((char*)points.data(), points.size()*sizeof(float));
+    /// write the properties of this track
+    if( properties != NULL )
+        xAppend(properties, m_cHeader.n_properties*sizeof(float));
+    else
+        xAppendZeros(m_cHeader.n_properties*sizeof(float));
 
-    /// fill extra scalars with 0
-    float fZero = 0;
-    for(int i = 0; i < m_cHeader.n_scalars; i++)
-        m_cFile.write((char*)&fZero, sizeof(float));
+    if( !m_cFile.good() )
+        return false;
+    m_iNumTrksWritten++;
+    return true;
+}
 
+bool TrkFileWriter::appendTrack(const TrkView &view)
+{
+    if( !m_cFile.is_open() || !m_cFile.good() || view.numPnts < 0 || view.pntStride != 3+m_cHeader.n_scalars )
+        return false;
+
+    /// points, scalars and properties are contiguous in the mapped file
+    xAppend(&view.numPnts, sizeof(int32_t));
+    xAppend(view.points, (static_cast<size_t>(view.pntStride)*view.numPnts + m_cHeader.n_properties)*sizeof(float));
+    if( !m_cFile.good() )
+        return false;
+    m_iNumTrksWritten++;
+    return true;
+}
 
-    /// fill extra properties with 0
-    for(int i = 0; i < m_cHeader.n_properties; i++)
-        m_cFile.write((char*)&fZero, sizeof(float));
+bool TrkFileWriter::appendTracks(const vector<float> &positions, const vector<int64_t> &trackOffsets, const float *scalars, const float *properties)
+{
+    if( trackOffsets.empty() || 3*static_cast<size_t>(trackOffsets.back()) > positions.size() )
+        return false;
 
+    size_t iNumScalars = m_cHeader.n_scalars;
+    size_t iNumProperties = m_cHeader.n_properties;
+    for(size_t i = 0; i+1 < trackOffsets.size(); ++i)
+    {
+        int64_t iFirstPnt = trackOffsets[i];
+        if( !appendTrack(positions.data() + 3*iFirstPnt, static_cast<int32_t>(trackOffsets[i+1]-iFirstPnt),
+                         scalars != NULL ? scalars + iNumScalars*iFirstPnt : NULL,
+                         properties != NULL ? properties + iNumProperties*i : NULL) )
+            return false;
+    }
     return true;
 }
 
 void TrkFileWriter::save()
 {
+    if( !m_cFile.is_open() )
+        return;
+    xFlush();
     xWriteHeader();
-    return;
+    m_cFile.seekp(0, ios::end);
+    m_cFile.flush();
 }
 
 void TrkFileWriter::close()
 {
+    if( !m_cFile.is_open() )
+        return;
+    xFlush();
     xWriteHeader();
     m_cFile.close();
 }
 
-void TrkFileWriter::copyHeader(const TrkFileHeader &other)
+void TrkFileWriter::copyHeader(const TrkFileHeader &other, bool bKeepScalarsAndProperties)
 {
     memcpy(&m_cHeader, &other, TRK_HEADER_SIZE);
     m_cHeader.n_count = 0;
-    m_cHeader.n_properties = 0; /// TODO for now it simply ignore n_properties & n_scalars
-    m_cHeader.n_scalars = 0;
+    if( !bKeepScalarsAndProperties )
+    {
+        m_cHeader.n_properties = 0;
+        m_cHeader.n_scalars = 0;
+        memset(m_cHeader.scalar_name, 0, sizeof(m_cHeader.scalar_name));
+        memset(m_cHeader.property_name, 0, sizeof(m_cHeader.property_name));
+    }
 }
 
 
 void TrkFileWriter::xWriteHeader()
 {
+    /// after a failed write the tracks in the file are not the ones counted,
+    /// the header keeps n_count 0 (number not stored) written by create()
+    if( !m_cFile.good() )
+    {
+        cerr << "writing failed, the track number is not stored in " << m_cFilepath << endl;
+        return;
+    }
+    /// n_count is only 32 bits, 0 means the number was not stored
+    m_cHeader.n_count = m_iNumTrksWritten <= INT32_MAX ? static_cast<int32_t>(m_iNumTrksWritten) : 0;
     m_cFile.seekp(0);
     assert(sizeof(m_cHeader) == TRK_HEADER_SIZE);         ///< make sure header is 1000 bytes
     m_cFile.write((char*)(&m_cHeader), TRK_HEADER_SIZE);   ///< write header
 }
+
+void TrkFileWriter::xAppend(const void *pData, size_t iSize)
+{
+    const char* pSrc = static_cast<const char*>(pData);
+    while( iSize > 0 )
+    {
+        /// fill up to the next block boundary of the file, then write the block
+        size_t iFree = TRK_WRITE_BLOCK_SIZE - (m_iFlushedSize + m_acBuffer.size()) % TRK_WRITE_BLOCK_SIZE;
+        size_t iSizeToCopy = min(iFree, iSize);
+        m_acBuffer.insert(m_acBuffer.end(), pSrc, pSrc + iSizeToCopy);
+        pSrc += iSizeToCopy;
+        iSize -= iSizeToCopy;
+        if( iSizeToCopy == iFree )
+            xFlush();
+    }
+}
+
+void TrkFileWriter::xAppendZeros(size_t iSize)
+{
+    while( iSize > 0 )
+    {
+        size_t iFree = TRK_WRITE_BLOCK_SIZE - (m_iFlushedSize + m_acBuffer.size()) % TRK_WRITE_BLOCK_SIZE;
+        size_t iSizeToFill = min(iFree, iSize);
+        m_acBuffer.resize(m_acBuffer.size() + iSizeToFill, 0);
+        iSize -= iSizeToFill;
+        if( iSizeToFill == iFree )
+            xFlush();
+    }
+}
+
+void TrkFileWriter::xFlush()
+{
+    if( m_acBuffer.empty() )
+        return;
+    m_cFile.write(m_acBuffer.data(), m_acBuffer.size());
+    m_iFlushedSize += m_acBuffer.size();
+    m_acBuffer.clear();
+}
@@ -16,6 +16,7 @@
 using namespace std;
 
 static const int TRK_HEADER_SIZE = 1000;    ///< header size is 1000
+static const size_t TRK_WRITE_BLOCK_SIZE = 4 << 20;  ///< writer buffer size, buffered data is written in blocks aligned to this size in the file
 #pragma pack(push)                          ///< push current alignment to stack
 #pragma pack(1)                             ///< set alignment to 1 byte boundary
 /**
@@ -32,6 +33,12 @@ public:
         version = 2;
         hdr_size = 1000;
     }
+
+    /**
+     * @brief swapByteOrder Swap the byte order of all multi-byte fields
+     */
+    void swapByteOrder();
+
     char id_string[6];                          /// char	6	ID string for track file. The first 5 characters must be "TRACK".
     int16_t dim[3];                             /// short int	6	Dimension of the image volume.
     float voxel_size[3] ;                       /// float	12	Voxel size of the image volume.
@@ -59,14 +66,64 @@ public:
 #pragma pack(pop)                               /// restore original alignment from stack
 
 
+/**
+ * @brief byteSwap32 Swap the byte order of 32 bit words (floats or ints), pSrc and pDst may be the same
+ * @param pSrc
+ * @param pDst
+ * @param iNumWords number of 32 bit words
+ */
+void byteSwap32(const void* pSrc, void* pDst, size_t iNumWords);
+
+/**
+ * @brief deinterleaveColumns Split rows of interleaved floats (e.g. the scalars of each point) into one column per float
+ * @param pSrc first row, needs no alignment
+ * @param iNumRows number of rows
+ * @param iNumColumns floats per row
+ * @param pDst first column
+ * @param iColumnStride distance between two columns in pDst in floats
+ */
+void deinterleaveColumns(const void* pSrc, size_t iNumRows, int iNumColumns, float* pDst, size_t iColumnStride);
+
 /**
  * @brief The TrkInfo struct Track offset, bytes and point numbers
  */
 struct TrkInfo
 {
-    streamoff trackOffset;  ///< offset in file
-    int16_t numPntsInTrk;   ///< points in this track
-    int16_t lengthInByte;   ///< length in bytes for all points in this track
+    int64_t trackOffset;    ///< offset in file
+    int32_t numPntsInTrk;   ///< points in this track
+    int64_t lengthInByte;   ///< length in bytes for all points (and properties) in this track
+};
+
+static const char TRK_INDEX_MAGIC[8] = {'T','R','K','I','N','D','E','X'};  ///< first bytes of a sidecar index file
+static const int32_t TRK_INDEX_VERSION = 2;                                     ///< increase when the index layout changes
+#pragma pack(push)
+#pragma pack(1)
+/**
+ * @brief The TrkIndexFileHeader class header of a sidecar index file (see TrkFileReader::saveIndex)
+ * The header is followed by n_tracks int64_t track offsets and n_tracks int32_t point numbers.
+ */
+class TrkIndexFileHeader
+{
+public:
+    char magic[8];              /// TRK_INDEX_MAGIC
+    int32_t version;            /// TRK_INDEX_VERSION
+    int64_t trk_file_size;      /// size of the indexed track file in bytes
+    int64_t trk_file_mtime;     /// last modification time of the indexed track file in nanoseconds since epoch
+    int16_t n_scalars;          /// n_scalars of the indexed track file
+    int16_t n_properties;       /// n_properties of the indexed track file
+    int64_t n_tracks;           /// number of tracks in the index
+};
+#pragma pack(pop)
+
+/**
+ * @brief The TrkView struct Read-only view of one track inside a memory-mapped track file
+ */
+struct TrkView
+{
+    const float* points;        ///< first point of the track, each point is x, y, z followed by n_scalars scalars
+    const float* properties;    ///< n_properties properties stored after the last point of the track
+    int32_t numPnts;            ///< points in this track
+    int32_t pntStride;          ///< distance between two consecutive points in floats (3+n_scalars)
 };
 
 /**
@@ -80,10 +137,48 @@ public:
     ~TrkFileReader();
     /**
      * @brief open Open the track file
+     * Files written in the other byte order are detected from hdr_size and swapped while reading.
+     * If sidecar indices are enabled (setUseSidecarIndex), the track index is loaded from
+     * getDefaultIndexFilepath() if valid, else the file is scanned and the index is saved there.
      * @return
      */
     bool open();
 
+    /**
+     * @brief saveIndex Save the track index (offset and point number of every track) to a sidecar file
+     * @param strIndexFilepath
+     * @return
+     */
+    bool saveIndex(const string& strIndexFilepath) const;
+
+    /**
+     * @brief loadIndex Load the track index from a sidecar file instead of scanning the track file
+     * The index is rejected if it does not match size, modification time and header of the track file.
+     * @param strIndexFilepath
+     * @return false if the index file is missing, outdated or invalid
+     */
+    bool loadIndex(const string& strIndexFilepath);
+
+    /**
+     * @brief getDefaultIndexFilepath Get the sidecar index path used by open() and openMapped()
+     * @return track file path with ".idx" appended
+     */
+    string getDefaultIndexFilepath() const { return m_cFilepath + ".idx"; }
+
+    /**
+     * @brief openMapped Open the track file memory-mapped (read-only)
+     * Track data is then accessed directly in the mapping instead of through the file stream,
+     * see getTrackView() for zero-copy access. readTrack() and readPoint() also read from the mapping.
+     * @return false if the file could not be opened or mapped
+     */
+    bool openMapped();
+
+    /**
+     * @brief isMapped Check if the file was opened with openMapped()
+     * @return true if track data is read from a memory mapping
+     */
+    bool isMapped() const { return m_pMappedData != NULL; }
+
     /**
      * @brief close Close the track file
      */
@@ -106,6 +201,53 @@ public:
      */
     bool readPoint(int iTrkIdx, int iPntIdx, vector<float>& point);
 
+    /**
+     * @brief readAllTracks Read the positions of all tracks in one sequential pass (CSR layout)
+     * Scalars and properties are skipped, positions of all tracks are stored contiguously.
+     * @param positions x, y, z of all points of all tracks
+     * @param trackOffsets first point index of each track, with one extra entry holding the total number of points,
+     * i.e. the points of track i are [trackOffsets[i], trackOffsets[i+1])
+     * @return
+     */
+    bool readAllTracks(vector<float>& positions, vector<int64_t>& trackOffsets);
+
+    /**
+     * @brief readTracks Read the positions of a range of tracks in one sequential pass (CSR layout)
+     * Same as readAllTracks() but only for the tracks [iFirstTrkIdx, iFirstTrkIdx+iNumTrks),
+     * trackOffsets are relative to the first track of the range.
+     * @param iFirstTrkIdx first track index (start from 0)
+     * @param iNumTrks number of tracks to read
+     * @param positions
+     * @param trackOffsets
+     * @return false if the range is invalid or reading failed
+     */
+    bool readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float>& positions, vector<int64_t>& trackOffsets);
+
+    /**
+     * @brief readTracks Read positions, scalars and properties of a range of tracks in one sequential pass
+     * Positions and trackOffsets are the same as above. Scalars and properties are stored in columns:
+     * scalar s of point p is (*scalars)[s*numPoints + p], property k of track t is (*properties)[k*iNumTrks + t],
+     * with numPoints = trackOffsets[iNumTrks].
+     * In mapped mode this does not modify the reader and may be called from several threads at once.
+     * @param iFirstTrkIdx first track index (start from 0)
+     * @param iNumTrks number of tracks to read
+     * @param positions
+     * @param trackOffsets
+     * @param scalars n_scalars columns, NULL to skip scalars
+     * @param properties n_properties columns, NULL to skip properties
+     * @return false if the range is invalid or reading failed
+     */
+    bool readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float>& positions, vector<int64_t>& trackOffsets, vector<float>* scalars, vector<float>* properties = NULL);
+
+    /**
+     * @brief getTrackView Get a read-only view of one track without copying, **ONLY IN MAPPED MODE**
+     * The view stays valid until the file is closed. Not available for byte swapped files.
+     * @param iTrkIdx the track index (start from 0)
+     * @param view
+     * @return false if the file is not mapped or the index is invalid
+     */
+    bool getTrackView(size_t iTrkIdx, TrkView& view) const;
+
     /**
      * @brief getTotalTrkNum Get total number of tracks in this file
      * @return total number of tracks in this file
@@ -126,13 +268,24 @@ public:
 protected:
     void xInit();
     void xResetPos();
+    bool xGetFileStat(int64_t& iSize, int64_t& iMtime) const;
+    bool xLoadSidecarIndex();
+    void xSaveSidecarIndex();
+    bool xBuildTrackIndexFromStream();
+    bool xBuildTrackIndexFromMapping();
+    void xUnmap();
+    bool xDetectByteOrder();
     ADD_CLASS_FIELD_PRIVATE(fstream , cFile)                        ///< track file stream
+    ADD_CLASS_FIELD_PRIVATE(const char*, pMappedData)               ///< start of the memory-mapped file, NULL if not mapped
+    ADD_CLASS_FIELD_PRIVATE(size_t, iMappedSize)                    ///< size of the memory mapping in bytes
     ADD_CLASS_FIELD(string, cFilepath, getFilepath, setFilepath)    ///< track file path
     ADD_CLASS_FIELD_NOSETTER(TrkFileHeader, cHeader, getHeader)     ///< track file header
     ADD_CLASS_FIELD(int32_t, iTrkPos, getTrkPos, setTrkPos)         ///< current track index
     ADD_CLASS_FIELD(int32_t, iPntPos, getPntPos, setPntPos)         ///< current point index
     ADD_CLASS_FIELD_NOSETTER(int32_t, iPntPosMax, getPntPosMax)     ///< total point number in current track
-    ADD_CLASS_FIELD_NOSETTER(CONCATE(map<int32_t,TrkInfo>), cRandomAccessMap, getRandomAccessMap)    /// track (index to offset) map for random access support
+    ADD_CLASS_FIELD_NOSETTER(vector<TrkInfo>, cTrackIndex, getTrackIndex)    ///< track offsets and point numbers for random access support
+    ADD_CLASS_FIELD(bool, bUseSidecarIndex, getUseSidecarIndex, setUseSidecarIndex)   ///< load/save the track index from/to a sidecar file on open
+    ADD_CLASS_FIELD_NOSETTER(bool, bByteSwapped, isByteSwapped)     ///< file byte order differs from ours, data is swapped while reading
 };
 
 
@@ -155,32 +308,67 @@ public:
     /**
      * @brief copyHeader Copy a header form the other file
      * @param other
+     * @param bKeepScalarsAndProperties keep n_scalars and n_properties (and their names) of the other file,
+     * else only x, y, z are written
      */
-    void copyHeader(const TrkFileHeader& other);
+    void copyHeader(const TrkFileHeader& other, bool bKeepScalarsAndProperties = false);
 
     /**
-     * @brief appendTrack Append a track to the end of the file
+     * @brief appendTrack Append a track to the end of the file, scalars and properties are filled with 0
      * @param points
      * @return
      */
     bool appendTrack(vector<float>& points);
 
     /**
-     * @brief save Save the file immediately
+     * @brief appendTrack Append a track to the end of the file
+     * @param points x, y, z of all points
+     * @param iNumPnts number of points
+     * @param scalars n_scalars per point, NULL fills them with 0
+     * @param properties n_properties of the track, NULL fills them with 0
+     * @return
+     */
+    bool appendTrack(const float* points, int32_t iNumPnts, const float* scalars = NULL, const float* properties = NULL);
+
+    /**
+     * @brief appendTrack Copy a track of a mapped track file with the same n_scalars and n_properties as is
+     * @param view see TrkFileReader::getTrackView
+     * @return
+     */
+    bool appendTrack(const TrkView& view);
+
+    /**
+     * @brief appendTracks Append a batch of tracks in CSR layout (see TrkFileReader::readTracks)
+     * @param positions x, y, z of all points of all tracks
+     * @param trackOffsets the points of track i are [trackOffsets[i], trackOffsets[i+1])
+     * @param scalars n_scalars per point in the same point order as positions, NULL fills them with 0
+     * @param properties n_properties per track, NULL fills them with 0
+     * @return
+     */
+    bool appendTracks(const vector<float>& positions, const vector<int64_t>& trackOffsets, const float* scalars = NULL, const float* properties = NULL);
+
+    /**
+     * @brief save Write buffered tracks and the header (with the current track number) immediately
      */
     void save();
 
     /**
-     * @brief close Close the file
+     * @brief close Write buffered tracks and the final header, then close the file
      */
     void close();
 
 protected:
     void xWriteHeader();
+    void xAppend(const void* pData, size_t iSize);
+    void xAppendZeros(size_t iSize);
+    void xFlush();
 
     ADD_CLASS_FIELD_PRIVATE(fstream , cFile)    ///< track file stream
     ADD_CLASS_FIELD_NOSETTER(TrkFileHeader, cHeader, getHeader)     ///< track file header
     ADD_CLASS_FIELD(string, cFilepath, getFilepath, setFilepath)    ///< track file path
+    ADD_CLASS_FIELD_NOSETTER(int64_t, iNumTrksWritten, getNumTrksWritten)  ///< tracks appended successfully since create
+    ADD_CLASS_FIELD_PRIVATE(vector<char>, acBuffer)                 ///< tracks not yet written to the file
+    ADD_CLASS_FIELD_PRIVATE(int64_t, iFlushedSize)                  ///< bytes written to the file so far
 };
 
 #endif // TRKFILEIO_H
@@ -0,0 +1,563 @@
+#include "trkzfileio.h"
+#include <math.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TRKZ_USE_SSE2
+#endif
+
+int64_t getTrkzTrackSizeInByte(const TrkzTrackHeader &cTrkHeader, int iNumScalars, int iNumProperties)
+{
+    int64_t iNumPnts = cTrkHeader.getNumPnts();
+    uint8_t iEncoding = cTrkHeader.getEncoding();
+    int64_t iDataSize = 0;
+    if( iEncoding == TRKZ_RAW_FLOAT32 )
+        iDataSize = 3*iNumPnts*sizeof(float);
+    else if( iNumPnts > 0 )
+    {
+        iDataSize = 3*(cTrkHeader.isFirstInt32() ? sizeof(int32_t) : sizeof(int16_t));
+        iDataSize += 3*(iNumPnts-1)*(iEncoding == TRKZ_DELTA_INT8 ? sizeof(int8_t) : sizeof(int16_t));
+    }
+    iDataSize += (iNumScalars*iNumPnts + iNumProperties)*sizeof(float);
+    return sizeof(TrkzTrackHeader) + iDataSize;
+}
+
+
+TrkzFileWriter::TrkzFileWriter()
+{
+    m_fErrorBound = TRKZ_DEFAULT_ERROR_BOUND;
+    m_fMaxError = 0;
+    m_iBytesWritten = 0;
+}
+
+
+TrkzFileWriter::TrkzFileWriter(string &strFilepath)
+{
+    m_cFilepath = strFilepath;
+    m_fErrorBound = TRKZ_DEFAULT_ERROR_BOUND;
+    m_fMaxError = 0;
+    m_iBytesWritten = 0;
+}
+
+
+TrkzFileWriter::~TrkzFileWriter()
+{
+    close();
+}
+
+bool TrkzFileWriter::create()
+{
+    /// open trkz file
+    m_cFile.open(m_cFilepath.c_str(), ios::out|ios::binary|ios::trunc);
+    if( !m_cFile.is_open() )
+    {
+        cerr << "fail to open file" << endl;
+        return false;
+    }
+    m_cHeader.n_count = 0;
+    m_cHeader.n_points = 0;
+    m_cHeader.error_bound = m_fErrorBound;
+    m_cHeader.step = 2*m_fErrorBound;
+    m_fMaxError = 0;
+    xWriteHeader();
+    m_iBytesWritten = sizeof(TrkzFileHeader);
+    return true;
+}
+
+void TrkzFileWriter::copyHeader(const TrkFileHeader &other)
+{
+    memcpy(&m_cHeader.trk_header, &other, TRK_HEADER_SIZE);
+    m_cHeader.trk_header.n_count = 0;
+}
+
+bool TrkzFileWriter::appendTrack(vector<float> &points)
+{
+    /// check if 3d points
+    if(points.size()%3 != 0)
+    {
+        cerr << "point number cannot divided by 3" << endl;
+        return false;
+    }
+    return appendTrack(points.data(), static_cast<int32_t>(points.size()/3));
+}
+
+bool TrkzFileWriter::appendTrack(const float *points, int32_t iNumPnts, const float *scalars, const float *properties)
+{
+    if( !m_cFile.is_open() || iNumPnts < 0 || iNumPnts > TRKZ_MAX_TRACK_POINTS )
+        return false;
+
+    /// quantize on the grid of the file, all tracks share its step
+    vector<int32_t> aiQuantized(3*static_cast<size_t>(iNumPnts));
+    float fStep = m_cHeader.step;
+    bool bQuantize = fStep > 0 && iNumPnts > 0;
+    float fTrackError = 0;
+    int32_t iMaxFirst = 0;
+    int32_t iMaxDelta = 0;
+    for(int32_t i = 0; i < iNumPnts && bQuantize; ++i)
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            float fGrid = points[3*i+c]/fStep;
+            if( !(fabsf(fGrid) <= 1e9f) )
+            {
+                bQuantize = false;
+                break;
+            }
+            int32_t q = static_cast<int32_t>(floorf(fGrid + 0.5f));
+            aiQuantized[3*i+c] = q;
+            /// reconstruct exactly like the decoder does to measure the real error
+            float fDecoded = static_cast<float>(q)*fStep;
+            fTrackError = max(fTrackError, fabsf(fDecoded-points[3*i+c]));
+            if( i == 0 )
+                iMaxFirst = max(iMaxFirst, abs(q));
+            else
+                iMaxDelta = max(iMaxDelta, abs(q-aiQuantized[3*(i-1)+c]));
+        }
+    }
+    uint8_t iEncoding = TRKZ_RAW_FLOAT32;
+    if( bQuantize && fTrackError <= m_fErrorBound && iMaxDelta <= 32767 )
+    {
+        iEncoding = iMaxDelta <= 127 ? TRKZ_DELTA_INT8 : TRKZ_DELTA_INT16;
+        if( iMaxFirst > 32767 )
+            iEncoding |= TRKZ_FIRST_INT32;
+    }
+    else
+        fTrackError = 0;
+    TrkzTrackHeader cTrkHeader;
+    cTrkHeader.numPntsAndEncoding = static_cast<uint32_t>(iNumPnts) | (static_cast<uint32_t>(iEncoding) << 24);
+
+    /// encode
+    const int iNumScalars = m_cHeader.trk_header.n_scalars;
+    const int iNumProperties = m_cHeader.trk_header.n_properties;
+    vector<char> acData(getTrkzTrackSizeInByte(cTrkHeader, iNumScalars, iNumProperties)-sizeof(TrkzTrackHeader), 0);
+    char* pData = acData.data();
+    if( cTrkHeader.getEncoding() == TRKZ_RAW_FLOAT32 )
+    {
+        memcpy(pData, points, 3*static_cast<size_t>(iNumPnts)*sizeof(float));
+        pData += 3*static_cast<size_t>(iNumPnts)*sizeof(float);
+    }
+    else
+    {
+        for(int c = 0; c < 3; ++c)
+        {
+            if( cTrkHeader.isFirstInt32() )
+            {
+                memcpy(pData, &aiQuantized[c], sizeof(int32_t));
+                pData += sizeof(int32_t);
+            }
+            else
+            {
+                int16_t sFirst = static_cast<int16_t>(aiQuantized[c]);
+                memcpy(pData, &sFirst, sizeof(int16_t));
+                pData += sizeof(int16_t);
+            }
+        }
+        /// planar deltas: all x, then all y, then all z
+        size_t iNumDeltas = static_cast<size_t>(iNumPnts-1);
+        for(int c = 0; c < 3; ++c)
+        {
+            for(size_t i = 0; i < iNumDeltas; ++i)
+            {
+                int32_t iDelta = aiQuantized[3*(i+1)+c]-aiQuantized[3*i+c];
+                if( cTrkHeader.getEncoding() == TRKZ_DELTA_INT8 )
+                    *pData++ = static_cast<char>(static_cast<int8_t>(iDelta));
+                else
+                {
+                    int16_t sDelta = static_cast<int16_t>(iDelta);
+                    memcpy(pData, &sDelta, sizeof(int16_t));
+                    pData += sizeof(int16_t);
+                }
+            }
+        }
+    }
+    /// scalars and properties are stored as they are, the buffer is already zero if they are not given
+    if( scalars != NULL && iNumScalars > 0 )
+        memcpy(pData, scalars, static_cast<size_t>(iNumScalars)*iNumPnts*sizeof(float));
+    pData += static_cast<size_t>(iNumScalars)*iNumPnts*sizeof(float);
+    if( properties != NULL && iNumProperties > 0 )
+        memcpy(pData, properties, iNumProperties*sizeof(float));
+    m_fMaxError = max(m_fMaxError, fTrackError);
+
+    m_cFile.write((char*)&cTrkHeader, sizeof(cTrkHeader));
+    m_cFile.write(acData.data(), acData.size());
+    if( !m_cFile.good() )
+        return false;
+    m_iBytesWritten += sizeof(cTrkHeader) + acData.size();
+    m_cHeader.n_count++;
+    m_cHeader.n_points += iNumPnts;
+    return true;
+}
+
+void TrkzFileWriter::close()
+{
+    if( !m_cFile.is_open() )
+        return;
+    xWriteHeader();
+    m_cFile.close();
+}
+
+void TrkzFileWriter::xWriteHeader()
+{
+    m_cFile.seekp(0);
+    m_cFile.write((char*)(&m_cHeader), sizeof(m_cHeader));
+    m_cFile.seekp(0, ios::end);
+}
+
+
+TrkzFileReader::TrkzFileReader()
+{
+    xInit();
+}
+
+
+TrkzFileReader::TrkzFileReader(string &strFilepath)
+{
+    m_cFilepath = strFilepath;
+    xInit();
+}
+
+
+TrkzFileReader::~TrkzFileReader()
+{
+    close();
+}
+
+void TrkzFileReader::xInit()
+{
+    m_pData = NULL;
+    m_iDataSize = 0;
+    m_bMapped = false;
+}
+
+bool TrkzFileReader::xMapFile()
+{
+#ifdef _WIN32
+    return false;
+#else
+    /// map the whole trkz file read-only like TrkFileReader::openMapped(), tracks are decoded straight from the page cache
+    int iFd = ::open(m_cFilepath.c_str(), O_RDONLY);
+    if( iFd < 0 )
+        return false;
+    struct stat cStat;
+    if( fstat(iFd, &cStat) != 0 || cStat.st_size < static_cast<off_t>(sizeof(TrkzFileHeader)) )
+    {
+        ::close(iFd);
+        return false;
+    }
+    void* pMapping = mmap(NULL, static_cast<size_t>(cStat.st_size), PROT_READ, MAP_PRIVATE, iFd, 0);
+    ::close(iFd);   ///< the mapping keeps its own reference to the file
+    if( pMapping == MAP_FAILED )
+        return false;
+    madvise(pMapping, static_cast<size_t>(cStat.st_size), MADV_SEQUENTIAL);
+    m_pData = static_cast<const char*>(pMapping);
+    m_iDataSize = static_cast<size_t>(cStat.st_size);
+    m_bMapped = true;
+    return true;
+#endif
+}
+
+bool TrkzFileReader::xReadFile()
+{
+    /// read the whole compressed file
+    fstream cFile(m_cFilepath.c_str(), ios::in|ios::binary);
+    if( !cFile.is_open() )
+    {
+        cerr << "fail to open file" << endl;
+        return false;
+    }
+    cFile.seekg(0, ios::end);
+    int64_t iFileSize = cFile.tellg();
+    cFile.seekg(0);
+    if( iFileSize < static_cast<int64_t>(sizeof(TrkzFileHeader)) )
+    {
+        cerr << "file is too small to be a trkz file" << endl;
+        return false;
+    }
+    m_acData.resize(iFileSize);
+    cFile.read(m_acData.data(), iFileSize);
+    if( cFile.gcount() != iFileSize )
+    {
+        cerr << "fail to read file" << endl;
+        m_acData.clear();
+        return false;
+    }
+    m_pData = m_acData.data();
+    m_iDataSize = static_cast<size_t>(iFileSize);
+    return true;
+}
+
+bool TrkzFileReader::open()
+{
+    close();
+    if( !xMapFile() && !xReadFile() )
+        return false;
+    const int64_t iFileSize = static_cast<int64_t>(m_iDataSize);
+    memcpy(&m_cHeader, m_pData, sizeof(m_cHeader));
+    if( memcmp(m_cHeader.magic, TRKZ_MAGIC, sizeof(TRKZ_MAGIC)) != 0 || m_cHeader.version != TRKZ_VERSION || m_cHeader.n_count < 0
+        || m_cHeader.trk_header.n_scalars < 0 || m_cHeader.trk_header.n_properties < 0 )
+    {
+        cerr << "not a supported trkz file" << endl;
+        close();
+        return false;
+    }
+
+    /// build the random access table from the track headers
+    m_aiTrackOffsets.reserve(m_cHeader.n_count);
+    int64_t iOffset = sizeof(TrkzFileHeader);
+    for(int64_t i = 0; i < m_cHeader.n_count; ++i)
+    {
+        if( iOffset + static_cast<int64_t>(sizeof(TrkzTrackHeader)) > iFileSize )
+            break;
+        TrkzTrackHeader cTrkHeader;
+        memcpy(&cTrkHeader, m_pData + iOffset, sizeof(cTrkHeader));
+        int64_t iTrkSize = getTrkzTrackSizeInByte(cTrkHeader, m_cHeader.trk_header.n_scalars, m_cHeader.trk_header.n_properties);
+        if( cTrkHeader.getEncoding() > TRKZ_DELTA_INT16 || iOffset + iTrkSize > iFileSize )
+            break;
+        m_aiTrackOffsets.push_back(iOffset);
+        iOffset += iTrkSize;
+    }
+    if( static_cast<int64_t>(m_aiTrackOffsets.size()) != m_cHeader.n_count )
+        cerr << "Track" << m_aiTrackOffsets.size() << "is truncated, ignoring the rest of the file" << endl;
+    return true;
+}
+
+void TrkzFileReader::close()
+{
+#ifndef _WIN32
+    if( m_bMapped )
+        munmap(const_cast<char*>(m_pData), m_iDataSize);
+#endif
+    m_acData.clear();
+    m_aiTrackOffsets.clear();
+    xInit();
+}
+
+size_t TrkzFileReader::getPointNumInTrk(int iIdx) const
+{
+    if( iIdx < 0 || static_cast<size_t>(iIdx) >= m_aiTrackOffsets.size() )
+        return -1;
+    TrkzTrackHeader cTrkHeader;
+    memcpy(&cTrkHeader, m_pData + m_aiTrackOffsets[iIdx], sizeof(cTrkHeader));
+    return cTrkHeader.getNumPnts();
+}
+
+bool TrkzFileReader::readTrack(size_t iTrkIdx, vector<float> &points)
+{
+    if( iTrkIdx >= m_aiTrackOffsets.size() )
+        return false;
+    points.resize(3*getPointNumInTrk(static_cast<int>(iTrkIdx)));
+    decodeTrack(m_pData + m_aiTrackOffsets[iTrkIdx], m_cHeader.step, points.data());
+    return true;
+}
+
+bool TrkzFileReader::readAllTracks(vector<float> &positions, vector<int64_t> &trackOffsets)
+{
+    return readTracks(0, m_aiTrackOffsets.size(), positions, trackOffsets);
+}
+
+bool TrkzFileReader::readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float> &positions, vector<int64_t> &trackOffsets)
+{
+    return readTracks(iFirstTrkIdx, iNumTrks, positions, trackOffsets, NULL, NULL);
+}
+
+bool TrkzFileReader::readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float> &positions, vector<int64_t> &trackOffsets, vector<float> *scalars, vector<float> *properties)
+{
+    if( iFirstTrkIdx + iNumTrks > m_aiTrackOffsets.size() )
+        return false;
+
+    /// allocate once, then decode straight into the position buffer
+    trackOffsets.resize(iNumTrks+1);
+    trackOffsets[0] = 0;
+    for(size_t i = 0; i < iNumTrks; ++i)
+        trackOffsets[i+1] = trackOffsets[i] + getPointNumInTrk(static_cast<int>(iFirstTrkIdx+i));
+    const size_t iTotalPoints = static_cast<size_t>(trackOffsets[iNumTrks]);
+    const int iNumScalars = m_cHeader.trk_header.n_scalars;
+    const int iNumProperties = m_cHeader.trk_header.n_properties;
+    positions.resize(3*iTotalPoints);
+    if( scalars != NULL )
+        scalars->resize(static_cast<size_t>(iNumScalars)*iTotalPoints);
+    if( properties != NULL )
+        properties->resize(static_cast<size_t>(iNumProperties)*iNumTrks);
+
+    for(size_t i = 0; i < iNumTrks; ++i)
+    {
+        const char* pTrack = m_pData + m_aiTrackOffsets[iFirstTrkIdx+i];
+        decodeTrack(pTrack, m_cHeader.step, positions.data() + 3*trackOffsets[i]);
+        if( (scalars == NULL || iNumScalars == 0) && (properties == NULL || iNumProperties == 0) )
+            continue;
+
+        /// scalars and properties are at the end of the track, stored into one column each
+        TrkzTrackHeader cTrkHeader;
+        memcpy(&cTrkHeader, pTrack, sizeof(cTrkHeader));
+        const size_t iNumPnts = static_cast<size_t>(cTrkHeader.getNumPnts());
+        const size_t iExtraSize = (iNumScalars*iNumPnts + iNumProperties)*sizeof(float);
+        const char* pExtra = pTrack + getTrkzTrackSizeInByte(cTrkHeader, iNumScalars, iNumProperties) - iExtraSize;
+        if( scalars != NULL && iNumScalars > 0 )
+            deinterleaveColumns(pExtra, iNumPnts, iNumScalars, scalars->data() + trackOffsets[i], iTotalPoints);
+        if( properties != NULL )
+            for(int k = 0; k < iNumProperties; ++k)
+                memcpy(&(*properties)[k*iNumTrks + i], pExtra + (iNumScalars*iNumPnts + k)*sizeof(float), sizeof(float));
+    }
+    return true;
+}
+
+/**
+ * @brief xDecodeComponent Expand the deltas of one component into every third float of pDst
+ * @param pDeltas planar deltas of this component (int8_t or int16_t)
+ * @param iNumDeltas number of deltas
+ * @param iFirst first point of the track in grid units
+ * @param fStep quantization step
+ * @param pDst first point of the component in the x, y, z output
+ */
+template<typename DeltaType>
+static void xDecodeComponent(const char* pDeltas, int32_t iNumDeltas, int32_t iFirst, float fStep, float* pDst)
+{
+    pDst[0] = static_cast<float>(iFirst)*fStep;
+    int32_t iValue = iFirst;
+    int32_t i = 0;
+#ifdef TRKZ_USE_SSE2
+    /// 4 deltas at once: sign extend to int32, in-register prefix sum, add running value, convert and scale
+    __m128i vCarry = _mm_set1_epi32(iFirst);
+    const __m128 vStep = _mm_set1_ps(fStep);
+    float afOut[4];
+    for(; i + 4 <= iNumDeltas; i += 4)
+    {
+        __m128i vDelta;
+        if( sizeof(DeltaType) == 1 )
+        {
+            int32_t iPacked;
+            memcpy(&iPacked, pDeltas + i, 4);
+            vDelta = _mm_cvtsi32_si128(iPacked);
+            vDelta = _mm_unpacklo_epi8(vDelta, vDelta);
+            vDelta = _mm_srai_epi32(_mm_unpacklo_epi16(vDelta, vDelta), 24);
+        }
+        else
+        {
+            vDelta = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(pDeltas + i*sizeof(int16_t)));
+            vDelta = _mm_srai_epi32(_mm_unpacklo_epi16(vDelta, vDelta), 16);
+        }
+        vDelta = _mm_add_epi32(vDelta, _mm_slli_si128(vDelta, 4));
+        vDelta = _mm_add_epi32(vDelta, _mm_slli_si128(vDelta, 8));
+        __m128i vValue = _mm_add_epi32(vDelta, vCarry);
+        vCarry = _mm_shuffle_epi32(vValue, _MM_SHUFFLE(3,3,3,3));
+        _mm_storeu_ps(afOut, _mm_mul_ps(_mm_cvtepi32_ps(vValue), vStep));
+        pDst[3*(i+1)] = afOut[0];
+        pDst[3*(i+2)] = afOut[1];
+        pDst[3*(i+3)] = afOut[2];
+        pDst[3*(i+4)] = afOut[3];
+    }
+    iValue = _mm_cvtsi128_si32(vCarry);
+#endif
+    for(; i < iNumDeltas; ++i)
+    {
+        DeltaType delta;
+        memcpy(&delta, pDeltas + i*sizeof(DeltaType), sizeof(DeltaType));
+        iValue += delta;
+        pDst[3*(i+1)] = static_cast<float>(iValue)*fStep;
+    }
+}
+
+void TrkzFileReader::decodeTrack(const char *pTrack, float fStep, float *pDst)
+{
+    TrkzTrackHeader cTrkHeader;
+    memcpy(&cTrkHeader, pTrack, sizeof(cTrkHeader));
+    const char* pData = pTrack + sizeof(TrkzTrackHeader);
+    int32_t iNumPnts = cTrkHeader.getNumPnts();
+    uint8_t iEncoding = cTrkHeader.getEncoding();
+    if( iNumPnts <= 0 )
+        return;
+
+    if( iEncoding == TRKZ_RAW_FLOAT32 )
+    {
+        memcpy(pDst, pData, 3*static_cast<size_t>(iNumPnts)*sizeof(float));
+        return;
+    }
+
+    int32_t aiFirst[3];
+    for(int c = 0; c < 3; ++c)
+    {
+        if( cTrkHeader.isFirstInt32() )
+        {
+            memcpy(&aiFirst[c], pData, sizeof(int32_t));
+            pData += sizeof(int32_t);
+        }
+        else
+        {
+            int16_t sFirst;
+            memcpy(&sFirst, pData, sizeof(int16_t));
+            aiFirst[c] = sFirst;
+            pData += sizeof(int16_t);
+        }
+    }
+    int32_t iNumDeltas = iNumPnts-1;
+    size_t iDeltaSize = iEncoding == TRKZ_DELTA_INT8 ? sizeof(int8_t) : sizeof(int16_t);
+    for(int c = 0; c < 3; ++c)
+    {
+        const char* pDeltas = pData + c*iNumDeltas*iDeltaSize;
+        if( iEncoding == TRKZ_DELTA_INT8 )
+            xDecodeComponent<int8_t>(pDeltas, iNumDeltas, aiFirst[c], fStep, pDst+c);
+        else
+            xDecodeComponent<int16_t>(pDeltas, iNumDeltas, aiFirst[c], fStep, pDst+c);
+    }
+}
+
+bool compressTrkFile(const string &strTrkFilepath, const string &strTrkzFilepath, float fErrorBound, float *pfMaxError,
+                     TrkzProgressCallback pfnProgress, void *pUserData)
+{
+    string strInput = strTrkFilepath;
+    string strOutput = strTrkzFilepath;
+    TrkFileReader cReader(strInput);
+    if( !cReader.openMapped() && !cReader.open() )
+        return false;
+
+    TrkzFileWriter cWriter(strOutput);
+    cWriter.copyHeader(cReader.getHeader());
+    cWriter.setErrorBound(fErrorBound);
+    if( !cWriter.create() )
+        return false;
+
+    /// convert in batches of whole tracks to bound memory use
+    const size_t iTrksPerBatch = 4096;
+    const int iNumScalars = cReader.getHeader().n_scalars;
+    const int iNumProperties = cReader.getHeader().n_properties;
+    vector<float> afPositions, afScalars, afProperties;
+    vector<int64_t> aiTrackOffsets;
+    vector<float> afTrackScalars, afTrackProperties(iNumProperties);
+    size_t iNumTrks = cReader.getTotalTrkNum();
+    for(size_t iFirst = 0; iFirst < iNumTrks; iFirst += iTrksPerBatch)
+    {
+        size_t iNum = min(iTrksPerBatch, iNumTrks-iFirst);
+        if( !cReader.readTracks(iFirst, iNum, afPositions, aiTrackOffsets, &afScalars, &afProperties) )
+            return false;
+        const size_t iNumBatchPnts = static_cast<size_t>(aiTrackOffsets[iNum]);
+        for(size_t i = 0; i < iNum; ++i)
+        {
+            /// the reader returns columns, the writer takes the scalars of each point and the properties of the track together
+            const int32_t iNumPnts = static_cast<int32_t>(aiTrackOffsets[i+1]-aiTrackOffsets[i]);
+            afTrackScalars.resize(static_cast<size_t>(iNumScalars)*iNumPnts);
+            for(int32_t p = 0; p < iNumPnts; ++p)
+                for(int k = 0; k < iNumScalars; ++k)
+                    afTrackScalars[p*iNumScalars + k] = afScalars[k*iNumBatchPnts + aiTrackOffsets[i] + p];
+            for(int k = 0; k < iNumProperties; ++k)
+                afTrackProperties[k] = afProperties[k*iNum + i];
+            if( !cWriter.appendTrack(afPositions.data() + 3*aiTrackOffsets[i], iNumPnts, afTrackScalars.data(), afTrackProperties.data()) )
+                return false;
+        }
+        if( pfnProgress != NULL && !pfnProgress(iFirst+iNum, iNumTrks, pUserData) )
+        {
+            cWriter.close();
+            remove(strTrkzFilepath.c_str());
+            return false;
+        }
+    }
+    cWriter.close();
+    if( pfMaxError != NULL )
+        *pfMaxError = cWriter.getMaxError();
+    return true;
+}
@@ -0,0 +1,260 @@
+//! compressed track (*.trkz) file format for TrackVis .trk tractography data
+//! points of all tracks are quantized on one grid (step 2*error bound) and each track is delta coded,
+//! scalars and properties are kept as float32, decoding expands the tracks into plain x, y, z float positions
+
+#ifndef TRKZFILEIO_H
+#define TRKZFILEIO_H
+#include "trkfileio.h"
+
+static const char TRKZ_MAGIC[4] = {'T','R','K','Z'};  ///< first bytes of a compressed track file
+static const int32_t TRKZ_VERSION = 2;                  ///< increase when the file layout changes
+static const int32_t TRKZ_MAX_TRACK_POINTS = 0xFFFFFF;  ///< max points in one track
+static const float TRKZ_DEFAULT_ERROR_BOUND = 0.02f;    ///< default max coordinate error (in track file units, usually mm), deltas of 2-4 mm steps fit int8
+
+/**
+ * @brief The TrkzTrackEncoding enum how the points of a track are stored
+ */
+enum TrkzTrackEncoding
+{
+    TRKZ_RAW_FLOAT32 = 0,   ///< x, y, z float32 per point (lossless, used if quantization would exceed the error bound)
+    TRKZ_DELTA_INT8  = 1,   ///< first grid point, then int8 deltas per component
+    TRKZ_DELTA_INT16 = 2,   ///< first grid point, then int16 deltas per component
+    TRKZ_FIRST_INT32 = 0x80 ///< flag of the delta encodings: the first grid point is stored as int32 instead of int16
+};
+
+#pragma pack(push)
+#pragma pack(1)
+/**
+ * @brief The TrkzFileHeader class file header of a compressed track file
+ * The original track file header is kept so coordinate system information is not lost.
+ */
+class TrkzFileHeader
+{
+public:
+    TrkzFileHeader()
+    {
+        memcpy(magic, TRKZ_MAGIC, sizeof(TRKZ_MAGIC));
+        version = TRKZ_VERSION;
+        n_count = 0;
+        n_points = 0;
+        error_bound = TRKZ_DEFAULT_ERROR_BOUND;
+        step = 2*TRKZ_DEFAULT_ERROR_BOUND;
+        memset(reserved, 0, sizeof(reserved));
+    }
+    char magic[4];              /// TRKZ_MAGIC
+    int32_t version;            /// TRKZ_VERSION
+    int64_t n_count;            /// number of tracks stored in this file
+    int64_t n_points;           /// number of points of all tracks
+    float error_bound;          /// max coordinate error of quantized tracks
+    float step;                 /// quantization step of all tracks (2*error_bound)
+    char reserved[32];          /// reserved for future versions, zero
+    TrkFileHeader trk_header;   /// header of the original track file, its n_scalars and n_properties are stored per track
+};
+
+/**
+ * @brief The TrkzTrackHeader class header in front of each compressed track
+ * For the raw encoding the header is followed by x, y, z of all points.
+ * For delta encodings it is followed by the first point in grid units (x, y, z as int16, or int32 with TRKZ_FIRST_INT32)
+ * and (numPnts-1) deltas of x, then of y, then of z (planar). Point i of a component is step * (first + sum of the first i deltas).
+ * The positions are followed by n_scalars float32 per point (interleaved like in .trk files) and n_properties float32.
+ * Tracks are not padded.
+ */
+class TrkzTrackHeader
+{
+public:
+    uint32_t numPntsAndEncoding;    /// lower 24 bits: points in this track, upper 8 bits: TrkzTrackEncoding and flags
+
+    int32_t getNumPnts() const { return static_cast<int32_t>(numPntsAndEncoding & 0xFFFFFF); }
+    uint8_t getEncoding() const { return static_cast<uint8_t>((numPntsAndEncoding >> 24) & ~TRKZ_FIRST_INT32); }
+    bool isFirstInt32() const { return ((numPntsAndEncoding >> 24) & TRKZ_FIRST_INT32) != 0; }
+};
+#pragma pack(pop)
+
+
+/**
+ * @brief The TrkzFileWriter class compressed track (*.trkz) file writer
+ */
+class TrkzFileWriter
+{
+public:
+    TrkzFileWriter();
+    TrkzFileWriter(string &strFilepath);
+    ~TrkzFileWriter();
+
+    /**
+     * @brief create Create a new empty trkz file for write
+     * @return
+     */
+    bool create();
+
+    /**
+     * @brief copyHeader Copy a header from a track file, it is stored in the trkz file
+     * @param other
+     */
+    void copyHeader(const TrkFileHeader& other);
+
+    /**
+     * @brief appendTrack Compress a track and append it to the end of the file
+     * @param points x, y, z of all points
+     * @param iNumPnts number of points
+     * @param scalars n_scalars per point, NULL fills them with 0
+     * @param properties n_properties of the track, NULL fills them with 0
+     * @return
+     */
+    bool appendTrack(const float* points, int32_t iNumPnts, const float* scalars = NULL, const float* properties = NULL);
+
+    /**
+     * @brief appendTrack Compress a track and append it to the end of the file
+     * @param points x, y, z of all points
+     * @return
+     */
+    bool appendTrack(vector<float>& points);
+
+    /**
+     * @brief close Write the final header and close the file
+     */
+    void close();
+
+protected:
+    void xWriteHeader();
+    ADD_CLASS_FIELD_PRIVATE(fstream, cFile)                         ///< trkz file stream
+    ADD_CLASS_FIELD(string, cFilepath, getFilepath, setFilepath)    ///< trkz file path
+    ADD_CLASS_FIELD_NOSETTER(TrkzFileHeader, cHeader, getHeader)    ///< trkz file header
+    ADD_CLASS_FIELD(float, fErrorBound, getErrorBound, setErrorBound)   ///< max coordinate error allowed for quantization, 0 stores all tracks uncompressed (TRKZ_RAW_FLOAT32)
+    ADD_CLASS_FIELD_NOSETTER(float, fMaxError, getMaxError)        ///< max coordinate error of all tracks written so far
+    ADD_CLASS_FIELD_NOSETTER(int64_t, iBytesWritten, getBytesWritten)   ///< size of the file written so far
+};
+
+
+/**
+ * @brief The TrkzFileReader class compressed track (*.trkz) file reader
+ * The whole (compressed) file is memory-mapped on open (read into memory where mapping is not supported),
+ * tracks are decoded on demand.
+ */
+class TrkzFileReader
+{
+public:
+    TrkzFileReader();
+    TrkzFileReader(string &strFilepath);
+    ~TrkzFileReader();
+
+    /**
+     * @brief open Open the trkz file
+     * @return
+     */
+    bool open();
+
+    /**
+     * @brief isMapped Check if the file content is read from a memory mapping
+     * @return false if it was read into memory because mapping is not supported
+     */
+    bool isMapped() const { return m_bMapped; }
+
+    /**
+     * @brief close Close the trkz file
+     */
+    void close();
+
+    /**
+     * @brief readTrack Decode one track
+     * @param iTrkIdx the track index (start from 0)
+     * @param points x, y, z of all points
+     * @return
+     */
+    bool readTrack(size_t iTrkIdx, vector<float>& points);
+
+    /**
+     * @brief readAllTracks Decode all tracks in CSR layout, see TrkFileReader::readAllTracks
+     * @param positions
+     * @param trackOffsets
+     * @return
+     */
+    bool readAllTracks(vector<float>& positions, vector<int64_t>& trackOffsets);
+
+    /**
+     * @brief readTracks Decode a range of tracks in CSR layout, see TrkFileReader::readTracks
+     * @param iFirstTrkIdx
+     * @param iNumTrks
+     * @param positions
+     * @param trackOffsets
+     * @return
+     */
+    bool readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float>& positions, vector<int64_t>& trackOffsets);
+
+    /**
+     * @brief readTracks Decode a range of tracks with scalars and properties in columns, see TrkFileReader::readTracks
+     */
+    bool readTracks(size_t iFirstTrkIdx, size_t iNumTrks, vector<float>& positions, vector<int64_t>& trackOffsets, vector<float>* scalars, vector<float>* properties = NULL);
+
+    /**
+     * @brief getTotalTrkNum Get total number of tracks in this file
+     * @return
+     */
+    size_t getTotalTrkNum() const { return m_aiTrackOffsets.size(); }
+
+    /**
+     * @brief getPointNumInTrk Get total number of the points in the track
+     * @param iIdx track index (start from 0)
+     * @return
+     */
+    size_t getPointNumInTrk(int iIdx) const;
+
+    /**
+     * @brief getHeader Get the header of the original track file
+     * @return
+     */
+    const TrkFileHeader& getHeader() const { return m_cHeader.trk_header; }
+
+    /**
+     * @brief decodeTrack Decode one compressed track into x, y, z float positions
+     * @param pTrack start of the track header
+     * @param fStep quantization step of the file
+     * @param pDst output, 3*numPnts floats
+     */
+    static void decodeTrack(const char* pTrack, float fStep, float* pDst);
+
+protected:
+    void xInit();
+    bool xMapFile();
+    bool xReadFile();
+    ADD_CLASS_FIELD(string, cFilepath, getFilepath, setFilepath)            ///< trkz file path
+    ADD_CLASS_FIELD_NOSETTER(TrkzFileHeader, cHeader, getTrkzHeader)        ///< trkz file header
+    ADD_CLASS_FIELD_PRIVATE(const char*, pData)                             ///< whole file content, the memory mapping or acData, NULL if not open
+    ADD_CLASS_FIELD_PRIVATE(size_t, iDataSize)                              ///< size of the file content in bytes
+    ADD_CLASS_FIELD_PRIVATE(bool, bMapped)                                  ///< pData is a memory mapping
+    ADD_CLASS_FIELD_PRIVATE(vector<char>, acData)                           ///< file content if it could not be mapped
+    ADD_CLASS_FIELD_PRIVATE(vector<int64_t>, aiTrackOffsets)                ///< offset of each track header in pData
+};
+
+/**
+ * @brief getTrkzTrackSizeInByte Get the size of a compressed track including its header, scalars and properties
+ * @param cTrkHeader
+ * @param iNumScalars n_scalars of the file
+ * @param iNumProperties n_properties of the file
+ * @return
+ */
+int64_t getTrkzTrackSizeInByte(const TrkzTrackHeader& cTrkHeader, int iNumScalars, int iNumProperties);
+
+/**
+ * @brief TrkzProgressCallback Called by compressTrkFile after each batch of tracks
+ * @param iTrksDone tracks compressed so far
+ * @param iNumTrks tracks in the file
+ * @param pUserData passed through from compressTrkFile
+ * @return false to cancel the compression
+ */
+typedef bool (*TrkzProgressCallback)(size_t iTrksDone, size_t iNumTrks, void* pUserData);
+
+/**
+ * @brief compressTrkFile Convert a track file into a compressed track file, scalars and properties are kept exactly
+ * @param strTrkFilepath input track file
+ * @param strTrkzFilepath output trkz file
+ * @param fErrorBound max coordinate error allowed for quantization, 0 keeps the positions exactly but uncompressed (raw float32, no size reduction)
+ * @param pfMaxError if not NULL, receives the max coordinate error of all tracks
+ * @param pfnProgress if not NULL, reports the progress and may cancel, the unfinished output file is removed then
+ * @param pUserData passed to pfnProgress
+ * @return false if reading or writing failed or the compression was cancelled
+ */
+bool compressTrkFile(const string& strTrkFilepath, const string& strTrkzFilepath, float fErrorBound, float* pfMaxError = NULL,
+                     TrkzProgressCallback pfnProgress = NULL, void* pUserData = NULL);
+
+#endif // TRKZFILEIO_H
@@ -0,0 +1,170 @@
+#include "linecache.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <string.h>
+
+LineCacheReader::LineCacheReader()
+{
+	positions = nullptr;
+	trackOffsets = nullptr;
+}
+
+bool LineCacheReader::open(const QString &cacheFilename, const QString &sourceFilename, quint64 settingsKey)
+{
+	close();
+
+	QFileInfo sourceInfo(sourceFilename);
+	file.setFileName(cacheFilename);
+	if (!sourceInfo.exists() || !file.open(QIODevice::ReadOnly))
+		return false;
+
+	// validate header against source file and settings
+	if (file.read((char*)&header, sizeof(header)) != sizeof(header)
+		|| memcmp(header.magic, LINE_CACHE_MAGIC, sizeof(LINE_CACHE_MAGIC)) != 0
+		|| header.version != LINE_CACHE_VERSION
+		|| header.pointSize != sizeof(glm::vec3)
+		|| header.sourceFileSize != sourceInfo.size()
+		|| header.sourceFileModified != sourceInfo.lastModified().toMSecsSinceEpoch()
+		|| header.settingsKey != settingsKey
+		|| header.numTracks < 0 || header.numPoints < 0) {
+		close();
+		return false;
+	}
+
+	// counts larger than the file would overflow the expected size
+	if (header.numPoints > file.size() / qint64(sizeof(glm::vec3)) || header.numTracks >= file.size() / qint64(sizeof(qint64))) {
+		close();
+		return false;
+	}
+	qint64 expectedSize = sizeof(LineCacheHeader) + header.numPoints * sizeof(glm::vec3) + (header.numTracks + 1) * sizeof(qint64);
+	if (file.size() != expectedSize) {
+		close();
+		return false;
+	}
+
+	// map the whole file, the loader copies the positions of whole tracks from the mapping into chunks
+	uchar *mapping = file.map(0, file.size());
+	if (!mapping) {
+		close();
+		return false;
+	}
+	positions = reinterpret_cast<const glm::vec3*>(mapping + sizeof(LineCacheHeader));
+	trackOffsets = reinterpret_cast<const qint64*>(mapping + sizeof(LineCacheHeader) + header.numPoints * sizeof(glm::vec3));
+
+	// the track offsets index into the mapped positions, a damaged cache must not make them point outside of it
+	bool validOffsets = trackOffsets[0] == 0 && trackOffsets[header.numTracks] == header.numPoints;
+	for (qint64 i = 0; validOffsets && i < header.numTracks; ++i)
+		validOffsets = trackOffsets[i] <= trackOffsets[i + 1];
+	if (!validOffsets) {
+		qDebug() << "invalid track offsets in line cache" << cacheFilename;
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+void LineCacheReader::close()
+{
+	positions = nullptr;
+	trackOffsets = nullptr;
+	file.close(); // also unmaps
+}
+
+LineCacheWriter::LineCacheWriter()
+{
+	failed = true;
+}
+
+LineCacheWriter::~LineCacheWriter()
+{
+	abort();
+}
+
+bool LineCacheWriter::begin(const QString &cacheFilename, const QString &sourceFilename, quint64 settingsKey)
+{
+	abort();
+
+	QFileInfo sourceInfo(sourceFilename);
+	QDir().mkpath(QFileInfo(cacheFilename).absolutePath());
+
+	this->cacheFilename = cacheFilename;
+	file.setFileName(cacheFilename + ".tmp");
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug() << "could not create line cache file" << file.fileName();
+		return false;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, LINE_CACHE_MAGIC, sizeof(LINE_CACHE_MAGIC));
+	header.version = LINE_CACHE_VERSION;
+	header.pointSize = sizeof(glm::vec3);
+	header.sourceFileSize = sourceInfo.size();
+	header.sourceFileModified = sourceInfo.lastModified().toMSecsSinceEpoch();
+	header.settingsKey = settingsKey;
+
+	// header is rewritten with the final counts in finish()
+	failed = file.write((const char*)&header, sizeof(header)) != sizeof(header);
+	return !failed;
+}
+
+bool LineCacheWriter::appendPositions(const std::vector<glm::vec3> &positions)
+{
+	if (failed)
+		return false;
+
+	qint64 size = positions.size() * sizeof(glm::vec3);
+	failed = file.write((const char*)positions.data(), size) != size;
+	header.numPoints += positions.size();
+	return !failed;
+}
+
+bool LineCacheWriter::finish(const std::vector<qint64> &trackOffsets, glm::vec3 boundingBoxMin, glm::vec3 boundingBoxMax)
+{
+	if (failed || trackOffsets.empty() || trackOffsets.back() != header.numPoints) {
+		abort();
+		return false;
+	}
+
+	header.numTracks = trackOffsets.size() - 1;
+	for (int i = 0; i < 3; ++i) {
+		header.boundingBoxMin[i] = boundingBoxMin[i];
+		header.boundingBoxMax[i] = boundingBoxMax[i];
+	}
+
+	qint64 size = trackOffsets.size() * sizeof(qint64);
+	failed = file.write((const char*)trackOffsets.data(), size) != size
+		|| !file.seek(0)
+		|| file.write((const char*)&header, sizeof(header)) != sizeof(header);
+	file.close();
+
+	// replace an outdated cache file
+	QFile::remove(cacheFilename);
+	if (failed || !QFile::rename(file.fileName(), cacheFilename)) {
+		abort();
+		return false;
+	}
+	return true;
+}
+
+void LineCacheWriter::abort()
+{
+	if (file.isOpen())
+		file.close();
+	if (!cacheFilename.isEmpty())
+		QFile::remove(cacheFilename + ".tmp");
+	failed = true;
+}
+
+QString lineCacheFilename(const QString &sourceFilename)
+{
+	// one cache file per source file path
+	QString absolutePath = QFileInfo(sourceFilename).absoluteFilePath();
+	QString hash = QString(QCryptographicHash::hash(absolutePath.toUtf8(), QCryptographicHash::Md5).toHex());
+	return QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + "/" + hash + ".linecache";
+}
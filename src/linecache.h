@@ -0,0 +1,103 @@
+#ifndef LINECACHE_H
+#define LINECACHE_H
+
+#include <QFile>
+#include <QString>
+
+#include <vector>
+#include <glm/glm.hpp>
+
+
+//! first bytes of a line cache file
+static const char LINE_CACHE_MAGIC[8] = {'V','I','S','2','L','I','N','E'};
+//! increase whenever the file layout or the preprocessing producing the line positions changes
+static const qint32 LINE_CACHE_VERSION = 3;
+
+//! \brief The LineCacheHeader struct.
+//!
+//! Header of a render-ready line cache file. The header is followed by
+//! numPoints normalized line positions (x,y,z floats, see LineData)
+//! and numTracks+1 qint64 track offsets (first point of each track, last entry is numPoints).
+struct LineCacheHeader
+{
+	char magic[8]; //!< LINE_CACHE_MAGIC
+	qint32 version; //!< LINE_CACHE_VERSION
+	qint32 pointSize; //!< sizeof(glm::vec3)
+	qint64 sourceFileSize; //!< size of the source file the cache was built from
+	qint64 sourceFileModified; //!< last modification of the source file in ms since epoch
+	quint64 settingsKey; //!< identifies the loader settings used to build the cache
+	qint64 numTracks; //!< number of tracks
+	qint64 numPoints; //!< number of line points
+	float boundingBoxMin[3]; //!< bounds of the normalized line positions
+	float boundingBoxMax[3];
+};
+
+//! \brief The LineCacheReader class.
+//!
+//! Memory-maps a line cache file. The cache is only accepted if it was built
+//! from the given source file in its current state and with the given settings.
+class LineCacheReader
+{
+public:
+	LineCacheReader();
+
+	//! \brief map the cache file and validate it
+	//! \param cacheFilename path to the cache file
+	//! \param sourceFilename path to the file the cache was built from
+	//! \param settingsKey loader settings the cache must have been built with
+	//! \return false if the cache does not exist, is outdated or invalid
+	bool open(const QString &cacheFilename, const QString &sourceFilename, quint64 settingsKey);
+
+	void close();
+
+	inline const LineCacheHeader &getHeader() const { return header; }
+
+	//! \brief line positions inside the mapping, valid until close()
+	inline const glm::vec3 *getPositions() const { return positions; }
+
+	//! \brief track offsets inside the mapping (numTracks+1 entries), valid until close()
+	inline const qint64 *getTrackOffsets() const { return trackOffsets; }
+
+private:
+	QFile file;
+	LineCacheHeader header;
+	const glm::vec3 *positions;
+	const qint64 *trackOffsets;
+};
+
+//! \brief The LineCacheWriter class.
+//!
+//! Writes a line cache file while the line positions are generated chunk by chunk.
+//! Data is written to a temporary file which replaces the cache file only in finish(),
+//! so an aborted or failed write never leaves a partial cache behind.
+class LineCacheWriter
+{
+public:
+	LineCacheWriter();
+	~LineCacheWriter();
+
+	//! \brief start writing a cache file for the given source file
+	//! \return false if the cache file cannot be created
+	bool begin(const QString &cacheFilename, const QString &sourceFilename, quint64 settingsKey);
+
+	//! \brief append a chunk of line positions
+	bool appendPositions(const std::vector<glm::vec3> &positions);
+
+	//! \brief write track offsets and bounds and move the finished cache into place
+	//! \param trackOffsets first point of each track, last entry is the total number of points
+	bool finish(const std::vector<qint64> &trackOffsets, glm::vec3 boundingBoxMin, glm::vec3 boundingBoxMax);
+
+	//! \brief discard the cache file being written
+	void abort();
+
+private:
+	QString cacheFilename;
+	QFile file;
+	LineCacheHeader header;
+	bool failed;
+};
+
+//! \brief get the path of the line cache file for a source file (in the user cache directory)
+QString lineCacheFilename(const QString &sourceFilename);
+
+#endif // LINECACHE_H
@@ -0,0 +1,627 @@
+#include "linedata.h"
+
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSharedPointer>
+#include <glm/gtc/packing.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define LINEDATA_USE_SSE2
+#endif
+
+#ifdef LINEDATA_USE_SSE2
+//! \brief load 4 interleaved x,y,z points and transpose them into one register per coordinate
+static inline void loadPoints4(const float *points, __m128 &x, __m128 &y, __m128 &z)
+{
+	__m128 a = _mm_loadu_ps(points);     // x0 y0 z0 x1
+	__m128 b = _mm_loadu_ps(points + 4); // y1 z1 x2 y2
+	__m128 c = _mm_loadu_ps(points + 8); // z2 x3 y3 z3
+	x = _mm_shuffle_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(3,3,0,0)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(1,1,2,2)), _MM_SHUFFLE(2,0,2,0));
+	y = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(0,0,1,1)), _mm_shuffle_ps(b, c, _MM_SHUFFLE(2,2,3,3)), _MM_SHUFFLE(2,0,2,0));
+	z = _mm_shuffle_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(1,1,2,2)), _mm_shuffle_ps(c, c, _MM_SHUFFLE(3,3,0,0)), _MM_SHUFFLE(2,0,2,0));
+}
+
+//! \brief interleave one register per coordinate into 4 x,y,z points and store them
+static inline void storePoints4(float *points, __m128 x, __m128 y, __m128 z)
+{
+	_mm_storeu_ps(points,     _mm_shuffle_ps(_mm_shuffle_ps(x, y, _MM_SHUFFLE(0,0,0,0)), _mm_shuffle_ps(z, x, _MM_SHUFFLE(1,1,0,0)), _MM_SHUFFLE(2,0,2,0)));
+	_mm_storeu_ps(points + 4, _mm_shuffle_ps(_mm_shuffle_ps(y, z, _MM_SHUFFLE(1,1,1,1)), _mm_shuffle_ps(x, y, _MM_SHUFFLE(2,2,2,2)), _MM_SHUFFLE(2,0,2,0)));
+	_mm_storeu_ps(points + 8, _mm_shuffle_ps(_mm_shuffle_ps(z, x, _MM_SHUFFLE(3,3,2,2)), _mm_shuffle_ps(y, z, _MM_SHUFFLE(3,3,3,3)), _MM_SHUFFLE(2,0,2,0)));
+}
+
+static inline double horizontalSum(__m128 v)
+{
+	float f[4];
+	_mm_storeu_ps(f, v);
+	return (static_cast<double>(f[0]) + f[1]) + (static_cast<double>(f[2]) + f[3]);
+}
+
+static inline float horizontalMin(__m128 v)
+{
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,0,3,2)));
+	v = _mm_min_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtss_f32(v);
+}
+
+static inline float horizontalMax(__m128 v)
+{
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(1,0,3,2)));
+	v = _mm_max_ps(v, _mm_shuffle_ps(v, v, _MM_SHUFFLE(2,3,0,1)));
+	return _mm_cvtss_f32(v);
+}
+#endif
+
+PositionStats::PositionStats()
+	: sum(0, 0, 0),
+	  min(std::numeric_limits<float>::max()),
+	  max(-std::numeric_limits<float>::max()),
+	  count(0)
+{
+}
+
+void PositionStats::merge(const PositionStats &other)
+{
+	sum += other.sum;
+	min = glm::min(min, other.min);
+	max = glm::max(max, other.max);
+	count += other.count;
+}
+
+void reducePositions(const float *positions, size_t numPositions, PositionStats &stats)
+{
+	size_t i = 0;
+
+#ifdef LINEDATA_USE_SSE2
+	// 4 points per iteration, sums are accumulated in float for short runs only and then added to the double sums
+	const size_t pointsPerRun = 1024;
+	const size_t numPositions4 = numPositions & ~static_cast<size_t>(3);
+	__m128 minX = _mm_set1_ps(stats.min.x), minY = _mm_set1_ps(stats.min.y), minZ = _mm_set1_ps(stats.min.z);
+	__m128 maxX = _mm_set1_ps(stats.max.x), maxY = _mm_set1_ps(stats.max.y), maxZ = _mm_set1_ps(stats.max.z);
+
+	while (i < numPositions4) {
+		size_t runEnd = std::min(numPositions4, i + pointsPerRun);
+		__m128 sumX = _mm_setzero_ps(), sumY = _mm_setzero_ps(), sumZ = _mm_setzero_ps();
+		for (; i < runEnd; i += 4) {
+			__m128 x, y, z;
+			loadPoints4(positions + 3*i, x, y, z);
+			sumX = _mm_add_ps(sumX, x); sumY = _mm_add_ps(sumY, y); sumZ = _mm_add_ps(sumZ, z);
+			minX = _mm_min_ps(minX, x); minY = _mm_min_ps(minY, y); minZ = _mm_min_ps(minZ, z);
+			maxX = _mm_max_ps(maxX, x); maxY = _mm_max_ps(maxY, y); maxZ = _mm_max_ps(maxZ, z);
+		}
+		stats.sum += glm::dvec3(horizontalSum(sumX), horizontalSum(sumY), horizontalSum(sumZ));
+	}
+
+	stats.min = glm::vec3(horizontalMin(minX), horizontalMin(minY), horizontalMin(minZ));
+	stats.max = glm::vec3(horizontalMax(maxX), horizontalMax(maxY), horizontalMax(maxZ));
+#endif
+
+	// remaining points
+	for (; i < numPositions; ++i) {
+		glm::vec3 pos = glm::vec3(positions[3*i], positions[3*i+1], positions[3*i+2]);
+		stats.sum += glm::dvec3(pos);
+		stats.min = glm::min(stats.min, pos);
+		stats.max = glm::max(stats.max, pos);
+	}
+
+	stats.count += numPositions;
+}
+
+void transformTrackPositions(const float *positions, size_t numPositions, const glm::vec3 &normalizationCenter, float normalizationScale,
+							 glm::vec3 *linePositions, glm::vec3 &boundingBoxMin, glm::vec3 &boundingBoxMax)
+{
+	size_t i = 0;
+
+#ifdef LINEDATA_USE_SSE2
+	// 4 points per iteration, y and z are swapped by swapping the registers
+	float *out = reinterpret_cast<float *>(linePositions);
+	const size_t numPositions4 = numPositions & ~static_cast<size_t>(3);
+	const __m128 centerX = _mm_set1_ps(normalizationCenter.x), centerY = _mm_set1_ps(normalizationCenter.y), centerZ = _mm_set1_ps(normalizationCenter.z);
+	const __m128 scale = _mm_set1_ps(normalizationScale);
+	__m128 minX = _mm_set1_ps(boundingBoxMin.x), minY = _mm_set1_ps(boundingBoxMin.y), minZ = _mm_set1_ps(boundingBoxMin.z);
+	__m128 maxX = _mm_set1_ps(boundingBoxMax.x), maxY = _mm_set1_ps(boundingBoxMax.y), maxZ = _mm_set1_ps(boundingBoxMax.z);
+
+	for (; i < numPositions4; i += 4) {
+		__m128 x, y, z;
+		loadPoints4(positions + 3*i, x, z, y); // swap y and z (we use different coords)
+		x = _mm_mul_ps(_mm_sub_ps(x, centerX), scale);
+		y = _mm_mul_ps(_mm_sub_ps(y, centerY), scale);
+		z = _mm_mul_ps(_mm_sub_ps(z, centerZ), scale);
+		minX = _mm_min_ps(minX, x); minY = _mm_min_ps(minY, y); minZ = _mm_min_ps(minZ, z);
+		maxX = _mm_max_ps(maxX, x); maxY = _mm_max_ps(maxY, y); maxZ = _mm_max_ps(maxZ, z);
+		storePoints4(out + 3*i, x, y, z);
+	}
+
+	boundingBoxMin = glm::vec3(horizontalMin(minX), horizontalMin(minY), horizontalMin(minZ));
+	boundingBoxMax = glm::vec3(horizontalMax(maxX), horizontalMax(maxY), horizontalMax(maxZ));
+#endif
+
+	// remaining points
+	for (; i < numPositions; ++i) {
+		const float *point = &positions[3*i];
+		glm::vec3 pos = glm::vec3(point[0], point[2], point[1]); // swap y and z (we use different coords)
+		pos = (pos - normalizationCenter) * normalizationScale;
+		boundingBoxMin = glm::min(boundingBoxMin, pos);
+		boundingBoxMax = glm::max(boundingBoxMax, pos);
+		linePositions[i] = pos;
+	}
+}
+
+//! \brief write the two strip vertices of each point of a single line
+static void writeLineVertices(const glm::vec3 *linePositions, size_t numPositions, LineVertex *lineVertices)
+{
+	// GENERATE ADDITIONAL LINE VERTEX DATA AT LINE POSITIONS (directions and uv)
+
+	if (numPositions == 0)
+		return;
+
+	if (numPositions == 1) {
+		// a single point does not define a line direction, store a degenerate strip
+		LineVertex vertex;
+		vertex.pos = linePositions[0];
+		vertex.directionToNext = glm::vec3(0,0,0);
+		vertex.uv = glm::vec2(0,0);
+		lineVertices[0] = vertex;
+		vertex.uv = glm::vec2(0,1);
+		lineVertices[1] = vertex;
+		return;
+	}
+
+	glm::vec3 directionToCurrent = glm::vec3(0,0,0);
+	glm::vec3 directionToNext;
+	const float uScale = 1.0f / (numPositions-1);
+
+	for (size_t i = 0; i < numPositions; ++i) {
+
+		LineVertex vertex;
+		vertex.pos = linePositions[i];
+
+		// generate vertex data: direction to next vertex
+		// take average of direction to current and direction to next for smoother directions
+		// the direction to next of this point is the direction to current of the next point
+		if (i == numPositions-1) // last element
+			directionToNext = glm::vec3(0,0,0);
+		else
+			directionToNext = glm::normalize(linePositions[i+1] - linePositions[i]);
+		vertex.directionToNext = glm::normalize(glm::vec3(directionToCurrent + directionToNext));
+		directionToCurrent = directionToNext;
+
+		// generate vertex data: uv coordinates to render line as view-aligned triangle strips
+		// for this we need two vertices!
+		// u-coordinate is same for both and is interpolated along the length of the whole line,
+		// v-coordinate is set to 0 for vertex on "right" side of the strip and to 1 for vertex on "left" side.
+		float u = i * uScale;
+		vertex.uv = glm::vec2(u,0);
+		LineVertex vertexCopy = vertex;
+		vertexCopy.uv = glm::vec2(u,1);
+
+		// store the vertex and its copy in sequential manner
+		lineVertices[2*i] = vertex;
+		lineVertices[2*i + 1] = vertexCopy;
+	}
+}
+
+void generateTrackLineVertices(const glm::vec3 *linePositions, const int64_t *trackOffsets, size_t numTracks, LineVertex *lineVertices)
+{
+	for (size_t trackIndex = 0; trackIndex < numTracks; ++trackIndex) {
+		int64_t trackBegin = trackOffsets[trackIndex];
+		writeLineVertices(linePositions + trackBegin, trackOffsets[trackIndex+1] - trackBegin, lineVertices + 2*trackBegin);
+	}
+}
+
+//! \brief generates the line vertices of a range of tracks on a thread pool
+class TrackLineVertexGenerator : public QRunnable
+{
+public:
+	TrackLineVertexGenerator(const glm::vec3 *linePositions, const int64_t *trackOffsets, size_t numTracks, LineVertex *lineVertices)
+		: linePositions(linePositions), trackOffsets(trackOffsets), numTracks(numTracks), lineVertices(lineVertices)
+	{
+	}
+
+	void run()
+	{
+		generateTrackLineVertices(linePositions, trackOffsets, numTracks, lineVertices);
+	}
+
+private:
+	const glm::vec3 *linePositions;
+	const int64_t *trackOffsets;
+	size_t numTracks;
+	LineVertex *lineVertices;
+};
+
+void generateTrackLineVerticesParallel(const glm::vec3 *linePositions, const int64_t *trackOffsets, size_t numTracks, LineVertex *lineVertices)
+{
+	if (numTracks == 0)
+		return;
+
+	// split the tracks into ranges of similar point count, a few per thread to balance tracks of different length
+	QThreadPool threadPool;
+	const int64_t numPositions = trackOffsets[numTracks] - trackOffsets[0];
+	const int64_t rangeNumPositions = std::max<int64_t>(numPositions / (4 * std::max(threadPool.maxThreadCount(), 1)), 1 << 14);
+	if (numPositions <= rangeNumPositions) {
+		generateTrackLineVertices(linePositions, trackOffsets, numTracks, lineVertices);
+		return;
+	}
+
+	size_t firstTrack = 0;
+	while (firstTrack < numTracks) {
+		size_t lastTrack = firstTrack + 1;
+		while (lastTrack < numTracks && trackOffsets[lastTrack] - trackOffsets[firstTrack] < rangeNumPositions) {
+			++lastTrack;
+		}
+		threadPool.start(new TrackLineVertexGenerator(linePositions, trackOffsets + firstTrack, lastTrack - firstTrack, lineVertices));
+		firstTrack = lastTrack;
+	}
+	threadPool.waitForDone();
+}
+
+float resampleTracks(const LineData &lines, float step, LineData &resampled, float maxGrowth)
+{
+	const size_t numTracks = lines.getNumTracks();
+	const bool hasScalars = lines.scalars.size() == lines.positions.size() && !lines.scalars.empty();
+
+	// predict the number of points from the track lengths before allocating anything,
+	// in double precision as a tiny step makes length/step overflow any integer
+	std::vector<float> trackLengths(numTracks);
+	double totalLength = 0;
+	double numPointsPredicted = 0;
+	int64_t numFixedPoints = 0; // points of tracks that do not depend on the step
+	for (size_t trackIndex = 0; trackIndex < numTracks; ++trackIndex) {
+		const int64_t trackBegin = lines.trackOffsets[trackIndex];
+		const int64_t trackEnd = lines.trackOffsets[trackIndex + 1];
+		float length = 0;
+		for (int64_t i = trackBegin + 1; i < trackEnd; ++i)
+			length += glm::length(lines.positions[i] - lines.positions[i - 1]);
+		trackLengths[trackIndex] = length;
+
+		if (trackEnd - trackBegin > 1 && length > 0) {
+			totalLength += length;
+			numPointsPredicted += std::ceil(length / double(step)) + 1;
+		}
+		else {
+			numFixedPoints += std::min<int64_t>(trackEnd - trackBegin, 2);
+		}
+	}
+
+	// enlarge the step so that the output stays within maxGrowth times the input points.
+	// each of the n tracks with length gets at most length/step+2 points, so the sum is at most totalLength/step+2n
+	const int64_t numLongTracks = static_cast<int64_t>(numTracks) - std::count(trackLengths.begin(), trackLengths.end(), 0.0f);
+	const double maxNumPoints = std::max(double(maxGrowth) * lines.positions.size(), double(numFixedPoints + 3 * numLongTracks));
+	if (!(numPointsPredicted + numFixedPoints <= maxNumPoints) && numLongTracks > 0)
+		step = static_cast<float>(totalLength / (maxNumPoints - numFixedPoints - 2 * numLongTracks));
+
+	// count the points of each track from its length, a prefix sum gives the track offsets
+	resampled.trackOffsets.resize(numTracks + 1);
+	resampled.trackOffsets[0] = 0;
+	for (size_t trackIndex = 0; trackIndex < numTracks; ++trackIndex) {
+		const int64_t trackBegin = lines.trackOffsets[trackIndex];
+		const int64_t trackEnd = lines.trackOffsets[trackIndex + 1];
+		const float length = trackLengths[trackIndex];
+
+		// single points stay single points, tracks without length keep their ends
+		int64_t numPoints = trackEnd - trackBegin;
+		if (numPoints > 1)
+			numPoints = length > 0 ? static_cast<int64_t>(std::ceil(length / step)) + 1 : 2;
+		resampled.trackOffsets[trackIndex + 1] = resampled.trackOffsets[trackIndex] + numPoints;
+	}
+
+	const int64_t numPointsTotal = resampled.trackOffsets[numTracks];
+	resampled.positions.resize(numPointsTotal);
+	resampled.scalars.resize(hasScalars ? numPointsTotal : 0);
+
+	// walk along each track and place the points at equal distances
+	for (size_t trackIndex = 0; trackIndex < numTracks; ++trackIndex) {
+		const int64_t trackBegin = lines.trackOffsets[trackIndex];
+		const int64_t trackEnd = lines.trackOffsets[trackIndex + 1];
+		const int64_t first = resampled.trackOffsets[trackIndex];
+		const int64_t numPoints = resampled.trackOffsets[trackIndex + 1] - first;
+		if (numPoints == 0)
+			continue;
+
+		const float spacing = numPoints > 1 ? trackLengths[trackIndex] / (numPoints - 1) : 0;
+		int64_t segment = trackBegin; // current segment [segment, segment+1] of the input track
+		float segmentStart = 0; // arc length at the start of the segment
+		for (int64_t k = 0; k < numPoints; ++k) {
+			int64_t out = first + k;
+			if (k == numPoints - 1) {
+				// end exactly at the last point, without accumulated rounding
+				resampled.positions[out] = lines.positions[trackEnd - 1];
+				if (hasScalars)
+					resampled.scalars[out] = lines.scalars[trackEnd - 1];
+				continue;
+			}
+
+			float s = k * spacing;
+			float segmentLength = segment + 1 < trackEnd ? glm::length(lines.positions[segment + 1] - lines.positions[segment]) : 0;
+			while (segment + 2 < trackEnd && segmentStart + segmentLength < s) {
+				segmentStart += segmentLength;
+				++segment;
+				segmentLength = glm::length(lines.positions[segment + 1] - lines.positions[segment]);
+			}
+
+			int64_t next = std::min(segment + 1, trackEnd - 1);
+			float t = segmentLength > 0 ? glm::clamp((s - segmentStart) / segmentLength, 0.0f, 1.0f) : 0.0f;
+			resampled.positions[out] = lines.positions[segment] + (lines.positions[next] - lines.positions[segment]) * t;
+			if (hasScalars) {
+				float a = glm::unpackHalf1x16(lines.scalars[segment]);
+				float b = glm::unpackHalf1x16(lines.scalars[next]);
+				resampled.scalars[out] = glm::packHalf1x16(a + (b - a) * t);
+			}
+		}
+	}
+	return step;
+}
+
+//! tracks are grouped by the cell of their center in a grid of this many cells per axis over the normalized dataset [-1,1]^3
+static const int LINE_GROUP_GRID_SIZE = 8;
+
+void appendLineGroups(const LineData &lines, size_t firstPoint, std::vector<LineGroup> &groups)
+{
+	if (groups.empty()) {
+		groups.resize(LINE_GROUP_GRID_SIZE * LINE_GROUP_GRID_SIZE * LINE_GROUP_GRID_SIZE);
+		for (LineGroup &group : groups) {
+			group.boundsMin = glm::vec3(std::numeric_limits<float>::max());
+			group.boundsMax = glm::vec3(-std::numeric_limits<float>::max());
+		}
+	}
+
+	// two strip vertices per line point, tracks of a single point have no segment to draw
+	const size_t numTracks = lines.getNumTracks();
+	for (size_t i = 0; i < numTracks; ++i) {
+		const int64_t trackBegin = lines.trackOffsets[i];
+		const int64_t trackEnd = lines.trackOffsets[i + 1];
+		if (trackEnd - trackBegin < 2)
+			continue;
+
+		glm::vec3 trackMin = lines.positions[trackBegin];
+		glm::vec3 trackMax = trackMin;
+		for (int64_t p = trackBegin + 1; p < trackEnd; ++p) {
+			trackMin = glm::min(trackMin, lines.positions[p]);
+			trackMax = glm::max(trackMax, lines.positions[p]);
+		}
+
+		// grid cell of the track center, tracks outside the normalized range go to the border cells
+		glm::ivec3 cell = glm::ivec3((0.5f * (trackMin + trackMax) + 1.0f) * (0.5f * LINE_GROUP_GRID_SIZE));
+		cell = glm::clamp(cell, glm::ivec3(0), glm::ivec3(LINE_GROUP_GRID_SIZE - 1));
+		LineGroup &group = groups[(cell.z * LINE_GROUP_GRID_SIZE + cell.y) * LINE_GROUP_GRID_SIZE + cell.x];
+
+		group.boundsMin = glm::min(group.boundsMin, trackMin);
+		group.boundsMax = glm::max(group.boundsMax, trackMax);
+		group.trackFirstVertices.push_back(static_cast<int32_t>(2 * (firstPoint + trackBegin)));
+		group.trackNumVertices.push_back(static_cast<int32_t>(2 * (trackEnd - trackBegin)));
+	}
+}
+
+void getFrustumPlanes(const glm::mat4 &viewProjMat, glm::vec4 frustumPlanes[6])
+{
+	// glm matrices are indexed by column
+	const glm::vec4 row0(viewProjMat[0][0], viewProjMat[1][0], viewProjMat[2][0], viewProjMat[3][0]);
+	const glm::vec4 row1(viewProjMat[0][1], viewProjMat[1][1], viewProjMat[2][1], viewProjMat[3][1]);
+	const glm::vec4 row2(viewProjMat[0][2], viewProjMat[1][2], viewProjMat[2][2], viewProjMat[3][2]);
+	const glm::vec4 row3(viewProjMat[0][3], viewProjMat[1][3], viewProjMat[2][3], viewProjMat[3][3]);
+	frustumPlanes[0] = row3 + row0;
+	frustumPlanes[1] = row3 - row0;
+	frustumPlanes[2] = row3 + row1;
+	frustumPlanes[3] = row3 - row1;
+	frustumPlanes[4] = row3 + row2;
+	frustumPlanes[5] = row3 - row2;
+}
+
+bool isBoxInFrustum(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::vec4 frustumPlanes[6])
+{
+	// the box is outside a plane if its corner farthest along the plane normal is outside
+	for (int i = 0; i < 6; ++i) {
+		const glm::vec4 &plane = frustumPlanes[i];
+		glm::vec3 corner(plane.x >= 0 ? boundsMax.x : boundsMin.x, plane.y >= 0 ? boundsMax.y : boundsMin.y, plane.z >= 0 ? boundsMax.z : boundsMin.z);
+		if (glm::dot(glm::vec3(plane), corner) + plane.w < 0)
+			return false;
+	}
+	return true;
+}
+
+//! \brief squared distance of point p to the segment from a to a + ab
+static inline float distanceSquaredToSegment(const glm::vec3 &p, const glm::vec3 &a, const glm::vec3 &ab, float abLengthSquared)
+{
+	glm::vec3 ap = p - a;
+	float t = abLengthSquared > 0 ? glm::clamp(glm::dot(ap, ab) / abLengthSquared, 0.0f, 1.0f) : 0.0f;
+	glm::vec3 d = ap - ab * t;
+	return glm::dot(d, d);
+}
+
+void simplifyTracks(const LineData &lines, size_t firstTrack, size_t numTracks, float tolerance, LineData &simplified)
+{
+	const bool hasScalars = lines.scalars.size() == lines.positions.size() && simplified.scalars.size() == simplified.positions.size();
+	const float toleranceSquared = tolerance * tolerance;
+
+	std::vector<char> keep;
+	std::vector<std::pair<int64_t, int64_t> > segments; // [first, last] point ranges still to be checked
+
+	for (size_t trackIndex = firstTrack; trackIndex < firstTrack + numTracks; ++trackIndex) {
+		const int64_t trackBegin = lines.trackOffsets[trackIndex];
+		const int64_t numPoints = lines.trackOffsets[trackIndex + 1] - trackBegin;
+		const glm::vec3 *points = lines.positions.data() + trackBegin;
+
+		keep.assign(numPoints, 1);
+		if (numPoints > 2) {
+			std::fill(keep.begin() + 1, keep.end() - 1, 0);
+			segments.push_back(std::make_pair(int64_t(0), numPoints - 1));
+		}
+		while (!segments.empty()) {
+			int64_t first = segments.back().first;
+			int64_t last = segments.back().second;
+			segments.pop_back();
+
+			glm::vec3 ab = points[last] - points[first];
+			float abLengthSquared = glm::dot(ab, ab);
+			float maxDistanceSquared = toleranceSquared;
+			int64_t farthest = -1;
+			for (int64_t i = first + 1; i < last; ++i) {
+				float distanceSquared = distanceSquaredToSegment(points[i], points[first], ab, abLengthSquared);
+				if (distanceSquared > maxDistanceSquared) {
+					maxDistanceSquared = distanceSquared;
+					farthest = i;
+				}
+			}
+
+			// keep the farthest point if it is out of tolerance and check both halves again
+			if (farthest >= 0) {
+				keep[farthest] = 1;
+				if (farthest - first > 1)
+					segments.push_back(std::make_pair(first, farthest));
+				if (last - farthest > 1)
+					segments.push_back(std::make_pair(farthest, last));
+			}
+		}
+
+		for (int64_t i = 0; i < numPoints; ++i) {
+			if (keep[i]) {
+				simplified.positions.push_back(points[i]);
+				if (hasScalars)
+					simplified.scalars.push_back(lines.scalars[trackBegin + i]);
+			}
+		}
+		simplified.trackOffsets.push_back(simplified.positions.size());
+	}
+
+	if (!hasScalars)
+		simplified.scalars.clear();
+}
+
+//! \brief decimates a range of tracks on a thread pool
+class TrackSimplifier : public QRunnable
+{
+public:
+	TrackSimplifier(const LineData &lines, size_t firstTrack, size_t numTracks, float tolerance)
+		: lines(lines), firstTrack(firstTrack), numTracks(numTracks), tolerance(tolerance)
+	{
+		setAutoDelete(false);
+	}
+
+	void run()
+	{
+		simplifyTracks(lines, firstTrack, numTracks, tolerance, simplified);
+	}
+
+	LineData simplified;
+
+private:
+	const LineData &lines;
+	size_t firstTrack;
+	size_t numTracks;
+	float tolerance;
+};
+
+void simplifyTracksParallel(const LineData &lines, float tolerance, LineData &simplified)
+{
+	const size_t numTracks = lines.getNumTracks();
+	if (numTracks == 0)
+		return;
+
+	// split the tracks into ranges of similar point count, a few per thread to balance tracks of different length
+	QThreadPool threadPool;
+	const int64_t numPositions = lines.trackOffsets[numTracks] - lines.trackOffsets[0];
+	const int64_t rangeNumPositions = std::max<int64_t>(numPositions / (4 * std::max(threadPool.maxThreadCount(), 1)), 1 << 14);
+	if (numPositions <= rangeNumPositions) {
+		simplifyTracks(lines, 0, numTracks, tolerance, simplified);
+		return;
+	}
+
+	std::vector<QSharedPointer<TrackSimplifier> > simplifiers;
+	size_t firstTrack = 0;
+	while (firstTrack < numTracks) {
+		size_t lastTrack = firstTrack + 1;
+		while (lastTrack < numTracks && lines.trackOffsets[lastTrack] - lines.trackOffsets[firstTrack] < rangeNumPositions) {
+			++lastTrack;
+		}
+		simplifiers.push_back(QSharedPointer<TrackSimplifier>(new TrackSimplifier(lines, firstTrack, lastTrack - firstTrack, tolerance)));
+		threadPool.start(simplifiers.back().data());
+		firstTrack = lastTrack;
+	}
+	threadPool.waitForDone();
+
+	// the ranges are appended in track order
+	for (size_t i = 0; i < simplifiers.size(); ++i)
+		simplified.append(simplifiers[i]->simplified);
+}
+
+static inline int16_t packSnorm16(float value)
+{
+	return static_cast<int16_t>(std::floor(glm::clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f));
+}
+
+//! \brief map a unit vector onto the octahedron |x|+|y|+|z| = 1 and unfold it into the square [-1,1]^2
+static inline glm::vec2 encodeOctahedral(const glm::vec3 &direction)
+{
+	float l1 = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+	if (!(l1 > 0)) // zero or undefined direction
+		return glm::vec2(0, 0);
+
+	glm::vec2 e = glm::vec2(direction.x, direction.y) / l1;
+	if (direction.z < 0) {
+		// fold the lower half over the diagonals
+		e = glm::vec2((1.0f - std::abs(e.y)) * (e.x >= 0 ? 1.0f : -1.0f), (1.0f - std::abs(e.x)) * (e.y >= 0 ? 1.0f : -1.0f));
+	}
+	return e;
+}
+
+float getPackedPositionRange(const LineData &lines, float minRange)
+{
+	float maxCoordinate = 0;
+	for (const glm::vec3 &position : lines.positions)
+		maxCoordinate = std::max(maxCoordinate, std::max(std::abs(position.x), std::max(std::abs(position.y), std::abs(position.z))));
+
+	float range = std::max(minRange, PackedLineVertex::POSITION_RANGE);
+	while (range < maxCoordinate && range < std::numeric_limits<float>::max() / 2)
+		range *= 2;
+	return range;
+}
+
+void packLineVertices(const LineVertex *lineVertices, size_t numVertices, float positionRange, PackedLineVertex *packedVertices)
+{
+	const float positionScale = 1.0f / positionRange;
+
+	for (size_t i = 0; i < numVertices; ++i) {
+		const LineVertex &vertex = lineVertices[i];
+		PackedLineVertex &packed = packedVertices[i];
+
+		for (int c = 0; c < 3; ++c)
+			packed.pos[c] = packSnorm16(vertex.pos[c] * positionScale);
+
+		glm::vec2 direction = encodeOctahedral(vertex.directionToNext);
+		packed.direction[0] = packSnorm16(direction.x);
+		packed.direction[1] = packSnorm16(direction.y);
+
+		uint16_t u = static_cast<uint16_t>(std::floor(glm::clamp(vertex.uv.x, 0.0f, 1.0f) * 16383.0f + 0.5f));
+		packed.uFlags = static_cast<uint16_t>(u << 2) | (vertex.uv.y > 0.5f ? PackedLineVertex::SIDE : 0);
+	}
+}
+
+void generateLineScalars(const float *scalars, size_t numScalars, std::vector<uint16_t> &lineScalars)
+{
+	size_t firstScalar = lineScalars.size();
+	lineScalars.resize(firstScalar + numScalars);
+
+	for (size_t i = 0; i < numScalars; ++i) {
+		lineScalars[firstScalar + i] = glm::packHalf1x16(scalars[i]);
+	}
+}
+
+void LineData::append(const LineData &other)
+{
+	// scalars are only kept if all tracks have them
+	if (other.scalars.size() == other.positions.size() && scalars.size() == positions.size())
+		scalars.insert(scalars.end(), other.scalars.begin(), other.scalars.end());
+	else
+		scalars.clear();
+
+	int64_t firstPoint = positions.size();
+	positions.insert(positions.end(), other.positions.begin(), other.positions.end());
+	trackOffsets.reserve(trackOffsets.size() + other.getNumTracks());
+	for (size_t i = 1; i < other.trackOffsets.size(); ++i) {
+		trackOffsets.push_back(firstPoint + other.trackOffsets[i] - other.trackOffsets[0]);
+	}
+}
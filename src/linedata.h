@@ -0,0 +1,157 @@
+#pragma once
+
+#include <vector>
+#include <stdint.h>
+#include <glm/glm.hpp>
+
+#include "linevertex.h"
+
+//! \brief The LineData struct.
+//! Normalized line positions of whole tracks stored back to back, used for loaded chunks as well as whole datasets.
+//! This is all that is kept of the line data, GLWidget generates the vertices it renders from it while uploading.
+struct LineData
+{
+	LineData() : trackOffsets(1, 0) {}
+
+	std::vector<glm::vec3> positions; //!< points of all tracks
+	std::vector<int64_t> trackOffsets; //!< numTracks+1 entries, the points of track i are [trackOffsets[i], trackOffsets[i+1])
+	std::vector<uint16_t> scalars; //!< optional half float scalar per point (e.g. FA), see generateLineScalars(), empty if not available
+
+	inline size_t getNumTracks() const
+	{
+		return trackOffsets.size() - 1;
+	}
+
+	//! \brief append the tracks of other behind the tracks stored so far
+	void append(const LineData &other);
+};
+
+//! \brief The PositionStats struct.
+//! Sum and bounds of a set of x,y,z positions.
+//! Stats of separate parts of the data (e.g. computed on different threads) are combined with merge().
+struct PositionStats
+{
+	PositionStats();
+
+	//! \brief add the stats of other positions
+	void merge(const PositionStats &other);
+
+	glm::dvec3 sum;
+	glm::vec3 min;
+	glm::vec3 max;
+	int64_t count;
+};
+
+//! \brief accumulate sum, min and max of x,y,z positions into stats
+//! \param positions x,y,z coords of the points, 3*numPositions floats
+//! \param numPositions number of points
+//! \param stats stats the points are added to
+//!
+//! vectorized with SSE2 if available, sums are kept in double precision.
+void reducePositions(const float *positions, size_t numPositions, PositionStats &stats);
+
+//! \brief transform .trk track points into normalized line positions and update their bounds
+//! \param positions x,y,z coords of the track points, 3*numPositions floats
+//! \param numPositions number of points
+//! \param normalizationCenter subtracted from each position after swapping y and z
+//! \param normalizationScale multiplied to each centered position
+//! \param linePositions output, numPositions positions
+//! \param boundingBoxMin bounds the transformed positions are merged into
+//! \param boundingBoxMax bounds the transformed positions are merged into
+//!
+//! linePosition = (glm::vec3(x, z, y) - normalizationCenter) * normalizationScale, vectorized with SSE2 if available.
+void transformTrackPositions(const float *positions, size_t numPositions, const glm::vec3 &normalizationCenter, float normalizationScale,
+							 glm::vec3 *linePositions, glm::vec3 &boundingBoxMin, glm::vec3 &boundingBoxMax);
+
+//! \brief generate line vertices (directions and uv) of tracks from their line positions, each track is a separate line
+//! \param linePositions x,y,z coords of the points of all tracks
+//! \param trackOffsets numTracks+1 offsets, the points of track i are [trackOffsets[i], trackOffsets[i+1]) in linePositions
+//! \param numTracks number of tracks
+//! \param lineVertices output, the vertices of track i are written to [2*trackOffsets[i], 2*trackOffsets[i+1])
+//!
+//! each vertex consists of 8 floats: 3 position, 3 direction to next vertex, 2 uv.
+//! NOTE: two copies of all vertices are stored in sequential manner,
+//! with uv v-coordinate 0 and 1 to use for drawing as triangle strips (two strip vertices for each line vertex).
+//! u-coordinate is same for both and is interpolated along the length of each track,
+//! v-coordinate is set to 0 for vertex on "right" side of the strip and to 1 for vertex on "left" side.
+//! direction to next vertex: take average of direction to current and direction to next for smoother directions,
+//! directions and u never cross track boundaries.
+void generateTrackLineVertices(const glm::vec3 *linePositions, const int64_t *trackOffsets, size_t numTracks, LineVertex *lineVertices);
+
+//! \brief same as generateTrackLineVertices(), but the tracks are split into ranges processed in parallel on a thread pool
+void generateTrackLineVerticesParallel(const glm::vec3 *linePositions, const int64_t *trackOffsets, size_t numTracks, LineVertex *lineVertices);
+
+//! \brief reparameterize each track to points at a uniform arc-length step
+//! \param lines tracks to resample
+//! \param step max distance between consecutive points along a track, in line position units, must be > 0
+//! \param resampled output, replaced by the resampled tracks (and linearly interpolated scalars)
+//! \param maxGrowth the output has at most maxGrowth times the points of the input, a larger step is used if needed
+//! \return the step that was used
+//!
+//! a track of length l gets n = ceil(l/step)+1 points spaced l/(n-1) apart, first and last point are kept.
+//! the point counts of all tracks are computed first, the points are then written into the preallocated positions.
+float resampleTracks(const LineData &lines, float step, LineData &resampled, float maxGrowth = 16.0f);
+
+//! \brief The LineGroup struct. Tracks whose centers lie in the same cell of a grid over the normalized dataset,
+//! the tracks of a group are culled together against the view frustum by their bounding box
+struct LineGroup
+{
+	glm::vec3 boundsMin; //!< bounding box of all points of the tracks of the group
+	glm::vec3 boundsMax;
+	std::vector<int32_t> trackFirstVertices; //!< first strip vertex of each track for glMultiDrawArrays
+	std::vector<int32_t> trackNumVertices; //!< number of strip vertices of each track
+};
+
+//! \brief add the strips of the tracks of lines to the groups of the grid cells of their centers
+//! \param firstPoint index of the first point of lines in the drawn vertices, each point has two strip vertices
+//! \param groups one group per grid cell, created if empty
+//!
+//! tracks of a single point have no segment to draw and are left out, tracks outside the normalized range go to the border cells.
+void appendLineGroups(const LineData &lines, size_t firstPoint, std::vector<LineGroup> &groups);
+
+//! \brief planes of the view frustum in world space from the rows of a view projection matrix, the inside has positive distance
+void getFrustumPlanes(const glm::mat4 &viewProjMat, glm::vec4 frustumPlanes[6]);
+
+//! \brief whether any part of a box may be inside of the view frustum
+bool isBoxInFrustum(const glm::vec3 &boundsMin, const glm::vec3 &boundsMax, const glm::vec4 frustumPlanes[6]);
+
+//! \brief decimate tracks while keeping the shape within a distance tolerance (Douglas-Peucker)
+//! \param lines tracks to decimate
+//! \param firstTrack index of the first track to decimate
+//! \param numTracks number of tracks to decimate
+//! \param tolerance max distance of a dropped point to the decimated track, in line position units
+//! \param simplified the kept points (and their scalars) of each track are appended to it
+//!
+//! first and last point of each track are always kept. a track is split at its point farthest from the segment
+//! between the kept points until all points are within tolerance, so points are kept where the track bends and
+//! long straight stretches collapse to few points.
+void simplifyTracks(const LineData &lines, size_t firstTrack, size_t numTracks, float tolerance, LineData &simplified);
+
+//! \brief same as simplifyTracks() for all tracks, but the tracks are split into ranges processed in parallel on a thread pool
+void simplifyTracksParallel(const LineData &lines, float tolerance, LineData &simplified);
+
+//! \brief position range of the PackedLineVertex format that holds all line positions
+//! \param minRange the range is at least this large, e.g. the range of the points packed so far
+//! \return the smallest power of two that is at least minRange and the largest absolute coordinate
+//!
+//! normalized datasets stay in the default PackedLineVertex::POSITION_RANGE, tracks outside of the volume
+//! in the file header (e.g. a wrong voxel size) need a larger one.
+float getPackedPositionRange(const LineData &lines, float minRange = PackedLineVertex::POSITION_RANGE);
+
+//! \brief quantize line vertices into the compact PackedLineVertex format
+//! \param lineVertices vertices with positions in [-positionRange, positionRange], outside positions are clamped
+//! \param numVertices number of vertices
+//! \param positionRange see getPackedPositionRange(), the shaders get it as LineRenderParameters::positionRange
+//! \param packedVertices output, numVertices packed vertices
+//!
+//! positions are stored as snorm16, directions octahedral encoded in 2 snorm16, u in 14 bits next to the strip side bit (uv v-coordinate).
+//! the largest position error is positionRange/65534 (about 3e-5 for the default range), the largest direction error is below 1e-4 radians.
+void packLineVertices(const LineVertex *lineVertices, size_t numVertices, float positionRange, PackedLineVertex *packedVertices);
+
+//! \brief generate per line point scalars (e.g. FA of each track point) and append them to lineScalars
+//! \param scalars one scalar per line point
+//! \param numScalars number of line points
+//! \param lineScalars vector the half floats are appended to, one for each line point
+//!
+//! scalars are stored as 16 bit half floats, uploaded into a compact extra buffer next to the line vertices.
+void generateLineScalars(const float *scalars, size_t numScalars, std::vector<uint16_t> &lineScalars);
@@ -0,0 +1,50 @@
+#include "linelod.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <utility>
+
+//! number of decimation levels built next to the full resolution dataset
+static const int NUM_LODS = 3;
+//! tolerance of the finest level in normalized line position units, about a pixel of a dataset filling a 4k screen
+static const float FIRST_LOD_TOLERANCE = 0.0005f;
+//! each level allows this factor more error than the one before
+static const float LOD_TOLERANCE_FACTOR = 4.0f;
+//! a level is not worth drawing if it keeps more than this fraction of the points of the level before
+static const float MAX_LOD_POINT_FRACTION = 0.8f;
+
+LineLodBuilder::LineLodBuilder(const LineData *lines, QObject *parent)
+		: QObject(parent)
+{
+	this->lines = lines;
+}
+
+void LineLodBuilder::build()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	// each level is decimated from the full resolution tracks, so its error bound holds for the original data
+	LineLods lods(new std::vector<LineLod>());
+	size_t numPointsBefore = lines->positions.size();
+	float tolerance = FIRST_LOD_TOLERANCE;
+	for (int level = 0; level < NUM_LODS; ++level, tolerance *= LOD_TOLERANCE_FACTOR) {
+		if (isCancelled()) {
+			emit finished(LineLods());
+			return;
+		}
+
+		LineLod lod;
+		lod.tolerance = tolerance;
+		simplifyTracksParallel(*lines, tolerance, lod.lines);
+		if (lod.lines.positions.size() > MAX_LOD_POINT_FRACTION * numPointsBefore)
+			continue;
+
+		numPointsBefore = lod.lines.positions.size();
+		qDebug() << "Line LOD with tolerance" << tolerance << ":" << lod.lines.positions.size() << "of" << lines->positions.size() << "line vertices";
+		lods->push_back(std::move(lod));
+	}
+
+	qDebug() << "Line LODs built in" << timer.elapsed() << "ms";
+	emit finished(lods);
+}
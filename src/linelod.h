@@ -0,0 +1,66 @@
+#ifndef LINELOD_H
+#define LINELOD_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+#include <vector>
+
+#include "linedata.h"
+
+//! \brief The LineLod struct.
+//! One decimation level of a dataset, see simplifyTracks().
+struct LineLod
+{
+	float tolerance; //!< max distance of a dropped point to its decimated track, in normalized line position units
+	LineData lines; //!< decimated tracks, same tracks in the same order as the full resolution dataset
+};
+
+//! decimation levels of a dataset from fine to coarse, shared between builder thread and gui thread without copying
+typedef QSharedPointer<std::vector<LineLod> > LineLods;
+Q_DECLARE_METATYPE(LineLods)
+
+//! \brief The LineLodBuilder class.
+//!
+//! Builds decimation levels of a loaded dataset on a worker thread, each level with a larger tolerance than the one before.
+//! The tracks of each level are decimated in parallel on a thread pool.
+//! Move the builder to a QThread and start build() from there, cancel() may be called from any thread.
+class LineLodBuilder : public QObject
+{
+	Q_OBJECT
+
+public:
+	//! \param lines full resolution dataset, must not change until finished() was emitted
+	explicit LineLodBuilder(const LineData *lines, QObject *parent = 0);
+
+	//! \brief request the builder to stop as soon as possible, may be called from any thread
+	inline void cancel()
+	{
+		cancelRequested.storeRelease(1);
+	}
+
+	inline bool isCancelled() const
+	{
+		return cancelRequested.loadAcquire() != 0;
+	}
+
+public slots:
+
+	//! \brief build all levels, emits finished()
+	void build();
+
+signals:
+
+	//! \brief emitted when all levels are built or building was cancelled
+	//! \param lods decimation levels from fine to coarse, null if cancelled
+	void finished(LineLods lods);
+
+private:
+
+	const LineData *lines;
+	QAtomicInt cancelRequested;
+
+};
+
+#endif // LINELOD_H
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <stdint.h>
 #include <glm/glm.hpp>
 
 //! \brief The LineVertex struct.
@@ -10,3 +11,45 @@ struct LineVertex
 	glm::vec3 directionToNext; //!< direction to next vertex in line
 	glm::vec2 uv; //!< vertex uv for drawing line as triangle strips (u along line direction, v perpendicular to direction)
 };
+
+//! \brief The PackedLineVertex struct.
+//! 12 byte version of LineVertex for line positions normalized to [-1,1], see packLineVertices()
+struct PackedLineVertex
+{
+	//! \brief bits of uFlags
+	enum Flags
+	{
+		SIDE = 1 //!< uv v-coordinate, side of the triangle strip, bit 1 is unused
+	};
+
+	//! default range of the quantized positions, normalized datasets are in [-1,1] but may slightly exceed it.
+	//! datasets reaching farther use a larger range, see getPackedPositionRange()
+	static constexpr float POSITION_RANGE = 2.0f;
+
+	int16_t pos[3]; //!< snorm16 position divided by the position range
+	uint16_t uFlags; //!< unorm16, u in the upper 14 bits and Flags in the lower 2 bits
+	int16_t direction[2]; //!< snorm16 octahedral encoded unit direction to next vertex
+};
+
+//! \brief The LineRenderParameters struct.
+//! Per frame state of the line shaders in the std140 layout of their LineRenderParameters uniform block
+struct LineRenderParameters
+{
+	glm::mat4 viewProjMat;
+	glm::vec3 cameraPos;
+	float lineTriangleStripWidth;
+	glm::vec3 clipPlaneNormal; //!< zero if clipping is disabled
+	float clipPlaneDistance;
+	glm::vec3 colorLine;
+	float lineWidthPercentageBlack;
+	glm::vec3 colorHalo;
+	float lineWidthDepthCueingFactor;
+	glm::vec2 scalarRange;
+	float lineHaloMaxDepth;
+	float positionRange;
+	float nearPlane;
+	float farPlane;
+	uint32_t orthogonal; //!< GLSL bool
+	uint32_t colorByScalar; //!< GLSL bool
+};
+static_assert(sizeof(LineRenderParameters) == 160, "LineRenderParameters must match the std140 layout of the uniform block");
@@ -1,9 +1,37 @@
 #include <QApplication>
+#include <QGuiApplication>
+#include <QDebug>
+#include <cstring>
 
 #include "mainwindow.h"
+#include "offscreenrenderer.h"
 
 int main(int argc, char *argv[])
 {
+	// batch mode renders images without a window, e.g. on a server without display
+	bool batch = false, cpu = false, compare = false, help = false;
+	for (int i = 1; i < argc; ++i) {
+		batch = batch || std::strcmp(argv[i], "--batch") == 0;
+		cpu = cpu || std::strcmp(argv[i], "--cpu") == 0;
+		compare = compare || std::strncmp(argv[i], "--compare", 9) == 0; // reference images are rendered with OpenGL
+		help = help || std::strcmp(argv[i], "--help") == 0 || std::strcmp(argv[i], "-h") == 0;
+	}
+	if (batch) {
+		if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+			// the offscreen platform of Qt 5 creates OpenGL contexts with GLX, so it needs an X server although no window is shown.
+			// fail early with a hint instead of a failing context creation, the CPU rasterizer needs no display
+			if ((!cpu || compare) && !help && qEnvironmentVariableIsEmpty("DISPLAY")) {
+				qDebug() << "batch rendering with OpenGL needs an X display but DISPLAY is not set.";
+				qDebug() << "On servers without display run it in a virtual X server, e.g. xvfb-run -a" << argv[0] << "--batch ...,";
+				qDebug() << "or render on the CPU cores with --cpu.";
+				return 1;
+			}
+			qputenv("QT_QPA_PLATFORM", "offscreen");
+		}
+		QGuiApplication app(argc, argv);
+		return runBatchRendering(app.arguments());
+	}
+
 	QApplication app(argc, argv);
 
     MainWindow mainWindow;
@@ -5,9 +5,14 @@
 #include <stdlib.h>
 #include <time.h>
 
+#include <QApplication>
 #include <QFileDialog>
+#include <QFileInfo>
 #include <qmessagebox.h>
 #include <QPainter>
+#include <QSignalBlocker>
+
+#include "linedata.h"
 
 
 MainWindow::MainWindow(QWidget *parent) :
@@ -31,8 +36,15 @@ MainWindow::MainWindow(QWidget *parent) :
 
 
 	connect(ui->actionOpen, SIGNAL(triggered()), this, SLOT(openFileAction()));
+	connect(ui->actionCancelLoading, SIGNAL(triggered()), this, SLOT(cancelLoadingAction()));
+	connect(ui->actionExportCompressed, SIGNAL(triggered()), this, SLOT(exportCompressedAction()));
 	connect(ui->actionClose, SIGNAL(triggered()), this, SLOT(closeAction()));
 
+	// chunks of line data are passed from the loader thread via queued signals
+	qRegisterMetaType<LineDataChunk>("LineDataChunk");
+	qRegisterMetaType<LineLods>("LineLods");
+	qRegisterMetaType<TrkFileRanges>("TrkFileRanges");
+
 	ui->memSizeLCD->setPalette(Qt::darkBlue);
 	ui->usedMemLCD->setPalette(Qt::darkGreen);
 	ui->fpsLCD->setPalette(Qt::darkGreen);
@@ -41,6 +53,8 @@ MainWindow::MainWindow(QWidget *parent) :
 
 MainWindow::~MainWindow()
 {
+	stopLoading();
+	stopCompressing();
 	delete ui;
 }
 
@@ -57,7 +71,8 @@ void MainWindow::generateTestData(int numVertices, glm::vec3 boundingBoxMin, glm
 {
 	srand(time(NULL)); // change pseudorandom number generator seed
 
-	datasetLines.clear();
+	datasetLines = LineData();
+	datasetFileRanges.clear();
 
 	std::vector<glm::vec3> line1Positions;
 
@@ -100,214 +115,319 @@ void MainWindow::generateTestData(int numVertices, glm::vec3 boundingBoxMin, glm
 	ui->spinBoxLineWidthDepthCueingFactor->setValue(1.0f);
 	ui->spinBoxLineHaloMaxDepth->setValue(0.02f);
 
-	generateAdditionalLineVertexData(line1Positions);
+	// the test data is a single track
+	datasetLines.positions.swap(line1Positions);
+	datasetLines.trackOffsets.push_back(datasetLines.positions.size());
 
-	qDebug() << "Test line data generated:" << numVertices << "line vertices," << datasetLines[0].size() << "vertices after duplication for triangle strip drawing. Each vertex consists of 8 floats (3 pos, 3 direction to next, 2 uv for triangle strip drawing).";
+	qDebug() << "Test line data generated:" << numVertices << "line vertices," << 2*numVertices << "vertices after duplication for triangle strip drawing.";
 
 	glWidget->initLineRenderMode(&datasetLines);
+	startBuildingLineLods();
 }
 
 void MainWindow::openFileAction()
 {
-	QString filename = QFileDialog::getOpenFileName(this, "Open dataset file...", 0, tr("TrackVis Tractography Data Files (*.trk)"));
+	// several files can be selected, they are loaded in parallel into a single dataset
+	QStringList filenames = QFileDialog::getOpenFileNames(this, "Open dataset files...", 0, tr("TrackVis Tractography Data Files (*.trk *.trkz)"));
 
-	if (!filename.isEmpty()) {
-		// store filename
+	if (!filenames.isEmpty()) {
+		// store filename, the first file names the dataset
+		QString filename = filenames[0];
 		fileType.filename = filename;
 		std::string fn = filename.toStdString();
 
-		bool success = false;
+		// stop a load that may still be running, its remaining chunks are ignored
+		stopLoading();
 
 		// progress bar and top label
 		ui->progressBar->setEnabled(true);
+		ui->progressBar->setValue(0);
 		ui->labelTop->setText("Loading data ...");
 
 		QString filenameWithoutPath = QString::fromStdString(fn.substr(fn.find_last_of("/") + 1));
-		std::string filenameExtension = fn.substr(fn.find_last_of(".") + 1);
-		if (filenameExtension == "trk") { // TrackVis .trk Tractography track data
-			fileType.type = TRK;
-			success = loadTRKData(filename);
-		}
-		else {
-			success = false;
-			ui->labelTop->setText("Error loading file " + filenameWithoutPath + ": Unknown filename extension.");
+		// all files must be track files
+		for (const QString &f : filenames) {
+			std::string fnf = f.toStdString();
+			std::string filenameExtension = fnf.substr(fnf.find_last_of(".") + 1);
+			if (filenameExtension != "trk" && filenameExtension != "trkz") { // TrackVis .trk Tractography track data, or compressed .trkz
+				ui->progressBar->setEnabled(false);
+				ui->labelTop->setText("Error loading file " + QFileInfo(f).fileName() + ": Unknown filename extension.");
+				return;
+			}
 		}
 
-		ui->progressBar->setEnabled(false);
+		fileType.type = TRK;
+		startLoadingTRKData(filenames);
+	}
+}
 
-		// status message
-		if (success) {
-			QString type;
-			if (fileType.type == TRK) type = "TrackVis Tractography Data";
-			ui->labelTop->setText("File LOADED [" + filenameWithoutPath + "], Type [" + type + "]");
+void MainWindow::startLoadingTRKData(const QStringList &filenames)
+{
+	// load on a worker thread, the gui stays responsive and chunks are rendered as soon as they arrive
+	trkLoaderThread = new QThread(this);
+	trkLoader = new TrkLoader(filenames);
+	trkLoader->setResampleStep(static_cast<float>(ui->spinBoxResampleStep->value()));
+	trkLoader->moveToThread(trkLoaderThread);
+
+	connect(trkLoaderThread, &QThread::started, trkLoader, &TrkLoader::load);
+	connect(trkLoader, &TrkLoader::fileRangesChanged, this, &MainWindow::trkFileRangesChanged);
+	connect(trkLoader, &TrkLoader::loadStarted, this, &MainWindow::trkLoadStarted);
+	connect(trkLoader, &TrkLoader::scalarRangeChanged, this, &MainWindow::trkScalarRangeChanged);
+	connect(trkLoader, &TrkLoader::chunkLoaded, this, &MainWindow::trkChunkLoaded);
+	connect(trkLoader, &TrkLoader::progressChanged, this, &MainWindow::trkLoadProgressChanged);
+	connect(trkLoader, &TrkLoader::finished, this, &MainWindow::trkLoadFinished);
+
+	// clean up loader and thread when done
+	connect(trkLoader, &TrkLoader::finished, trkLoaderThread, &QThread::quit);
+	connect(trkLoaderThread, &QThread::finished, trkLoader, &QObject::deleteLater);
+	connect(trkLoaderThread, &QThread::finished, trkLoaderThread, &QObject::deleteLater);
+
+	trkLoaderThread->start();
+}
 
-			glWidget->initLineRenderMode(&datasetLines);
-		}
-		else {
-			ui->labelTop->setText("ERROR loading file " + filenameWithoutPath + "!");
-			ui->progressBar->setValue(0);
-		}
+void MainWindow::stopLoading()
+{
+	if (trkLoader) {
+		trkLoader->cancel();
+		trkLoader = nullptr; // signals still queued from the cancelled loader are ignored
+	}
+	if (trkLoaderThread) {
+		trkLoaderThread->quit();
+		trkLoaderThread->wait();
+		trkLoaderThread = nullptr;
+	}
+
+	// the builder reads datasetLines, it must be done before the dataset changes
+	if (lineLodBuilder) {
+		lineLodBuilder->cancel();
+		lineLodBuilder = nullptr;
+	}
+	if (lineLodBuilderThread) {
+		lineLodBuilderThread->quit();
+		lineLodBuilderThread->wait();
+		lineLodBuilderThread = nullptr;
 	}
 }
 
-bool MainWindow::loadTRKData(QString &filename) {
+void MainWindow::startBuildingLineLods()
+{
+	// decimation levels are built on a worker thread, the full resolution data is drawn meanwhile
+	lineLodBuilderThread = new QThread(this);
+	lineLodBuilder = new LineLodBuilder(&datasetLines);
+	lineLodBuilder->moveToThread(lineLodBuilderThread);
 
-	datasetLines.clear();
+	connect(lineLodBuilderThread, &QThread::started, lineLodBuilder, &LineLodBuilder::build);
+	connect(lineLodBuilder, &LineLodBuilder::finished, this, &MainWindow::lineLodsBuilt);
 
-	// note we store all lines in a single vector, and separate the ends via a flag set below
-	// this makes it easier to render using a single vbo
-	std::vector<glm::vec3> linePositions;
+	// clean up builder and thread when done
+	connect(lineLodBuilder, &LineLodBuilder::finished, lineLodBuilderThread, &QThread::quit);
+	connect(lineLodBuilderThread, &QThread::finished, lineLodBuilder, &QObject::deleteLater);
+	connect(lineLodBuilderThread, &QThread::finished, lineLodBuilderThread, &QObject::deleteLater);
 
-	std::string strInputFilePath = filename.toStdString();
+	lineLodBuilderThread->start();
+}
 
-	// create reader and open file
-	TrkFileReader trkFileReader(strInputFilePath);
-	if (!trkFileReader.open())
-		return false;
+void MainWindow::lineLodsBuilt(LineLods lods)
+{
+	if (sender() != lineLodBuilder)
+		return;
 
-	int numTracks = trkFileReader.getTotalTrkNum(); // number of tractography tracks (lines of traced nerves) in input file
-	int numPointsTotal = 0; // total count of points (vertices) in tracks
+	lineLodBuilder = nullptr;
+	lineLodBuilderThread = nullptr; // deletes itself when finished
 
-	// calculate data mean position and bounding box
+	if (lods)
+		glWidget->setLineLods(lods);
+}
 
-	glm::vec3 meanPos = glm::vec3(0, 0, 0);
-	glm::vec3 boundingBoxMin = glm::vec3(std::numeric_limits<float>::max(), std::numeric_limits<float>::max(), std::numeric_limits<float>::max());
-	glm::vec3 boundingBoxMax = glm::vec3(std::numeric_limits<float>::min(), std::numeric_limits<float>::min(), std::numeric_limits<float>::min());
+void MainWindow::cancelLoadingAction()
+{
+	// the compressor removes its unfinished file and reports back via trkCompressFinished()
+	if (trkCompressor) {
+		trkCompressor->cancel();
+		ui->labelTop->setText("Cancelling compression ...");
+	}
 
-    for (int trackIndex = 0; trackIndex < numTracks; ++trackIndex) {
+	if (!trkLoader)
+		return;
 
-		int numPointsInTrack = trkFileReader.getPointNumInTrk(trackIndex);
-		numPointsTotal += numPointsInTrack;
+	stopLoading();
+	ui->progressBar->setEnabled(false);
+	ui->labelTop->setText("Loading cancelled, " + QString::number(datasetLines.positions.size()) + " line vertices loaded.");
+}
 
-        for (int pointIndex = 0; pointIndex < numPointsInTrack; ++pointIndex) {
+void MainWindow::trkLoadStarted(qint64 numTracks, qint64 numPoints)
+{
+	if (sender() != trkLoader)
+		return;
 
-			std::vector<float> point; // x, y, z
-            trkFileReader.readPoint(trackIndex, pointIndex, point);
+	// chunks of whole tracks are appended behind each other
+	datasetLines = LineData();
+	datasetLines.positions.reserve(numPoints);
+	datasetLines.trackOffsets.reserve(numTracks + 1);
 
-			meanPos += glm::vec3(point[0], point[2], point[1]); // swap y and z (we use different coords)
+	// adjust draw parameters for this dataset
+	ui->spinBoxLineTriangleStripWidth->setValue(0.01f);
+	ui->spinBoxLineWidthPercentageBlack->setValue(0.5f);
+	ui->spinBoxLineWidthDepthCueingFactor->setValue(0.5f);
+	ui->spinBoxLineHaloMaxDepth->setValue(0.04f);
 
-			// adjust bounding box to fit track if necessary
-			if (point[0] > boundingBoxMax.x) { boundingBoxMax.x = point[0]; }
-			if (point[0] < boundingBoxMin.x) { boundingBoxMin.x = point[0]; }
-			if (point[2] > boundingBoxMax.y) { boundingBoxMax.y = point[2]; }
-			if (point[2] < boundingBoxMin.y) { boundingBoxMin.y = point[2]; }
-			if (point[1] > boundingBoxMax.z) { boundingBoxMax.z = point[1]; }
-			if (point[1] < boundingBoxMin.z) { boundingBoxMin.z = point[1]; }
-        }
-    }
+	if (numPoints > 200000) { // big dataset needs other parameters
+		ui->spinBoxLineTriangleStripWidth->setValue(0.006f);
+		ui->spinBoxLineWidthPercentageBlack->setValue(0.3f);
+		ui->spinBoxLineWidthDepthCueingFactor->setValue(1.0f);
+		ui->spinBoxLineHaloMaxDepth->setValue(0.04f);
+	}
 
-	meanPos /= static_cast<float>(numPointsTotal);
+	glWidget->beginLineStream(&datasetLines, numPoints);
 
-	// move bounding box such that mean pos is at origin
-	boundingBoxMin -= meanPos;
-	boundingBoxMax -= meanPos;
+	qDebug() << "Loading .trk data with:" << numTracks << "tracks," << numPoints << "line vertices";
+}
 
-	// find coordinate direction where bounding box has greatest extend
-	// used to set view such that everything is visible
-	float boundingBoxLengthX = boundingBoxMax.x - boundingBoxMin.x;
-	float boundingBoxLengthY = boundingBoxMax.y - boundingBoxMin.y;
-	float boundingBoxLengthZ = boundingBoxMax.z - boundingBoxMin.z;
-	float boundingBoxLengthMax = glm::max(boundingBoxLengthX, glm::max(boundingBoxLengthY, boundingBoxLengthZ));
-	float minValue = 0;
-	float maxValue = 0;
-	if (boundingBoxLengthMax == boundingBoxLengthX) { minValue = boundingBoxMin.x; maxValue = boundingBoxMax.x; }
-	if (boundingBoxLengthMax == boundingBoxLengthY) { minValue = boundingBoxMin.y; maxValue = boundingBoxMax.y; }
-	if (boundingBoxLengthMax == boundingBoxLengthZ) { minValue = boundingBoxMin.z; maxValue = boundingBoxMax.z; }
+void MainWindow::trkFileRangesChanged(TrkFileRanges fileRanges)
+{
+	if (sender() != trkLoader)
+		return;
 
-	// for each track read in all points
-	for (int trackIndex = 0; trackIndex < numTracks; ++trackIndex) {
+	datasetFileRanges = fileRanges;
+}
 
-		int numPointsInTrack = trkFileReader.getPointNumInTrk(trackIndex); // number of points in current track
-		for (int pointIndex = 0; pointIndex < numPointsInTrack; ++pointIndex) {
+void MainWindow::trkChunkLoaded(LineDataChunk chunk)
+{
+	if (sender() != trkLoader)
+		return;
 
-			std::vector<float> point;
-			trkFileReader.readPoint(trackIndex, pointIndex, point);
-			glm::vec3 pos = glm::vec3(point[0], point[2], point[1]); // swap y and z (we use different coords)
+	// upload first, the gpu buffers are uploaded again from the dataset if the chunk does not fit
+	glWidget->appendLineData(*chunk);
+	datasetLines.append(*chunk);
+}
 
-			// move data such that mean of all data points is at center of coordinate system
-			pos -= meanPos;
+void MainWindow::trkScalarRangeChanged(float scalarMin, float scalarMax)
+{
+	if (sender() != trkLoader)
+		return;
 
-			// scale data such that largest direction of bounding box is in [-1,1]
-			// i.e. map [minValue, maxValue] to [-1,1] or boundingBoxLengthMax to 2
-			pos = glm::vec3(-1) + 2.0f * ((pos - glm::vec3(minValue)) / boundingBoxLengthMax);
+	glWidget->scalarRange = glm::vec2(scalarMin, scalarMax);
+	glWidget->update();
+}
 
-			// dirty hack: we use this magic value as a flag
-			// to discard fragments in the fragment shader that connect end and start vertices of two separate lines
-			// this allows us to just use one vbo for all the triangle strip vertices which is much faster.
-			if (pointIndex == numPointsInTrack-1)
-				pos.z = 42.4242;
+void MainWindow::trkLoadProgressChanged(int percent)
+{
+	if (sender() != trkLoader)
+		return;
 
-			linePositions.push_back(pos);
-        }
-	}
+	ui->progressBar->setValue(percent);
+}
 
-	// close input file
-	trkFileReader.close();
+void MainWindow::trkLoadFinished(bool success, QString message)
+{
+	if (sender() != trkLoader)
+		return;
 
-	// adjust draw parameters for this dataset
-	ui->spinBoxLineTriangleStripWidth->setValue(0.01f);
-	ui->spinBoxLineWidthPercentageBlack->setValue(0.5f);
-	ui->spinBoxLineWidthDepthCueingFactor->setValue(0.5f);
-	ui->spinBoxLineHaloMaxDepth->setValue(0.04f);
+	trkLoader = nullptr;
+	trkLoaderThread = nullptr; // deletes itself when finished
 
-	if (numPointsTotal > 200000) { // big dataset needs other parameters
-		ui->spinBoxLineTriangleStripWidth->setValue(0.006f);
-		ui->spinBoxLineWidthPercentageBlack->setValue(0.3f);
-		ui->spinBoxLineWidthDepthCueingFactor->setValue(1.0f);
-		ui->spinBoxLineHaloMaxDepth->setValue(0.04f);
-	}
+	ui->progressBar->setEnabled(false);
 
-	generateAdditionalLineVertexData(linePositions);
+	std::string fn = fileType.filename.toStdString();
+	QString filenameWithoutPath = QString::fromStdString(fn.substr(fn.find_last_of("/") + 1));
 
-	ui->spinBoxTestDataNumVertices->setValue(datasetLines[0].size());
-	qDebug() << "Loaded .trk data with:" << linePositions.size() << "line vertices," << datasetLines[0].size() << "vertices after duplication for triangle strip drawing. Each vertex consists of 8 floats (3 pos, 3 direction to next, 2 uv for triangle strip drawing).";
+	// status message
+	if (success) {
+		QString type;
+		if (fileType.type == TRK) type = "TrackVis Tractography Data";
+		if (datasetFileRanges.size() > 1)
+			filenameWithoutPath += " + " + QString::number(datasetFileRanges.size() - 1) + " more";
+		ui->labelTop->setText("File LOADED [" + filenameWithoutPath + "], Type [" + type + "]");
 
-	return true;
+		ui->spinBoxTestDataNumVertices->setValue(2*datasetLines.positions.size());
+		startBuildingLineLods();
+		qDebug() << "Loaded .trk data with:" << datasetLines.getNumTracks() << "tracks," << datasetLines.positions.size() << "line vertices," << 2*datasetLines.positions.size() << "vertices after duplication for triangle strip drawing.";
+	}
+	else {
+		ui->labelTop->setText("ERROR loading file " + filenameWithoutPath + ": " + message);
+		ui->progressBar->setValue(0);
+	}
 }
 
-void MainWindow::generateAdditionalLineVertexData(std::vector<glm::vec3> linePositions)
+void MainWindow::exportCompressedAction()
 {
-	// GENERATE ADDITIONAL LINE VERTEX DATA AT LINE POSITIONS (directions and uv)
+	if (trkCompressor) {
+		ui->labelTop->setText("A file is still being compressed.");
+		return;
+	}
 
-	std::vector<LineVertex> lineVerticesDoubled;
+	QString trkFilename = QFileDialog::getOpenFileName(this, "Select track file to compress...", 0, tr("TrackVis Tractography Data Files (*.trk)"));
+	if (trkFilename.isEmpty())
+		return;
+
+	QString trkzFilename = QFileDialog::getSaveFileName(this, "Save compressed track file...", trkFilename + "z", tr("Compressed Tractography Data Files (*.trkz)"));
+	if (trkzFilename.isEmpty())
+		return;
+
+	// compress on a worker thread, large archives take long and the gui stays responsive.
+	// quantization error in track file units (usually mm), well below the voxel size of common datasets
+	trkCompressorThread = new QThread(this);
+	trkCompressor = new TrkCompressor(trkFilename, trkzFilename, TRKZ_DEFAULT_ERROR_BOUND);
+	trkCompressorFilenames[0] = trkFilename;
+	trkCompressorFilenames[1] = trkzFilename;
+	trkCompressor->moveToThread(trkCompressorThread);
+
+	connect(trkCompressorThread, &QThread::started, trkCompressor, &TrkCompressor::compress);
+	connect(trkCompressor, &TrkCompressor::progressChanged, this, &MainWindow::trkCompressProgressChanged);
+	connect(trkCompressor, &TrkCompressor::finished, this, &MainWindow::trkCompressFinished);
+
+	// clean up compressor and thread when done
+	connect(trkCompressor, &TrkCompressor::finished, trkCompressorThread, &QThread::quit);
+	connect(trkCompressorThread, &QThread::finished, trkCompressor, &QObject::deleteLater);
+	connect(trkCompressorThread, &QThread::finished, trkCompressorThread, &QObject::deleteLater);
+
+	ui->progressBar->setEnabled(true);
+	ui->progressBar->setValue(0);
+	ui->labelTop->setText("Compressing " + QFileInfo(trkFilename).fileName() + " ...");
+	trkCompressorThread->start();
+}
 
-	glm::vec3 directionToCurrent;
-	glm::vec3 directionToNext;
+void MainWindow::stopCompressing()
+{
+	if (trkCompressor) {
+		trkCompressor->cancel();
+		trkCompressor = nullptr; // signals still queued from the cancelled compressor are ignored
+	}
+	if (trkCompressorThread) {
+		trkCompressorThread->quit();
+		trkCompressorThread->wait();
+		trkCompressorThread = nullptr;
+	}
+}
 
-	for (int i = 0; i < linePositions.size(); ++i) {
+void MainWindow::trkCompressProgressChanged(int percent)
+{
+	if (sender() != trkCompressor)
+		return;
 
-		LineVertex vertex;
-		vertex.pos = linePositions[i];
+	ui->progressBar->setValue(percent);
+}
 
-		// generate vertex data: direction to next vertex
-		// take average of direction to current and direction to next for smoother directions
-		if (i == 0) { // first element
-			directionToCurrent = glm::vec3(0,0,0);
-			directionToNext = glm::normalize(linePositions[i+1] - linePositions[i]);
-		} else if (i == linePositions.size()-1) { // last element
-			directionToCurrent = glm::normalize(linePositions[i] - linePositions[i-1]);
-			directionToNext = glm::vec3(0,0,0);
-		} else {
-			directionToCurrent = glm::normalize(linePositions[i] - linePositions[i-1]);
-			directionToNext = glm::normalize(linePositions[i+1] - linePositions[i]);
-		}
-		vertex.directionToNext = glm::normalize(glm::vec3(directionToCurrent + directionToNext));
-
-		// generate vertex data: uv coordinates to render line as view-aligned triangle strips
-		// for this we need two vertices!
-		// u-coordinate is same for both and is interpolated along the length of the whole line,
-		// v-coordinate is set to 0 for vertex on "right" side of the strip and to 1 for vertex on "left" side.
-		float u = ((float)i) / (linePositions.size()-1);
-		vertex.uv = glm::vec2(u,0);
-		LineVertex vertexCopy = vertex;
-		vertexCopy.uv = glm::vec2(u,1);
-
-		// store the vertex and its copy in sequential manner
-		lineVerticesDoubled.push_back(vertex);
-		lineVerticesDoubled.push_back(vertexCopy);
+void MainWindow::trkCompressFinished(bool success, float maxError, QString message)
+{
+	if (sender() != trkCompressor)
+		return;
+
+	const QString &trkFilename = trkCompressorFilenames[0];
+	const QString &trkzFilename = trkCompressorFilenames[1];
+	trkCompressor = nullptr;
+	trkCompressorThread = nullptr; // deletes itself when finished
+
+	ui->progressBar->setEnabled(false);
+	if (success) {
+		qint64 trkSize = QFileInfo(trkFilename).size();
+		qint64 trkzSize = QFileInfo(trkzFilename).size();
+		ui->labelTop->setText("Compressed to " + QString::number(trkzSize / 1024) + " kb (" + QString::number(100.0 * trkzSize / std::max<qint64>(trkSize, 1), 'f', 1) + "% of original), max error " + QString::number(maxError) + ".");
+	}
+	else {
+		ui->labelTop->setText("Error compressing file " + QFileInfo(trkFilename).fileName() + ": " + message);
+		ui->progressBar->setValue(0);
 	}
-
-	datasetLines.push_back(lineVerticesDoubled);
 }
 
 void MainWindow::closeAction()
@@ -338,7 +458,10 @@ void MainWindow::displayUsedGPUMemory(float size)
 
 void MainWindow::displayFPS(int fps)
 {
-	if (fps < 10)
+	// frames are only drawn on changes, 0 fps means the view is idle and not slow
+	if (fps == 0)
+		ui->fpsLCD->setPalette(Qt::darkGreen);
+	else if (fps < 10)
 		ui->fpsLCD->setPalette(Qt::red);
 	else if (fps < 25)
 		ui->fpsLCD->setPalette(Qt::yellow);
@@ -348,15 +471,29 @@ void MainWindow::displayFPS(int fps)
 	ui->fpsLCD->display(fps);
 }
 
+void MainWindow::displayFrameTime(float milliseconds)
+{
+	ui->frameTimeLCD->display(QString::number(milliseconds, 'f', 1));
+}
+
 void MainWindow::displayGraphicsDeviceInfo(QString string)
 {
 	ui->labelGraphicsDeviceInfo->setText(string);
 }
 
+void MainWindow::displayLineVertexFormat(int format)
+{
+	// combo box items are in the order of GLWidget::LineVertexFormat, the format is already set
+	QSignalBlocker blocker(ui->comboBoxVertexFormat);
+	ui->comboBoxVertexFormat->setCurrentIndex(format);
+}
+
 void MainWindow::on_generateTestDataButton_clicked()
 {
 	// the value in the spinBoxTestDataNumVertices should represent the numer of total vertices of the triangle strips
 	// we need half of that for the line vertices test data, since line vertices will be duplicated for triangle strip generation
+	stopLoading();
+	ui->progressBar->setEnabled(false);
 	generateTestData(ui->spinBoxTestDataNumVertices->value()/2, glm::vec3(-1.f,-1.f,-1.f), glm::vec3(1.f,1.f,1.f));
 }
 
@@ -403,14 +540,31 @@ void MainWindow::on_pushButtonRestoreDefaults_clicked()
 void MainWindow::on_checkBoxEnableClipping_clicked(bool checked)
 {
 	glWidget->enableClipping = checked;
+	glWidget->update();
 }
 
 void MainWindow::on_pushButtonSetClipPlaneNormal_clicked()
 {
 	glWidget->updateClipPlaneNormal();
+	glWidget->update();
 }
 
 void MainWindow::on_horizontalSliderClipPlaneDistance_valueChanged(int value)
 {
 	glWidget->clipPlaneDistance = (float)value/50.0f - 1.0f; // map [0,100] to [-1,1]
+	glWidget->update();
+}
+
+void MainWindow::on_comboBoxVertexFormat_currentIndexChanged(int index)
+{
+	// combo box items are in the order of GLWidget::LineVertexFormat
+	glWidget->setLineVertexFormat(static_cast<GLWidget::LineVertexFormat>(index));
+
+	// pulled line vertices are not supported by all contexts
+	ui->comboBoxVertexFormat->setCurrentIndex(glWidget->getLineVertexFormat());
+}
+
+void MainWindow::on_checkBoxAdaptiveQuality_clicked(bool checked)
+{
+	glWidget->adaptiveQuality = checked;
 }
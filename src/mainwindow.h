@@ -7,11 +7,16 @@
 #include <QProgressBar>
 #include <QStatusBar>
 #include <QVariant>
+#include <QThread>
+#include <QPointer>
 
 #include "libtrkfileio/trkfileio.h"
+#include "libtrkfileio/trkzfileio.h"
+#include "trkloader.h"
+#include "trkcompressor.h"
 
 #include "glwidget.h"
-#include "linevertex.h"
+#include "linedata.h"
 
 namespace Ui {
 class MainWindow;
@@ -42,14 +47,34 @@ public slots:
 	void displayTotalGPUMemory(float size);
 	void displayUsedGPUMemory(float size);
 	void displayFPS(int fps);
+	void displayFrameTime(float milliseconds);
 	void displayGraphicsDeviceInfo(QString string);
+	void displayLineVertexFormat(int format);
 
 protected slots:
 
 	//! \brief File dialog to open data files.
     void openFileAction();
+    void cancelLoadingAction();
+	//! \brief convert a .trk file into a compressed .trkz file on a worker thread, see TrkCompressor
+	void exportCompressedAction();
     void closeAction();
 
+	//! \brief slots receiving the results of the background .trk loader
+	void trkFileRangesChanged(TrkFileRanges fileRanges);
+	void trkLoadStarted(qint64 numTracks, qint64 numPoints);
+	void trkChunkLoaded(LineDataChunk chunk);
+	void trkScalarRangeChanged(float scalarMin, float scalarMax);
+	void trkLoadProgressChanged(int percent);
+	void trkLoadFinished(bool success, QString message);
+
+	//! \brief slot receiving the decimation levels of the dataset built in the background
+	void lineLodsBuilt(LineLods lods);
+
+	//! \brief slots receiving the results of the background .trkz compressor
+	void trkCompressProgressChanged(int percent);
+	void trkCompressFinished(bool success, float maxError, QString message);
+
     void renderModeChanged(int index);
 	void on_generateTestDataButton_clicked();
 	void on_spinBoxLineTriangleStripWidth_valueChanged(double value);
@@ -61,40 +86,34 @@ protected slots:
 	void on_checkBoxEnableClipping_clicked(bool checked);
 	void on_pushButtonSetClipPlaneNormal_clicked();
 	void on_horizontalSliderClipPlaneDistance_valueChanged(int value);
+	void on_comboBoxVertexFormat_currentIndexChanged(int index);
+	void on_checkBoxAdaptiveQuality_clicked(bool checked);
 
 	//! \brief generate a random position within an axis-aligned bounding box
 	//! \param boundingBoxMin position defining start of axis aligned bounding box
 	//! \param boundingBoxMax position defining end of axis aligned bounding box
 	glm::vec3 randomPosInBoundingBox(glm::vec3 boundingBoxMin, glm::vec3 boundingBoxMax);
 
-	//! \brief generate vertices along smooth lines within given bounding box
-	//! \param numVertices this is only half the number of vertices generated: two copies of each vertex are stored in sequential manner to be able to render triangle strips later
+	//! \brief generate line positions along a smooth line within given bounding box
+	//! \param numVertices number of line positions, the rendered triangle strip has two vertices for each of them
 	//! \param boundingBoxMin position defining start of axis aligned bounding box
 	//! \param boundingBoxMax position defining end of axis aligned bounding box
-	//!
-	//! each vertex consists of 8 floats: 3 position, 3 direction to next vertex, 2 uv
-	//! NOTE: two copies of all vertices are stored in sequential manner,
-	//! with uv v-coordinate 0 and 1 to use for drawing as triangle strips (two strip vertices for each line vertex)
 	void generateTestData(int numVertices, glm::vec3 boundingBoxMin, glm::vec3 boundingBoxMax);
 
-	//! \brief Load TrackVis Tractography Track Line Data.
-	//! \param filename path to file
-	//! \return true if file was successfully loaded, else false
+	//! \brief Start loading TrackVis Tractography Track Line Data on a worker thread.
+	//! \param filenames paths to files, all files are merged into one dataset
 	//!
-	//! This uses libtrkfileio by lheric from https://github.com/lheric/libtrkfileio.
-	bool loadTRKData(QString &filename);
+	//! Finished chunks of the files are uploaded and rendered while the rest is still loading, see TrkLoader.
+	void startLoadingTRKData(const QStringList &filenames);
 
-	//! \brief generate additional line vertex data (directions and uv) from line positions
-	//! \param linePositions x,y,z coords of line points
-	//!
-	//! take x,y,z line points as input and store line vertices,
-	//! each vertex consists of 8 floats: 3 position, 3 direction to next vertex, 2 uv.
-	//! NOTE: two copies of all vertices are stored in sequential manner,
-	//! with uv v-coordinate 0 and 1 to use for drawing as triangle strips (two strip vertices for each line vertex).
-	//! u-coordinate is same for both and is interpolated along the length of the whole line,
-	//! v-coordinate is set to 0 for vertex on "right" side of the strip and to 1 for vertex on "left" side.
-	//! direction to next vertex: take average of direction to current and direction to next for smoother directions.
-	void generateAdditionalLineVertexData(std::vector<glm::vec3> linePositions);
+	//! \brief cancel a running load (and level of detail build) and wait for the worker threads to finish
+	void stopLoading();
+
+	//! \brief start building decimation levels of datasetLines on a worker thread, see LineLodBuilder
+	void startBuildingLineLods();
+
+	//! \brief cancel a running compression and wait for the worker thread to finish
+	void stopCompressing();
 
 private:
 
@@ -114,7 +133,21 @@ private:
     } fileType;
 
     GLWidget *glWidget;
-	std::vector<std::vector<LineVertex> > datasetLines;
+	LineData datasetLines; //!< positions of all tracks, the GPU line vertices are generated from them
+	TrkFileRanges datasetFileRanges; //!< tracks and line points of each loaded file in datasetLines
+
+	// background loading, both are null when no load is running
+	QPointer<TrkLoader> trkLoader;
+	QPointer<QThread> trkLoaderThread;
+
+	// background level of detail build, both are null when no build is running
+	QPointer<LineLodBuilder> lineLodBuilder;
+	QPointer<QThread> lineLodBuilderThread;
+
+	// background compression, both are null when no compression is running
+	QPointer<TrkCompressor> trkCompressor;
+	QPointer<QThread> trkCompressorThread;
+	QString trkCompressorFilenames[2]; //!< .trk and .trkz file of the running compression
 
 };
 
@@ -0,0 +1,700 @@
+#include "offscreenrenderer.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QRegExp>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+
+#include "cpurasterizer.h"
+#include "linevertex.h"
+#include "tiffwriter.h"
+#include "trkloader.h"
+
+//! uniform buffer binding point of the LineRenderParameters block, see GLWidget
+static const GLuint LINE_RENDER_PARAMETERS_BINDING = 0;
+
+//! \brief file of the image of a pose written by PoseRenderer::renderToFiles()
+static QString getImageFilename(const QString &directory, size_t poseIndex)
+{
+	return QDir(directory).filePath(QString("image_%1.png").arg(poseIndex, 5, 10, QChar('0')));
+}
+
+//! \brief encodes an image as PNG and writes it on a thread pool
+class ImageWriter : public QRunnable
+{
+public:
+	ImageWriter(const QImage &image, const QString &filename, QSemaphore *freeSlots, QAtomicInt *numFailed)
+		: image(image), filename(filename), freeSlots(freeSlots), numFailed(numFailed)
+	{
+	}
+
+	void run()
+	{
+		if (!image.save(filename, "PNG")) {
+			qDebug() << "could not write" << filename;
+			numFailed->ref();
+		}
+		image = QImage();
+		freeSlots->release();
+	}
+
+private:
+	QImage image;
+	QString filename;
+	QSemaphore *freeSlots;
+	QAtomicInt *numFailed;
+};
+
+bool readRenderPoses(const QString &filename, std::vector<RenderPose> &poses)
+{
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+		qDebug() << "could not open camera poses" << filename;
+		return false;
+	}
+
+	QTextStream stream(&file);
+	int lineNumber = 0;
+	while (!stream.atEnd()) {
+		QString line = stream.readLine().trimmed();
+		++lineNumber;
+		if (line.isEmpty() || line.startsWith('#'))
+			continue;
+
+		// defaults of the interactive view for the halo parameters (see GLWidget)
+		RenderPose pose;
+		pose.lineTriangleStripWidth = 0.03f;
+		pose.lineWidthPercentageBlack = 0.3f;
+		pose.lineWidthDepthCueingFactor = 1.0f;
+		pose.lineHaloMaxDepth = 0.02f;
+		float *values[] = { &pose.azimuth, &pose.polar, &pose.fieldOfView, &pose.lineTriangleStripWidth,
+							&pose.lineWidthPercentageBlack, &pose.lineWidthDepthCueingFactor, &pose.lineHaloMaxDepth };
+
+		QStringList fields = line.split(QRegExp("\\s+"));
+		if (fields.size() < 3 || fields.size() > 7) {
+			qDebug() << filename << "line" << lineNumber << ": expected 3 to 7 values";
+			return false;
+		}
+		for (int i = 0; i < fields.size(); ++i) {
+			bool ok = false;
+			*values[i] = fields[i].toFloat(&ok);
+			if (!ok) {
+				qDebug() << filename << "line" << lineNumber << ": not a number" << fields[i];
+				return false;
+			}
+		}
+		poses.push_back(pose);
+	}
+	return true;
+}
+
+LineRenderParameters getRenderPoseParameters(const RenderPose &pose, int width, int height, const QRect &tile)
+{
+	// orbit the dataset like the interactive view does, starting from the reset camera (azimuth 0, polar 90 degrees)
+	Camera camera;
+	camera.setAspect(float(width) / height);
+	camera.setFieldOfView(pose.fieldOfView);
+	camera.buildProjectionMatrix();
+	camera.rotateAzimuth(glm::radians(pose.azimuth));
+	camera.rotatePolar(glm::radians(pose.polar) - float(M_PI) / 2.0f);
+
+	// the tile covers its part of normalized device coordinates [-1,1]^2 after scaling and shifting x and y
+	glm::mat4 tileMat(1.0f);
+	if (!tile.isNull()) {
+		const float scaleX = float(width) / tile.width();
+		const float scaleY = float(height) / tile.height();
+		const float centerX = 2.0f * (tile.x() + 0.5f * tile.width()) / width - 1.0f;
+		const float centerY = 1.0f - 2.0f * (tile.y() + 0.5f * tile.height()) / height;
+		tileMat[0][0] = scaleX;
+		tileMat[1][1] = scaleY;
+		tileMat[3][0] = -scaleX * centerX;
+		tileMat[3][1] = -scaleY * centerY;
+	}
+
+	LineRenderParameters parameters;
+	parameters.viewProjMat = tileMat * camera.getProjectionMatrix() * camera.getViewMatrix();
+	parameters.cameraPos = camera.getPosition();
+	parameters.lineTriangleStripWidth = pose.lineTriangleStripWidth;
+	parameters.clipPlaneNormal = glm::vec3(0);
+	parameters.clipPlaneDistance = 0;
+	parameters.colorLine = glm::vec3(0.0f, 0.0f, 0.0f);
+	parameters.lineWidthPercentageBlack = pose.lineWidthPercentageBlack;
+	parameters.colorHalo = glm::vec3(1.0f, 1.0f, 1.0f);
+	parameters.lineWidthDepthCueingFactor = pose.lineWidthDepthCueingFactor;
+	parameters.scalarRange = glm::vec2(0, 1);
+	parameters.lineHaloMaxDepth = pose.lineHaloMaxDepth;
+	parameters.positionRange = PackedLineVertex::POSITION_RANGE;
+	parameters.nearPlane = camera.getNearPlane();
+	parameters.farPlane = camera.getFarPlane();
+	parameters.orthogonal = camera.isOrthogonal() ? 1 : 0;
+	parameters.colorByScalar = 0;
+	return parameters;
+}
+
+ImageDifference getImageDifference(const QImage &image, const QImage &reference)
+{
+	ImageDifference difference = { 0, 0.0, 0.0 };
+	if (image.size() != reference.size()) {
+		difference.maxDifference = 255;
+		return difference;
+	}
+
+	// both as 8 bit RGB, the OpenGL and CPU renderers return different formats
+	const QImage a = image.convertToFormat(QImage::Format_RGB888);
+	const QImage b = reference.convertToFormat(QImage::Format_RGB888);
+	quint64 sum = 0;
+	quint64 numDifferent = 0;
+	for (int y = 0; y < a.height(); ++y) {
+		const uchar *lineA = a.constScanLine(y);
+		const uchar *lineB = b.constScanLine(y);
+		for (int x = 0; x < a.width(); ++x) {
+			int pixelDifference = 0;
+			for (int c = 0; c < 3; ++c) {
+				const int channelDifference = std::abs(int(lineA[3 * x + c]) - int(lineB[3 * x + c]));
+				pixelDifference = std::max(pixelDifference, channelDifference);
+				sum += channelDifference;
+			}
+			difference.maxDifference = std::max(difference.maxDifference, pixelDifference);
+			numDifferent += pixelDifference > 0 ? 1 : 0;
+		}
+	}
+	const double numPixels = std::max(double(a.width()) * a.height(), 1.0);
+	difference.meanDifference = sum / (3.0 * numPixels);
+	difference.differentPixels = numDifferent / numPixels;
+	return difference;
+}
+
+PoseRenderer::PoseRenderer(int width, int height)
+{
+	this->width = width;
+	this->height = height;
+}
+
+OffscreenRenderer::OffscreenRenderer(int width, int height, int samples, GLWidget::LineVertexFormat lineVertexFormat)
+		: PoseRenderer(width, height)
+{
+	this->samples = samples;
+	this->lineVertexFormat = lineVertexFormat;
+	positionRange = PackedLineVertex::POSITION_RANGE;
+	gl = nullptr;
+	uboLineRenderParameters = 0;
+	tboPositions = 0;
+	tboTrackFlags = 0;
+}
+
+OffscreenRenderer::~OffscreenRenderer()
+{
+	if (!gl)
+		return;
+
+	context.makeCurrent(&surface);
+	vao.destroy();
+	vbo.destroy();
+	vboTrackFlags.destroy();
+	gl->glDeleteTextures(1, &tboPositions);
+	gl->glDeleteTextures(1, &tboTrackFlags);
+	gl->glDeleteBuffers(1, &uboLineRenderParameters);
+	shader.reset();
+	fbo.reset();
+	resolveFbo.reset();
+	context.doneCurrent();
+}
+
+bool OffscreenRenderer::initialize()
+{
+	QSurfaceFormat format;
+	format.setVersion(3, 3);
+	format.setProfile(QSurfaceFormat::CoreProfile);
+	context.setFormat(format);
+	if (!context.create()) {
+		qDebug() << "could not create an OpenGL context, without display run in a virtual X server (xvfb-run -a) or use --cpu";
+		return false;
+	}
+
+	// a pbuffer or hidden window depending on the platform, only needed to make the context current
+	surface.setFormat(context.format());
+	surface.create();
+	if (!context.makeCurrent(&surface)) {
+		qDebug() << "could not make the OpenGL context current";
+		return false;
+	}
+
+	gl = context.versionFunctions<QOpenGLFunctions_3_3_Core>();
+	if (!gl || !gl->initializeOpenGLFunctions()) {
+		gl = nullptr;
+		qDebug() << "OpenGL 3.3 core functions not available";
+		return false;
+	}
+	qDebug() << "Offscreen rendering with" << (const char*)gl->glGetString(GL_RENDERER) << (const char*)gl->glGetString(GL_VERSION);
+
+	// render into a multisampled framebuffer, it is resolved into a single sampled one to read it back
+	QOpenGLFramebufferObjectFormat fboFormat;
+	fboFormat.setAttachment(QOpenGLFramebufferObject::Depth);
+	fboFormat.setSamples(samples);
+	fbo.reset(new QOpenGLFramebufferObject(width, height, fboFormat));
+	resolveFbo.reset(new QOpenGLFramebufferObject(width, height));
+	if (!fbo->isValid() || !resolveFbo->isValid()) {
+		qDebug() << "could not create a" << width << "x" << height << "framebuffer with" << samples << "samples";
+		return false;
+	}
+
+	if (!linkShader())
+		return false;
+
+	gl->glGenBuffers(1, &uboLineRenderParameters);
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, uboLineRenderParameters);
+	gl->glBufferData(GL_UNIFORM_BUFFER, sizeof(LineRenderParameters), nullptr, GL_DYNAMIC_DRAW);
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+	gl->glBindBufferBase(GL_UNIFORM_BUFFER, LINE_RENDER_PARAMETERS_BINDING, uboLineRenderParameters);
+
+	gl->glGenTextures(1, &tboPositions);
+	gl->glGenTextures(1, &tboTrackFlags);
+	vao.create();
+	return true;
+}
+
+bool OffscreenRenderer::linkShader()
+{
+	// the line vertex shaders of GLWidget, their parameters are in the LineRenderParameters uniform block
+	QString vertexShader = "/shaders/shader_lines_with_halos.vert";
+	if (lineVertexFormat == GLWidget::PULLED_POSITIONS)
+		vertexShader = "/shaders/shader_lines_with_halos_pulled.vert";
+	else if (lineVertexFormat == GLWidget::PACKED_VERTICES)
+		vertexShader = "/shaders/shader_lines_with_halos_packed.vert";
+	QString buildDir = QCoreApplication::applicationDirPath();
+	shader.reset(new QOpenGLShaderProgram());
+	shader->addShaderFromSourceFile(QOpenGLShader::Vertex, buildDir + vertexShader);
+	shader->addShaderFromSourceFile(QOpenGLShader::Fragment, buildDir + "/shaders/shader_lines_with_halos.frag");
+	if (!shader->link()) {
+		qDebug() << "could not link line shader:" << shader->log();
+		return false;
+	}
+	GLuint blockIndex = gl->glGetUniformBlockIndex(shader->programId(), "LineRenderParameters");
+	gl->glUniformBlockBinding(shader->programId(), blockIndex, LINE_RENDER_PARAMETERS_BINDING);
+
+	// buffer texture units of GLWidget, there are no scalars in unit 1 since colorByScalar is never set
+	if (lineVertexFormat == GLWidget::PULLED_POSITIONS) {
+		shader->bind();
+		shader->setUniformValue(shader->uniformLocation("linePositions"), 0);
+		shader->setUniformValue(shader->uniformLocation("lineScalars"), 1);
+		shader->setUniformValue(shader->uniformLocation("lineTrackFlags"), 2);
+		shader->release();
+	}
+	return true;
+}
+
+void OffscreenRenderer::setLines(const LineData &lines)
+{
+	context.makeCurrent(&surface);
+	const size_t numPoints = lines.positions.size();
+
+	// texelFetch beyond GL_MAX_TEXTURE_BUFFER_SIZE returns 0, see GLWidget::allocateGPUBufferLineData()
+	if (lineVertexFormat == GLWidget::PULLED_POSITIONS) {
+		GLint maxTexels = 0;
+		gl->glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		if (3 * numPoints > static_cast<size_t>(maxTexels)) {
+			qDebug() << numPoints << "line points exceed the max buffer texture size of" << maxTexels << "texels, using packed line vertices";
+			lineVertexFormat = GLWidget::PACKED_VERTICES;
+			if (!linkShader()) {
+				groups.clear();
+				return;
+			}
+		}
+	}
+	const bool pulled = lineVertexFormat == GLWidget::PULLED_POSITIONS;
+	const bool packedVertices = lineVertexFormat == GLWidget::PACKED_VERTICES;
+
+	// PULLED_POSITIONS draws the line positions as they are, otherwise two LineVertex per line point,
+	// see GLWidget::LineVertexFormat::FLOAT_VERTICES, quantized into PackedLineVertex for GLWidget::LineVertexFormat::PACKED_VERTICES
+	std::vector<LineVertex> vertices;
+	std::vector<PackedLineVertex> packed;
+	const void *data = lines.positions.data();
+	size_t size = numPoints * sizeof(glm::vec3);
+	if (!pulled) {
+		vertices.resize(2 * numPoints);
+		if (numPoints > 0)
+			generateTrackLineVerticesParallel(lines.positions.data(), lines.trackOffsets.data(), lines.getNumTracks(), vertices.data());
+		data = vertices.data();
+		size = vertices.size() * sizeof(LineVertex);
+	}
+	if (packedVertices) {
+		positionRange = getPackedPositionRange(lines);
+		packed.resize(vertices.size());
+		packLineVertices(vertices.data(), vertices.size(), positionRange, packed.data());
+		std::vector<LineVertex>().swap(vertices);
+		data = packed.data();
+		size = packed.size() * sizeof(PackedLineVertex);
+	}
+
+	QOpenGLVertexArrayObject::Binder vaoBinder(&vao);
+	vbo.destroy();
+	vbo.create();
+	vbo.bind();
+	// not QOpenGLBuffer::allocate(), its int size wraps for datasets above 2 GiB of vertices
+	if (size > static_cast<size_t>(std::numeric_limits<GLsizeiptr>::max()))
+		qDebug() << "vertex buffer of" << size << "bytes is too large for this platform";
+	else
+		gl->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(size), size > 0 ? data : nullptr, GL_STATIC_DRAW);
+
+	// the same attributes as GLWidget::setLineVertexAttributes(), PULLED_POSITIONS has none
+	shader->bind();
+	if (pulled) {
+		for (int i = 0; i < 4; ++i)
+			shader->disableAttributeArray(i);
+	}
+	else if (packedVertices) {
+		shader->enableAttributeArray(0); // "packedPosition"
+		shader->setAttributeBuffer(0, GL_SHORT, 0, 3, sizeof(PackedLineVertex));
+		shader->enableAttributeArray(1); // "packedDirection"
+		shader->setAttributeBuffer(1, GL_SHORT, 4*sizeof(GLshort), 2, sizeof(PackedLineVertex));
+		shader->enableAttributeArray(2); // "packedUFlags"
+		shader->setAttributeBuffer(2, GL_UNSIGNED_SHORT, 3*sizeof(GLshort), 1, sizeof(PackedLineVertex));
+	}
+	else {
+		shader->enableAttributeArray(0); // "position"
+		shader->setAttributeBuffer(0, GL_FLOAT, 0*sizeof(GLfloat), 3, sizeof(LineVertex));
+		shader->enableAttributeArray(1); // "direction"
+		shader->setAttributeBuffer(1, GL_FLOAT, 3*sizeof(GLfloat), 3, sizeof(LineVertex));
+		shader->enableAttributeArray(2); // "uv"
+		shader->setAttributeBuffer(2, GL_FLOAT, 6*sizeof(GLfloat), 2, sizeof(LineVertex));
+	}
+	shader->disableAttributeArray(3); // no scalars
+	shader->release();
+	vbo.release();
+
+	if (pulled) {
+		gl->glBindTexture(GL_TEXTURE_BUFFER, tboPositions);
+		gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_R32F, vbo.bufferId());
+
+		// flag first and last point of each track like GLWidget::appendLineData(), a single point track has both flags
+		std::vector<uint8_t> trackFlags(numPoints, 0);
+		for (size_t i = 0; i < lines.getNumTracks(); ++i) {
+			if (lines.trackOffsets[i + 1] > lines.trackOffsets[i]) {
+				trackFlags[lines.trackOffsets[i]] |= 1;
+				trackFlags[lines.trackOffsets[i + 1] - 1] |= 2;
+			}
+		}
+		vboTrackFlags.destroy();
+		vboTrackFlags.create();
+		vboTrackFlags.bind();
+		gl->glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(numPoints), numPoints > 0 ? trackFlags.data() : nullptr, GL_STATIC_DRAW);
+		vboTrackFlags.release();
+
+		gl->glBindTexture(GL_TEXTURE_BUFFER, tboTrackFlags);
+		gl->glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, vboTrackFlags.bufferId());
+		gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+
+	// each track is its own triangle strip, grouped by position for culling.
+	// the strip vertices of line point i are 2*i and 2*i+1 in all formats, gl_VertexID of PULLED_POSITIONS
+	groups.clear();
+	appendLineGroups(lines, 0, groups);
+}
+
+QImage OffscreenRenderer::renderFrame(const LineRenderParameters &parameters)
+{
+	context.makeCurrent(&surface);
+
+	LineRenderParameters frameParameters = parameters;
+	frameParameters.positionRange = positionRange;
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, uboLineRenderParameters);
+	gl->glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(frameParameters), &frameParameters);
+	gl->glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+	fbo->bind();
+	gl->glViewport(0, 0, width, height);
+	gl->glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
+	gl->glEnable(GL_DEPTH_TEST);
+	gl->glEnable(GL_MULTISAMPLE);
+	gl->glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	// the view aligned strips extend half their width beyond the line points
+	glm::vec4 frustumPlanes[6];
+	getFrustumPlanes(parameters.viewProjMat, frustumPlanes);
+	QOpenGLVertexArrayObject::Binder vaoBinder(&vao);
+	shader->bind();
+	const bool pulled = lineVertexFormat == GLWidget::PULLED_POSITIONS;
+	if (pulled) {
+		gl->glActiveTexture(GL_TEXTURE0);
+		gl->glBindTexture(GL_TEXTURE_BUFFER, tboPositions);
+		gl->glActiveTexture(GL_TEXTURE2);
+		gl->glBindTexture(GL_TEXTURE_BUFFER, tboTrackFlags);
+	}
+	for (const LineGroup &group : groups) {
+		if (!group.trackFirstVertices.empty() && isBoxInFrustum(group.boundsMin - 0.5f * parameters.lineTriangleStripWidth,
+																group.boundsMax + 0.5f * parameters.lineTriangleStripWidth, frustumPlanes))
+			gl->glMultiDrawArrays(GL_TRIANGLE_STRIP, &group.trackFirstVertices[0], &group.trackNumVertices[0], static_cast<GLsizei>(group.trackFirstVertices.size()));
+	}
+	if (pulled) {
+		gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+		gl->glActiveTexture(GL_TEXTURE0);
+		gl->glBindTexture(GL_TEXTURE_BUFFER, 0);
+	}
+	shader->release();
+	fbo->release();
+
+	QOpenGLFramebufferObject::blitFramebuffer(resolveFbo.data(), fbo.data());
+	return resolveFbo->toImage();
+}
+
+QImage PoseRenderer::render(const RenderPose &pose)
+{
+	return renderFrame(getRenderPoseParameters(pose, width, height));
+}
+
+double PoseRenderer::benchmark(const std::vector<RenderPose> &poses)
+{
+	QElapsedTimer timer;
+	timer.start();
+	for (size_t i = 0; i < poses.size(); ++i)
+		render(poses[i]);
+	return poses.size() / (std::max(timer.nsecsElapsed(), qint64(1)) / 1e9);
+}
+
+int PoseRenderer::renderToFiles(const std::vector<RenderPose> &poses, const QString &outputDirectory)
+{
+	// encode and write images while the next ones are rendered,
+	// at most two images per writer thread wait in memory so rendering cannot run far ahead
+	QThreadPool writerPool;
+	QSemaphore freeSlots(2 * std::max(writerPool.maxThreadCount(), 1));
+	QAtomicInt numFailed;
+
+	QElapsedTimer timer;
+	timer.start();
+	for (size_t i = 0; i < poses.size(); ++i) {
+		QImage image = render(poses[i]);
+		QString filename = getImageFilename(outputDirectory, i);
+		freeSlots.acquire();
+		writerPool.start(new ImageWriter(image, filename, &freeSlots, &numFailed));
+	}
+	writerPool.waitForDone();
+
+	const int numWritten = static_cast<int>(poses.size()) - numFailed.load();
+	const float seconds = std::max(timer.elapsed(), qint64(1)) / 1000.0f;
+	qDebug() << "Rendered" << numWritten << "images of" << width << "x" << height << "in" << seconds << "s:" << numWritten / seconds << "images per second";
+	return numWritten;
+}
+
+bool PoseRenderer::renderPoster(const RenderPose &pose, int posterWidth, int posterHeight, const QString &filename)
+{
+	TiffWriter writer;
+	if (!writer.open(filename, posterWidth, posterHeight))
+		return false;
+
+	QElapsedTimer timer;
+	timer.start();
+	const int numTilesX = (posterWidth + width - 1) / width;
+	const int numTilesY = (posterHeight + height - 1) / height;
+	QImage band(posterWidth, height, QImage::Format_RGB888);
+	for (int tileY = 0; tileY < numTilesY; ++tileY) {
+		for (int tileX = 0; tileX < numTilesX; ++tileX) {
+			// tiles at the right and bottom border extend beyond the poster, only their inside part is kept
+			QRect tile(tileX * width, tileY * height, width, height);
+			QImage image = renderFrame(getRenderPoseParameters(pose, posterWidth, posterHeight, tile)).convertToFormat(QImage::Format_RGB888);
+			const int copyWidth = std::min(width, posterWidth - tile.x());
+			for (int y = 0; y < height; ++y)
+				memcpy(band.scanLine(y) + 3 * tile.x(), image.constScanLine(y), 3 * copyWidth);
+		}
+		if (!writer.appendRows(band, std::min(height, posterHeight - tileY * height)))
+			return false;
+	}
+	if (!writer.close())
+		return false;
+
+	qDebug() << "Rendered" << posterWidth << "x" << posterHeight << "poster" << filename << "in" << numTilesX * numTilesY << "tiles in" << timer.elapsed() / 1000.0f << "s";
+	return true;
+}
+
+//! \brief render all poses and log the difference to the reference image of each pose
+//! \param getReference reference image of a pose index, a null image if there is none
+template<typename GetReference>
+static bool compareImages(PoseRenderer &renderer, const std::vector<RenderPose> &poses, double tolerance, GetReference getReference)
+{
+	bool success = true;
+	int maxDifference = 0;
+	double meanDifference = 0.0;
+	for (size_t i = 0; i < poses.size(); ++i) {
+		const QImage reference = getReference(i);
+		if (reference.isNull()) {
+			success = false;
+			continue;
+		}
+		const ImageDifference difference = getImageDifference(renderer.render(poses[i]), reference);
+		qDebug() << "pose" << i << ": max difference" << difference.maxDifference << "mean difference" << difference.meanDifference
+				 << "different pixels" << 100.0 * difference.differentPixels << "%";
+		maxDifference = std::max(maxDifference, difference.maxDifference);
+		meanDifference += difference.meanDifference / poses.size();
+		if (difference.meanDifference > tolerance)
+			success = false;
+	}
+	qDebug() << "Compared" << poses.size() << "images: max difference" << maxDifference << "mean difference" << meanDifference
+			 << (success ? "within" : "above") << "the tolerance of" << tolerance;
+	return success;
+}
+
+bool compareRenderers(PoseRenderer &renderer, PoseRenderer &reference, const std::vector<RenderPose> &poses, double tolerance)
+{
+	return compareImages(renderer, poses, tolerance, [&](size_t i) { return reference.render(poses[i]); });
+}
+
+bool compareToReferenceImages(PoseRenderer &renderer, const std::vector<RenderPose> &poses, const QString &referenceDirectory, double tolerance)
+{
+	return compareImages(renderer, poses, tolerance, [&](size_t i) {
+		const QString filename = getImageFilename(referenceDirectory, i);
+		QImage image(filename);
+		if (image.isNull())
+			qDebug() << "could not read reference image" << filename;
+		return image;
+	});
+}
+
+//! \brief parse an image size like 1920x1080
+static bool parseSize(const QString &text, int &width, int &height)
+{
+	QStringList size = text.split('x');
+	width = size.size() == 2 ? size[0].toInt() : 0;
+	height = size.size() == 2 ? size[1].toInt() : 0;
+	return width > 0 && height > 0;
+}
+
+int runBatchRendering(const QStringList &arguments)
+{
+	QCommandLineParser parser;
+	parser.setApplicationDescription("Render images of .trk datasets for a list of camera poses without a window.");
+	parser.addHelpOption();
+	QCommandLineOption batchOption("batch", "Text file with one camera pose per line: azimuth polar fieldOfView in degrees, "
+										   "optionally followed by stripWidth percentageBlack depthCueingFactor haloMaxDepth.", "poses");
+	QCommandLineOption outputOption("output", "Directory the PNG images are written to.", "directory", ".");
+	QCommandLineOption sizeOption("size", "Image size, the tile size of posters.", "WIDTHxHEIGHT", "1920x1080");
+	QCommandLineOption posterOption("poster", "Render each pose as a TIFF poster of this size in tiles of --size, e.g. 32768x32768 for print.", "WIDTHxHEIGHT");
+	QCommandLineOption samplesOption("samples", "MSAA samples per pixel.", "samples", "8");
+	QCommandLineOption cpuOption("cpu", "Render on the CPU cores instead of OpenGL.");
+	QCommandLineOption compareOption("compare", "Write no images, render each pose also with float line vertices in OpenGL and log the difference. "
+												"'packed' compares packed line vertices in OpenGL, 'pulled' line positions fetched from buffer textures "
+												"like the interactive view, 'cpu' the CPU rasterizer "
+												"(its supersampling differs from MSAA at line edges).", "renderer");
+	QCommandLineOption benchmarkOption("benchmark", "Write no images, log the images per second. With --cpu for 1, 2, 4, ... threads up to the number of cores.");
+	QCommandLineOption referenceOption("reference", "Write no images, compare each pose with its image in this directory, e.g. written before "
+													"by the OpenGL renderer, and log the difference.", "directory");
+	QCommandLineOption toleranceOption("tolerance", "Largest mean difference of an image in 8 bit levels allowed by --compare and --reference.", "levels", "0.5");
+	parser.addOption(batchOption);
+	parser.addOption(outputOption);
+	parser.addOption(sizeOption);
+	parser.addOption(samplesOption);
+	parser.addOption(cpuOption);
+	parser.addOption(posterOption);
+	parser.addOption(compareOption);
+	parser.addOption(referenceOption);
+	parser.addOption(toleranceOption);
+	parser.addOption(benchmarkOption);
+	parser.addPositionalArgument("files", "Datasets (.trk or .trkz), loaded into a single dataset.", "files...");
+	parser.process(arguments);
+
+	int width, height;
+	int posterWidth = 0, posterHeight = 0;
+	if (!parseSize(parser.value(sizeOption), width, height) || parser.positionalArguments().isEmpty()
+			|| (parser.isSet(posterOption) && !parseSize(parser.value(posterOption), posterWidth, posterHeight))) {
+		qDebug() << "batch rendering needs image sizes like 1920x1080 and at least one dataset";
+		return 1;
+	}
+
+	std::vector<RenderPose> poses;
+	if (!readRenderPoses(parser.value(batchOption), poses))
+		return 1;
+	if (!QDir().mkpath(parser.value(outputOption))) {
+		qDebug() << "could not create output directory" << parser.value(outputOption);
+		return 1;
+	}
+
+	// load on this thread, the chunks are collected as they are emitted
+	LineData lines;
+	bool loaded = false;
+	TrkLoader loader(parser.positionalArguments());
+	QObject::connect(&loader, &TrkLoader::chunkLoaded, [&lines](LineDataChunk chunk) { lines.append(*chunk); });
+	QObject::connect(&loader, &TrkLoader::finished, [&loaded](bool success, QString message) {
+		loaded = success;
+		if (!success)
+			qDebug() << "loading failed:" << message;
+	});
+	loader.load();
+	if (!loaded)
+		return 1;
+
+	const int samples = parser.value(samplesOption).toInt();
+	QScopedPointer<PoseRenderer> renderer;
+	if (parser.value(compareOption) == "packed")
+		renderer.reset(new OffscreenRenderer(width, height, samples, GLWidget::PACKED_VERTICES));
+	else if (parser.value(compareOption) == "pulled")
+		renderer.reset(new OffscreenRenderer(width, height, samples, GLWidget::PULLED_POSITIONS));
+	else if (parser.value(compareOption) == "cpu")
+		renderer.reset(new CpuRasterizer(width, height, samples));
+	else if (parser.isSet(compareOption)) {
+		qDebug() << "unknown renderer to compare" << parser.value(compareOption);
+		return 1;
+	}
+	else if (parser.isSet(cpuOption))
+		renderer.reset(new CpuRasterizer(width, height, samples));
+	else
+		renderer.reset(new OffscreenRenderer(width, height, samples));
+	if (!renderer->initialize())
+		return 1;
+	renderer->setLines(lines);
+
+	if (parser.isSet(compareOption)) {
+		OffscreenRenderer reference(width, height, samples);
+		if (!reference.initialize())
+			return 1;
+		reference.setLines(lines);
+		return compareRenderers(*renderer, reference, poses, parser.value(toleranceOption).toDouble()) ? 0 : 1;
+	}
+	if (parser.isSet(referenceOption))
+		return compareToReferenceImages(*renderer, poses, parser.value(referenceOption), parser.value(toleranceOption).toDouble()) ? 0 : 1;
+	std::vector<glm::vec3>().swap(lines.positions); // the renderer has its own line vertices now
+
+	if (parser.isSet(benchmarkOption)) {
+		if (poses.empty())
+			return 0;
+		renderer->render(poses.front()); // warm up caches and the driver
+		CpuRasterizer *cpuRenderer = dynamic_cast<CpuRasterizer*>(renderer.data());
+		if (!cpuRenderer) {
+			qDebug() << renderer->benchmark(poses) << "images per second of" << width << "x" << height;
+			return 0;
+		}
+		const int numCores = std::max(QThread::idealThreadCount(), 1);
+		std::vector<int> threadCounts;
+		for (int numThreads = 1; numThreads < numCores; numThreads *= 2)
+			threadCounts.push_back(numThreads);
+		threadCounts.push_back(numCores);
+		for (int numThreads : threadCounts) {
+			cpuRenderer->setMaxThreadCount(numThreads);
+			qDebug() << numThreads << "threads:" << cpuRenderer->benchmark(poses) << "images per second of" << width << "x" << height;
+		}
+		return 0;
+	}
+
+	if (posterWidth > 0) {
+		int numWritten = 0;
+		for (size_t i = 0; i < poses.size(); ++i) {
+			QString filename = QDir(parser.value(outputOption)).filePath(QString("poster_%1.tif").arg(i, 5, 10, QChar('0')));
+			if (renderer->renderPoster(poses[i], posterWidth, posterHeight, filename))
+				++numWritten;
+		}
+		return numWritten == static_cast<int>(poses.size()) ? 0 : 1;
+	}
+	return renderer->renderToFiles(poses, parser.value(outputOption)) == static_cast<int>(poses.size()) ? 0 : 1;
+}
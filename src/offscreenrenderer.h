@@ -0,0 +1,175 @@
+#ifndef OFFSCREENRENDERER_H
+#define OFFSCREENRENDERER_H
+
+#include <QString>
+#include <QStringList>
+#include <QImage>
+#include <QRect>
+#include <QScopedPointer>
+#include <QOpenGLContext>
+#include <QOffscreenSurface>
+#include <QOpenGLFunctions_3_3_Core>
+#include <QOpenGLFramebufferObject>
+#include <QOpenGLShaderProgram>
+#include <QOpenGLVertexArrayObject>
+#include <QOpenGLBuffer>
+
+#include <vector>
+
+#include "camera.h"
+#include "glwidget.h"
+#include "linedata.h"
+#include "linevertex.h"
+
+//! \brief The RenderPose struct. Camera and halo parameters of one image rendered by OffscreenRenderer
+struct RenderPose
+{
+	float azimuth; //!< camera rotation around the up axis in degrees
+	float polar; //!< camera angle from the up axis in degrees, 90 looks at the dataset from the side
+	float fieldOfView; //!< vertical field of view in degrees
+	float lineTriangleStripWidth; //!< total width of triangle strip (black line + white halo)
+	float lineWidthPercentageBlack; //!< percentage of triangle strip drawn black to represent line (rest is white halo)
+	float lineWidthDepthCueingFactor; //!< how much the black line is drawn thinner with increasing depth
+	float lineHaloMaxDepth; //!< maximum depth displacement for white halo fragments
+};
+
+//! \brief read camera poses from a text file
+//! \param filename one pose per line: azimuth polar fieldOfView [stripWidth percentageBlack depthCueingFactor haloMaxDepth],
+//! angles in degrees, missing halo parameters keep the defaults of the interactive view. empty lines and lines starting with # are skipped.
+//! \param poses the poses are appended to it
+//! \return false if the file could not be read or a line could not be parsed
+bool readRenderPoses(const QString &filename, std::vector<RenderPose> &poses);
+
+//! \brief line shader parameters of a pose, seen by the reset camera orbited like in the interactive view
+//! \param width width of the whole image in pixels
+//! \param height height of the whole image in pixels
+//! \param tile pixels of the image that are rendered (y pointing down), null for the whole image.
+//! the projection is narrowed to the sub-frustum of the tile by scaling and shifting x and y of clip space only,
+//! so line widths, depth and halo depth displacement are the same in all tiles and the tiles of an image fit together seamlessly.
+LineRenderParameters getRenderPoseParameters(const RenderPose &pose, int width, int height, const QRect &tile = QRect());
+
+//! \brief The ImageDifference struct. Per channel difference of two images of the same size in 8 bit levels
+struct ImageDifference
+{
+	int maxDifference; //!< largest difference of a color channel
+	double meanDifference; //!< mean difference of all color channels of all pixels
+	double differentPixels; //!< fraction of pixels with any difference
+};
+
+//! \brief compare the red, green and blue channels of two images, e.g. of two renderers
+//! \return maxDifference is 255 if the images differ in size
+ImageDifference getImageDifference(const QImage &image, const QImage &reference);
+
+//! \brief The PoseRenderer class. Interface of the batch mode renderers, images of a list of poses are
+//! rendered one after the other while a thread pool encodes and writes the previous ones as PNG files.
+class PoseRenderer
+{
+public:
+	PoseRenderer(int width, int height);
+	virtual ~PoseRenderer() {}
+
+	//! \brief prepare rendering, e.g. create the OpenGL context
+	//! \return false if the renderer cannot be used
+	virtual bool initialize() { return true; }
+
+	//! \brief set the tracks to draw, replaces the previous ones
+	virtual void setLines(const LineData &lines) = 0;
+
+	//! \brief render one image with the given line shader parameters, culling line groups outside of the view frustum
+	virtual QImage renderFrame(const LineRenderParameters &parameters) = 0;
+
+	//! \brief render one image
+	QImage render(const RenderPose &pose);
+
+	//! \brief render all poses without writing them
+	//! \return images per second
+	double benchmark(const std::vector<RenderPose> &poses);
+
+	//! \brief render all poses and write them as outputDirectory/image_00000.png etc.
+	//! \return number of images written
+	int renderToFiles(const std::vector<RenderPose> &poses, const QString &outputDirectory);
+
+	//! \brief render an image of any size in tiles of the renderer size and write it as a TIFF file
+	//! \param posterWidth width of the whole image, may be far larger than the framebuffer size limits
+	//! \param posterHeight height of the whole image
+	//! \return false if the file could not be written
+	//!
+	//! a row of tiles is rendered into a band that is written to the file when it is complete,
+	//! so only one band of the image is in memory. each tile draws only the line groups inside of its sub-frustum.
+	bool renderPoster(const RenderPose &pose, int posterWidth, int posterHeight, const QString &filename);
+
+protected:
+
+	int width;
+	int height;
+
+};
+
+//! \brief The OffscreenRenderer class.
+//!
+//! Renders lines with depth-dependent halos into an offscreen framebuffer without any window,
+//! with the same shaders and Camera as GLWidget (any of its line vertex formats, no decimation, culled by line groups).
+//! Works with any OpenGL 3.3 core context, e.g. Mesa llvmpipe. The offscreen platform creates the context with GLX,
+//! so servers without display need a virtual X server like Xvfb (see main.cpp).
+class OffscreenRenderer : public PoseRenderer
+{
+public:
+	//! \param samples MSAA samples of the framebuffer, 0 disables multisampling
+	//! \param lineVertexFormat how the lines are stored on the GPU, see GLWidget::LineVertexFormat
+	OffscreenRenderer(int width, int height, int samples, GLWidget::LineVertexFormat lineVertexFormat = GLWidget::FLOAT_VERTICES);
+	~OffscreenRenderer();
+
+	//! \brief create the OpenGL context, framebuffers and shaders
+	//! \return false if no OpenGL 3.3 core context is available
+	bool initialize();
+
+	//! \brief upload the tracks to draw, replaces the previous ones
+	//!
+	//! like GLWidget, PULLED_POSITIONS falls back to PACKED_VERTICES if the points exceed the max buffer texture size.
+	void setLines(const LineData &lines);
+
+	QImage renderFrame(const LineRenderParameters &parameters);
+
+private:
+
+	//! \brief link the line shader of lineVertexFormat and bind its uniform block and buffer textures
+	bool linkShader();
+
+	int samples;
+	GLWidget::LineVertexFormat lineVertexFormat;
+	float positionRange; // of the packed vertices, replaces LineRenderParameters::positionRange
+
+	QOpenGLContext context;
+	QOffscreenSurface surface;
+	QOpenGLFunctions_3_3_Core *gl;
+	QScopedPointer<QOpenGLFramebufferObject> fbo; // multisampled render target
+	QScopedPointer<QOpenGLFramebufferObject> resolveFbo; // single sampled copy of fbo that is read back
+	QScopedPointer<QOpenGLShaderProgram> shader;
+	QOpenGLVertexArrayObject vao;
+	QOpenGLBuffer vbo; // line vertices, or the line positions of PULLED_POSITIONS
+	QOpenGLBuffer vboTrackFlags; // first and last point flags of PULLED_POSITIONS
+	GLuint tboPositions; // R32F buffer texture over vbo
+	GLuint tboTrackFlags; // R8UI buffer texture over vboTrackFlags
+	GLuint uboLineRenderParameters;
+
+	std::vector<LineGroup> groups; // tracks grouped by position, culled per frame
+
+};
+
+//! \brief render all poses with two renderers and log the difference of their images
+//! \param tolerance largest allowed mean difference of an image in 8 bit levels
+//! \return false if the mean difference of any image exceeds the tolerance
+bool compareRenderers(PoseRenderer &renderer, PoseRenderer &reference, const std::vector<RenderPose> &poses, double tolerance);
+
+//! \brief render all poses and log the difference to images written before, e.g. by the OpenGL renderer
+//! \param referenceDirectory contains the images of the poses named like those of PoseRenderer::renderToFiles()
+//! \param tolerance largest allowed mean difference of an image in 8 bit levels
+//! \return false if a reference image is missing or the mean difference of any image exceeds the tolerance
+bool compareToReferenceImages(PoseRenderer &renderer, const std::vector<RenderPose> &poses, const QString &referenceDirectory, double tolerance);
+
+//! \brief command line batch mode: load datasets and render images of camera poses without a window
+//! \param arguments command line arguments, see main.cpp
+//! \return process exit code
+int runBatchRendering(const QStringList &arguments);
+
+#endif // OFFSCREENRENDERER_H
@@ -3,27 +3,44 @@
 in vec3 vertDirection; // direction to next line vertex
 in vec2 vertUV; // u is in [0,1] interpolated along line length, v is in [0,1] interpolated perpendicular to direction between sides of triangle strip
 in float discardFragment;
+in float vertScalar;
 
 // final intensities passed to framebuffer
 layout(location = 0) out vec4 outColor;
 
-// uniforms are not interpolated or passed on
-uniform vec3 colorLine;
-uniform vec3 colorHalo;
-uniform float lineTriangleStripWidth;
-uniform float lineWidthPercentageBlack; // percentage of triangle strip drawn black to represent line (rest is white halo)
-uniform float lineWidthDepthCueingFactor; // how much the black line is drawn thinner with increasing depth
-uniform float lineHaloMaxDepth; // maximum depth displacement for white halo fragments
-uniform mat4 inverseProjMat;
+// per frame parameters shared by all line shaders, see GLWidget::LineRenderParameters (std140 layout)
+layout(std140) uniform LineRenderParameters
+{
+    mat4 viewProjMat;
+    vec3 cameraPos;
+    float lineTriangleStripWidth;
+    vec3 clipPlaneNormal;
+    float clipPlaneDistance;
+    vec3 colorLine;
+    float lineWidthPercentageBlack; // percentage of triangle strip drawn black to represent line (rest is white halo)
+    vec3 colorHalo;
+    float lineWidthDepthCueingFactor; // how much the black line is drawn thinner with increasing depth
+    vec2 scalarRange; // scalar range mapped to the color ramp
+    float lineHaloMaxDepth; // maximum depth displacement for white halo fragments
+    float positionRange; // PACKED_VERTICES positions are divided by it
+    float nearPlane;
+    float farPlane;
+    bool orthogonal;
+    bool colorByScalar; // color the line by vertScalar instead of colorLine
+};
 
 float getLinearizedFragmentDepth()
 {
     // get linear depth at fragment
     // gl_FragCoord.z is nonlinear due to perspective projection, we must linearize it
-    vec3 NDC = gl_FragCoord.xyz * 2.0 - 1.0; // map fragment coordinates [0,1] to normalized device coordinates [-1,1]
-    vec4 unprojectedNDC = inverseProjMat * vec4(NDC, 1.0); // undo the perspective projection by applying inverse projMat
-    unprojectedNDC /= unprojectedNDC.w;
-    float depth = -(unprojectedNDC.z / 2.0 + 0.5);
+    // the view space z of the fragment follows in closed form from the near and far plane of the projection
+    float zNDC = gl_FragCoord.z * 2.0 - 1.0; // map fragment depth [0,1] to normalized device coordinates [-1,1]
+    float viewZ;
+    if (orthogonal)
+        viewZ = -0.5 * (zNDC * (farPlane - nearPlane) + farPlane + nearPlane);
+    else
+        viewZ = -2.0 * farPlane * nearPlane / (farPlane + nearPlane - zNDC * (farPlane - nearPlane));
+    float depth = -(viewZ / 2.0 + 0.5);
 
     return depth; // depth in [0,1] where 0 is near plane, 1 is flar plane
 }
@@ -53,6 +70,11 @@ void main()
 
     if (offset < offsetThreshold) {
         outColor = vec4(colorLine,1); // assign black (to represent line)
+        if (colorByScalar) {
+            // blue to red ramp over the scalar range
+            float t = clamp((vertScalar - scalarRange.x) / max(scalarRange.y - scalarRange.x, 1e-6), 0.0, 1.0);
+            outColor = vec4(mix(vec3(0.0, 0.2, 0.8), vec3(0.9, 0.1, 0.0), t), 1);
+        }
         gl_FragDepth = depth; // depth unchanged, but we must assign gl_FragDepth for all cases if we assign it somewhere
     }
     else {
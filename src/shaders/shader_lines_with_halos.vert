@@ -7,19 +7,34 @@
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 direction; // direction to next line vertex
 layout(location = 2) in vec2 uv; // u is between 0 and 1 based on position in line direction, v is discrete EITHER 0 OR 1 later used to move perpendicular to direction between sides of triangle strip
+layout(location = 3) in float scalar; // optional per vertex scalar (e.g. FA), 0 if not available
 
 // out attributes passed to fragment shader
 out vec3 vertDirection;
 out vec2 vertUV;
 out float discardFragment;
+out float vertScalar;
 
-// uniforms are not interpolated or passed on
-uniform mat4 viewMat;
-uniform mat4 projMat;
-uniform vec3 cameraPos;
-uniform float lineTriangleStripWidth;
-uniform vec3 clipPlaneNormal;
-uniform float clipPlaneDistance;
+// per frame parameters shared by all line shaders, see GLWidget::LineRenderParameters (std140 layout)
+layout(std140) uniform LineRenderParameters
+{
+    mat4 viewProjMat;
+    vec3 cameraPos;
+    float lineTriangleStripWidth;
+    vec3 clipPlaneNormal;
+    float clipPlaneDistance;
+    vec3 colorLine;
+    float lineWidthPercentageBlack; // percentage of triangle strip drawn black to represent line (rest is white halo)
+    vec3 colorHalo;
+    float lineWidthDepthCueingFactor; // how much the black line is drawn thinner with increasing depth
+    vec2 scalarRange; // scalar range mapped to the color ramp
+    float lineHaloMaxDepth; // maximum depth displacement for white halo fragments
+    float positionRange; // PACKED_VERTICES positions are divided by it
+    float nearPlane;
+    float farPlane;
+    bool orthogonal;
+    bool colorByScalar; // color the line by vertScalar instead of colorLine
+};
 
 void main()
 {   
@@ -35,12 +50,8 @@ void main()
     if (dot(viewAlignedPosition, clipPlaneNormal) > clipPlaneDistance)
         discardFragment = 1;
 
-    // dirty hack: we use this to discard fragments connecting end and start vertices of two lines
-    // this allows us to just use one vbo for all the triangle strip vertices which is much faster.
-    if (position.z == 42.4242)
-        discardFragment = 1;
-
-    gl_Position = projMat * viewMat * vec4(viewAlignedPosition, 1.0);
+    gl_Position = viewProjMat * vec4(viewAlignedPosition, 1.0);
     vertDirection = direction;
     vertUV = uv;
+    vertScalar = scalar;
 }
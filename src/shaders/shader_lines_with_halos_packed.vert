@@ -0,0 +1,70 @@
+#version 330 core
+
+// in attributes from bound vertex array buffers, packed version of shader_lines_with_halos.vert (see PackedLineVertex)
+// all attributes are normalized integers the vertex fetch converts to floats in [-1,1] (snorm16) or [0,1] (unorm16)
+// note: to draw line as triangle strip we need all line vertices twice: with same position, direction and u, but different v
+layout(location = 0) in vec3 packedPosition; // position divided by positionRange
+layout(location = 1) in vec2 packedDirection; // octahedral encoded direction to next line vertex
+layout(location = 2) in float packedUFlags; // u in the upper 14 bits, bit 0 is v, bit 1 is unused
+layout(location = 3) in float scalar; // optional per vertex scalar (e.g. FA), 0 if not available
+
+// out attributes passed to fragment shader
+out vec3 vertDirection;
+out vec2 vertUV;
+out float discardFragment;
+out float vertScalar;
+
+// per frame parameters shared by all line shaders, see GLWidget::LineRenderParameters (std140 layout)
+layout(std140) uniform LineRenderParameters
+{
+    mat4 viewProjMat;
+    vec3 cameraPos;
+    float lineTriangleStripWidth;
+    vec3 clipPlaneNormal;
+    float clipPlaneDistance;
+    vec3 colorLine;
+    float lineWidthPercentageBlack; // percentage of triangle strip drawn black to represent line (rest is white halo)
+    vec3 colorHalo;
+    float lineWidthDepthCueingFactor; // how much the black line is drawn thinner with increasing depth
+    vec2 scalarRange; // scalar range mapped to the color ramp
+    float lineHaloMaxDepth; // maximum depth displacement for white halo fragments
+    float positionRange; // PACKED_VERTICES positions are divided by it
+    float nearPlane;
+    float farPlane;
+    bool orthogonal;
+    bool colorByScalar; // color the line by vertScalar instead of colorLine
+};
+
+// unfold the lower half of the octahedron and project back onto the unit sphere
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0)
+        n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0 ? 1.0 : -1.0, n.y >= 0 ? 1.0 : -1.0);
+    return normalize(n);
+}
+
+void main()
+{
+    vec3 position = packedPosition * positionRange;
+    vec3 direction = decodeOctahedral(packedDirection);
+    uint uFlags = uint(packedUFlags * 65535.0 + 0.5);
+    vec2 uv = vec2(float(uFlags >> 2u) / 16383.0, float(uFlags & 1u));
+
+    // VIEW ALIGNED TRIANGLE STRIPS
+    // widen zero-width triangle strip and make view aligned:
+    // move vertices perpendicular to both line and view direction
+    // v = 1 moves half strip width in cross product direction, v = 0 moves half strip width in opposite direction)
+    vec3 viewAlignedPerpendicularDirection = normalize(cross(position - cameraPos, direction));
+    vec3 viewAlignedPosition = position + viewAlignedPerpendicularDirection * (uv.y-0.5)*lineTriangleStripWidth;
+
+    // tell fragment shader to discard fragments beyond a certain distance from origin in clipping plane direction
+    discardFragment = 0;
+    if (dot(viewAlignedPosition, clipPlaneNormal) > clipPlaneDistance)
+        discardFragment = 1;
+
+    gl_Position = viewProjMat * vec4(viewAlignedPosition, 1.0);
+    vertDirection = direction;
+    vertUV = uv;
+    vertScalar = scalar;
+}
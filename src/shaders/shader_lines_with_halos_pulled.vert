@@ -0,0 +1,79 @@
+#version 330 core
+
+// no vertex attributes: each line point is stored once and fetched from buffer textures by gl_VertexID
+// note: to draw line as triangle strip we need all line vertices twice: with same position and direction, but different v
+// basically we have a zero-width triangle strip which we widen by displacing vertices based on the v variable
+// which is 0 at one side and 1 at the other of the strip perpendicular to the line direction
+// here both strip vertices of line point i are gl_VertexID 2*i and 2*i+1, v is the parity of gl_VertexID
+// each track is drawn as its own strip, the neighboring points in the buffer may belong to other tracks
+uniform samplerBuffer linePositions; // x,y,z of each line point as 3 consecutive R32F texels
+uniform samplerBuffer lineScalars; // optional R16F scalar per line point (e.g. FA), only read if colorByScalar is set
+uniform usamplerBuffer lineTrackFlags; // R8UI per line point, bit 0 marks the first and bit 1 the last point of a track
+
+// out attributes passed to fragment shader
+out vec3 vertDirection;
+out vec2 vertUV;
+out float discardFragment;
+out float vertScalar;
+
+// per frame parameters shared by all line shaders, see GLWidget::LineRenderParameters (std140 layout)
+layout(std140) uniform LineRenderParameters
+{
+    mat4 viewProjMat;
+    vec3 cameraPos;
+    float lineTriangleStripWidth;
+    vec3 clipPlaneNormal;
+    float clipPlaneDistance;
+    vec3 colorLine;
+    float lineWidthPercentageBlack; // percentage of triangle strip drawn black to represent line (rest is white halo)
+    vec3 colorHalo;
+    float lineWidthDepthCueingFactor; // how much the black line is drawn thinner with increasing depth
+    vec2 scalarRange; // scalar range mapped to the color ramp
+    float lineHaloMaxDepth; // maximum depth displacement for white halo fragments
+    float positionRange; // PACKED_VERTICES positions are divided by it
+    float nearPlane;
+    float farPlane;
+    bool orthogonal;
+    bool colorByScalar; // color the line by vertScalar instead of colorLine
+};
+
+vec3 fetchPosition(int pointIndex)
+{
+    return vec3(texelFetch(linePositions, 3*pointIndex).r, texelFetch(linePositions, 3*pointIndex + 1).r, texelFetch(linePositions, 3*pointIndex + 2).r);
+}
+
+void main()
+{
+    int pointIndex = gl_VertexID / 2;
+    float v = float(gl_VertexID - 2*pointIndex);
+    vec3 position = fetchPosition(pointIndex);
+    uint trackFlags = texelFetch(lineTrackFlags, pointIndex).r;
+
+    // direction to next line vertex, computed from the neighboring points of the same track:
+    // take average of direction to current and direction to next for smoother directions.
+    // the last point of a track continues its incoming direction
+    vec3 directionToCurrent = vec3(0);
+    if ((trackFlags & 1u) == 0u)
+        directionToCurrent = normalize(position - fetchPosition(pointIndex - 1));
+    vec3 directionToNext = directionToCurrent;
+    if ((trackFlags & 2u) == 0u)
+        directionToNext = normalize(fetchPosition(pointIndex + 1) - position);
+    vec3 direction = normalize(directionToCurrent + directionToNext);
+
+    // VIEW ALIGNED TRIANGLE STRIPS
+    // widen zero-width triangle strip and make view aligned:
+    // move vertices perpendicular to both line and view direction
+    // v = 1 moves half strip width in cross product direction, v = 0 moves half strip width in opposite direction)
+    vec3 viewAlignedPerpendicularDirection = normalize(cross(position - cameraPos, direction));
+    vec3 viewAlignedPosition = position + viewAlignedPerpendicularDirection * (v-0.5)*lineTriangleStripWidth;
+
+    // tell fragment shader to discard fragments beyond a certain distance from origin in clipping plane direction
+    discardFragment = 0;
+    if (dot(viewAlignedPosition, clipPlaneNormal) > clipPlaneDistance)
+        discardFragment = 1;
+
+    gl_Position = viewProjMat * vec4(viewAlignedPosition, 1.0);
+    vertDirection = direction;
+    vertUV = vec2(0, v); // u is not used by the fragment shader and not stored
+    vertScalar = colorByScalar ? texelFetch(lineScalars, pointIndex).r : 0.0;
+}
@@ -0,0 +1,180 @@
+#include "tiffwriter.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QRunnable>
+
+//! rows per strip, a strip is the unit of compression
+static const int ROWS_PER_STRIP = 64;
+//! strips start behind the header, which is 8 bytes for classic TIFF and 16 bytes for BigTIFF
+static const quint64 HEADER_SIZE = 16;
+
+//! TIFF field types
+static const quint16 TIFF_SHORT = 3;
+static const quint16 TIFF_LONG = 4;
+static const quint16 TIFF_LONG8 = 16;
+
+//! \brief compresses a strip on a thread pool
+class StripCompressor : public QRunnable
+{
+public:
+	StripCompressor(QByteArray *strip)
+		: strip(strip)
+	{
+	}
+
+	void run()
+	{
+		// qCompress puts the uncompressed size in front of the zlib stream that TIFF deflate compression expects
+		*strip = qCompress(*strip, 6).mid(4);
+	}
+
+private:
+	QByteArray *strip;
+};
+
+TiffWriter::TiffWriter()
+{
+	width = 0;
+	height = 0;
+	numRows = 0;
+}
+
+TiffWriter::~TiffWriter()
+{
+	if (file.isOpen())
+		file.close();
+}
+
+bool TiffWriter::open(const QString &filename, int width, int height)
+{
+	this->width = width;
+	this->height = height;
+	numRows = 0;
+	stripRows.clear();
+	completeStrips.clear();
+	stripOffsets.clear();
+	stripByteCounts.clear();
+
+	file.setFileName(filename);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		qDebug() << "could not create" << filename;
+		return false;
+	}
+
+	// the header is written by close() when the directory offset is known
+	return file.write(QByteArray(HEADER_SIZE, 0)) == static_cast<qint64>(HEADER_SIZE);
+}
+
+bool TiffWriter::appendRows(const QImage &rows, int numRows)
+{
+	if (rows.format() != QImage::Format_RGB888 || rows.width() != width || numRows > rows.height() || this->numRows + numRows > height) {
+		qDebug() << "TIFF rows do not fit the image";
+		return false;
+	}
+
+	const int rowSize = 3 * width;
+	for (int y = 0; y < numRows; ++y) {
+		stripRows.append(reinterpret_cast<const char*>(rows.constScanLine(y)), rowSize);
+		++this->numRows;
+		if (stripRows.size() == ROWS_PER_STRIP * rowSize || this->numRows == height) {
+			completeStrips.push_back(stripRows);
+			stripRows.clear();
+		}
+	}
+	return writeStrips();
+}
+
+bool TiffWriter::writeStrips()
+{
+	for (size_t i = 0; i < completeStrips.size(); ++i)
+		threadPool.start(new StripCompressor(&completeStrips[i]));
+	threadPool.waitForDone();
+
+	for (size_t i = 0; i < completeStrips.size(); ++i) {
+		stripOffsets.push_back(file.pos());
+		stripByteCounts.push_back(completeStrips[i].size());
+		if (file.write(completeStrips[i]) != completeStrips[i].size()) {
+			qDebug() << "could not write" << file.fileName();
+			return false;
+		}
+	}
+	completeStrips.clear();
+	return true;
+}
+
+bool TiffWriter::close()
+{
+	if (numRows != height) {
+		qDebug() << file.fileName() << "has" << numRows << "of" << height << "rows";
+		file.close();
+		return false;
+	}
+
+	// strip arrays and directory follow the strips, word aligned
+	if (file.pos() % 2 != 0)
+		file.write(QByteArray(1, 0));
+	const quint64 numStrips = stripOffsets.size();
+	const bool bigTiff = file.pos() + numStrips * 16 + 1024 > 0xffffffffull;
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	auto writeOffset = [&](quint64 value) {
+		if (bigTiff)
+			stream << value;
+		else
+			stream << static_cast<quint32>(value);
+	};
+
+	// arrays that do not fit into the value field of their directory entry
+	const quint64 stripOffsetsPosition = file.pos();
+	for (quint64 offset : stripOffsets)
+		writeOffset(offset);
+	const quint64 stripByteCountsPosition = file.pos();
+	for (quint64 byteCount : stripByteCounts)
+		writeOffset(byteCount);
+	const quint64 bitsPerSamplePosition = file.pos();
+	stream << quint16(8) << quint16(8) << quint16(8);
+	if (file.pos() % 2 != 0)
+		stream << quint8(0);
+
+	// image file directory, entries sorted by tag. values are left justified in the value field, which is
+	// what writing them as little endian integer of the field size does
+	const quint64 directoryPosition = file.pos();
+	auto writeEntry = [&](quint16 tag, quint16 type, quint64 count, quint64 value) {
+		stream << tag << type;
+		writeOffset(count);
+		writeOffset(value);
+	};
+	const quint16 offsetType = bigTiff ? TIFF_LONG8 : TIFF_LONG;
+	const quint16 numEntries = 10;
+	if (bigTiff)
+		stream << quint64(numEntries);
+	else
+		stream << numEntries;
+	writeEntry(256, TIFF_LONG, 1, width); // ImageWidth
+	writeEntry(257, TIFF_LONG, 1, height); // ImageLength
+	writeEntry(258, TIFF_SHORT, 3, bigTiff ? (quint64(8) | quint64(8) << 16 | quint64(8) << 32) : bitsPerSamplePosition); // BitsPerSample
+	writeEntry(259, TIFF_SHORT, 1, 8); // Compression: deflate
+	writeEntry(262, TIFF_SHORT, 1, 2); // PhotometricInterpretation: RGB
+	writeEntry(273, offsetType, numStrips, numStrips == 1 ? stripOffsets[0] : stripOffsetsPosition); // StripOffsets
+	writeEntry(277, TIFF_SHORT, 1, 3); // SamplesPerPixel
+	writeEntry(278, TIFF_LONG, 1, ROWS_PER_STRIP); // RowsPerStrip
+	writeEntry(279, offsetType, numStrips, numStrips == 1 ? stripByteCounts[0] : stripByteCountsPosition); // StripByteCounts
+	writeEntry(284, TIFF_SHORT, 1, 1); // PlanarConfiguration: interleaved
+	writeOffset(0); // no next directory
+
+	// header
+	file.seek(0);
+	stream.writeRawData("II", 2);
+	if (bigTiff)
+		stream << quint16(43) << quint16(8) << quint16(0) << directoryPosition;
+	else
+		stream << quint16(42) << static_cast<quint32>(directoryPosition);
+
+	const bool success = stream.status() == QDataStream::Ok && file.error() == QFileDevice::NoError;
+	file.close();
+	if (!success)
+		qDebug() << "could not write" << file.fileName();
+	return success;
+}
@@ -0,0 +1,56 @@
+#ifndef TIFFWRITER_H
+#define TIFFWRITER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QImage>
+#include <QString>
+#include <QThreadPool>
+
+#include <vector>
+
+//! \brief The TiffWriter class.
+//!
+//! Writes an RGB image of any size as a deflate compressed TIFF file while it is produced row by row,
+//! e.g. a poster rendered in tiles, without holding the whole image in memory.
+//! Each strip of rows is compressed on its own (in parallel on a thread pool) and written as soon as it is complete.
+//! The directory is written at the end: a classic TIFF file if it stays below 4 GB, a BigTIFF file otherwise.
+class TiffWriter
+{
+public:
+	TiffWriter();
+	~TiffWriter();
+
+	//! \brief create the file
+	//! \return false if the file could not be created
+	bool open(const QString &filename, int width, int height);
+
+	//! \brief append rows below the rows appended so far
+	//! \param rows image of the image width in QImage::Format_RGB888, its first numRows rows are appended
+	//! \return false if writing failed
+	bool appendRows(const QImage &rows, int numRows);
+
+	//! \brief write the remaining rows and the directory, the file is complete after all rows were appended
+	//! \return false if rows are missing or writing failed
+	bool close();
+
+private:
+
+	//! \brief compress and write the complete strips
+	bool writeStrips();
+
+	QFile file;
+	int width;
+	int height;
+	int numRows; // rows appended so far
+
+	QByteArray stripRows; // uncompressed rows of the strip that is not complete yet
+	std::vector<QByteArray> completeStrips; // uncompressed strips that are not written yet
+	std::vector<quint64> stripOffsets; // of the written strips in the file
+	std::vector<quint64> stripByteCounts;
+
+	QThreadPool threadPool; // compresses the strips, its threads are kept for all rows of the file
+
+};
+
+#endif // TIFFWRITER_H
@@ -0,0 +1,44 @@
+#include "trkcompressor.h"
+
+#include <QDebug>
+#include <QElapsedTimer>
+#include <algorithm>
+
+#include "libtrkfileio/trkzfileio.h"
+
+TrkCompressor::TrkCompressor(const QString &trkFilename, const QString &trkzFilename, float errorBound, QObject *parent)
+		: QObject(parent)
+{
+	this->trkFilename = trkFilename;
+	this->trkzFilename = trkzFilename;
+	this->errorBound = errorBound;
+	percent = -1;
+}
+
+void TrkCompressor::compress()
+{
+	QElapsedTimer timer;
+	timer.start();
+
+	float maxError = 0;
+	bool success = compressTrkFile(trkFilename.toStdString(), trkzFilename.toStdString(), errorBound, &maxError, &TrkCompressor::reportProgress, this);
+	if (!success) {
+		emit finished(false, 0, isCancelled() ? QString("cancelled") : "could not convert " + trkFilename);
+		return;
+	}
+
+	qDebug() << "Compressed" << trkFilename << "in" << timer.elapsed() << "ms, max error" << maxError;
+	emit finished(true, maxError, QString());
+}
+
+bool TrkCompressor::reportProgress(size_t numTracksDone, size_t numTracks, void *compressor)
+{
+	// called once per batch of tracks, only changed percentages are sent to the gui thread
+	TrkCompressor *self = static_cast<TrkCompressor*>(compressor);
+	int percent = static_cast<int>((100 * static_cast<quint64>(numTracksDone)) / std::max<quint64>(numTracks, 1));
+	if (percent != self->percent) {
+		self->percent = percent;
+		emit self->progressChanged(percent);
+	}
+	return !self->isCancelled();
+}
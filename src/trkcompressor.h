@@ -0,0 +1,60 @@
+#ifndef TRKCOMPRESSOR_H
+#define TRKCOMPRESSOR_H
+
+#include <QObject>
+#include <QString>
+#include <QAtomicInt>
+
+//! \brief The TrkCompressor class.
+//!
+//! Converts a .trk file into a compressed .trkz file on a worker thread, see compressTrkFile().
+//! Move the compressor to a QThread and start compress() from there, cancel() may be called from any thread.
+class TrkCompressor : public QObject
+{
+	Q_OBJECT
+
+public:
+	//! \param errorBound max coordinate error of the compressed tracks in track file units (usually mm)
+	TrkCompressor(const QString &trkFilename, const QString &trkzFilename, float errorBound, QObject *parent = 0);
+
+	//! \brief request the compressor to stop after the current batch of tracks, may be called from any thread
+	inline void cancel()
+	{
+		cancelRequested.storeRelease(1);
+	}
+
+	inline bool isCancelled() const
+	{
+		return cancelRequested.loadAcquire() != 0;
+	}
+
+public slots:
+
+	//! \brief compress the file, emits progressChanged() and finally finished()
+	void compress();
+
+signals:
+
+	//! \brief compression progress in percent
+	void progressChanged(int percent);
+
+	//! \brief emitted when the compression is done, failed or was cancelled, the unfinished .trkz file is removed if not successful
+	//! \param success true if the .trkz file was written
+	//! \param maxError max coordinate error of all compressed tracks
+	//! \param message error message if not successful
+	void finished(bool success, float maxError, QString message);
+
+private:
+
+	//! \brief progress callback of compressTrkFile(), returns false once cancelled
+	static bool reportProgress(size_t numTracksDone, size_t numTracks, void *compressor);
+
+	QString trkFilename;
+	QString trkzFilename;
+	float errorBound;
+	QAtomicInt cancelRequested;
+	int percent; // last reported progress
+
+};
+
+#endif // TRKCOMPRESSOR_H
@@ -0,0 +1,604 @@
+#include "trkloader.h"
+
+#include <QDebug>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QWaitCondition>
+#include <QThreadPool>
+#include <QRunnable>
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+#include "linecache.h"
+#include "linedata.h"
+
+//! number of track points in the first chunk, small so the first pixels appear quickly
+static const int64_t FIRST_CHUNK_NUM_POINTS = 1 << 15;
+//! chunks grow up to this number of track points to keep per-chunk overhead low
+static const int64_t MAX_CHUNK_NUM_POINTS = 1 << 20;
+
+//! \brief The TrackSource class.
+//!
+//! Common interface of the track file readers used by the loader.
+//! readTracks() may be called from several threads at once.
+class TrackSource
+{
+public:
+	virtual ~TrackSource() {}
+
+	virtual bool open() = 0;
+	virtual size_t getNumTracks() = 0;
+	virtual int64_t getNumPoints(size_t track) = 0;
+	virtual const TrkFileHeader &getHeader() = 0;
+	virtual bool readTracks(size_t firstTrack, size_t numTracks, std::vector<float> &positions, std::vector<int64_t> &trackOffsets, std::vector<float> *scalars) = 0;
+};
+
+//! \brief TrackVis .trk file source.
+class TrkTrackSource : public TrackSource
+{
+public:
+	explicit TrkTrackSource(const std::string &filename)
+		: path(filename), reader(path)
+	{
+	}
+
+	bool open()
+	{
+		// prefer reading from a memory mapping, fall back to stream reading if the file cannot be mapped.
+		// the track index is cached in a sidecar file next to the data so reopening skips the full file scan.
+		reader.setUseSidecarIndex(true);
+		return reader.openMapped() || reader.open();
+	}
+
+	size_t getNumTracks() { return reader.getTotalTrkNum(); }
+	int64_t getNumPoints(size_t track) { return reader.getPointNumInTrk(static_cast<int>(track)); }
+	const TrkFileHeader &getHeader() { return reader.getHeader(); }
+
+	bool readTracks(size_t firstTrack, size_t numTracks, std::vector<float> &positions, std::vector<int64_t> &trackOffsets, std::vector<float> *scalars)
+	{
+		// reading from the mapping is thread safe, reading from the stream is not
+		QMutexLocker locker(reader.isMapped() ? nullptr : &streamMutex);
+		return reader.readTracks(firstTrack, numTracks, positions, trackOffsets, scalars);
+	}
+
+private:
+	std::string path;
+	TrkFileReader reader;
+	QMutex streamMutex;
+};
+
+//! \brief compressed .trkz file source, the compressed file is held in memory and decoding is thread safe.
+class TrkzTrackSource : public TrackSource
+{
+public:
+	explicit TrkzTrackSource(const std::string &filename)
+		: path(filename), reader(path)
+	{
+	}
+
+	bool open() { return reader.open(); }
+	size_t getNumTracks() { return reader.getTotalTrkNum(); }
+	int64_t getNumPoints(size_t track) { return reader.getPointNumInTrk(static_cast<int>(track)); }
+	const TrkFileHeader &getHeader() { return reader.getHeader(); }
+
+	bool readTracks(size_t firstTrack, size_t numTracks, std::vector<float> &positions, std::vector<int64_t> &trackOffsets, std::vector<float> *scalars)
+	{
+		return reader.readTracks(firstTrack, numTracks, positions, trackOffsets, scalars);
+	}
+
+private:
+	std::string path;
+	TrkzFileReader reader;
+};
+
+static TrackSource *createTrackSource(const QString &filename)
+{
+	// compressed track files are decoded straight into the chunk position buffer
+	if (filename.endsWith(".trkz", Qt::CaseInsensitive))
+		return new TrkzTrackSource(filename.toStdString());
+	return new TrkTrackSource(filename.toStdString());
+}
+
+//! \brief opens a track source on the thread pool, building the track index may scan the whole file
+class TrackSourceOpener : public QRunnable
+{
+public:
+	TrackSourceOpener(TrackSource *source, bool *success)
+		: source(source), success(success)
+	{
+	}
+
+	void run()
+	{
+		*success = source->open();
+	}
+
+private:
+	TrackSource *source;
+	bool *success;
+};
+
+//! \brief The LineChunk struct.
+//! Tracks [firstTrack, firstTrack+numTracks) of one source, decoded on the thread pool.
+struct LineChunk
+{
+	TrackSource *source;
+	int fileIndex;
+	size_t firstTrack;
+	size_t numTracks;
+	int64_t numPoints;
+
+	// decoded track points, kept between reading and normalization if the normalization depends on all points
+	bool pointsRead;
+	std::vector<float> trackPoints; //!< x, y, z of all points in chunk
+	std::vector<float> trackScalars; //!< one column per scalar
+	std::vector<int64_t> trackOffsets; //!< the points of track i are [trackOffsets[i], trackOffsets[i+1])
+	PositionStats positionStats; //!< of trackPoints, only computed when reading before the normalization is known
+
+	// results, valid once done is set
+	bool done;
+	bool success;
+	LineDataChunk lines;
+	glm::vec3 boundingBoxMin;
+	glm::vec3 boundingBoxMax;
+	float scalarMin;
+	float scalarMax;
+};
+
+//! \brief transform chunk positions into normalized line positions
+static void generateChunkLines(const std::vector<float> &trackPoints, const std::vector<int64_t> &trackOffsets, const glm::vec3 &normalizationCenter, float normalizationScale,
+							   LineData &lines, glm::vec3 &boundingBoxMin, glm::vec3 &boundingBoxMax)
+{
+	// move data to center of coordinate system and scale into [-1,1], in one vectorized sweep over all points of the chunk
+	lines.positions.resize(trackPoints.size() / 3);
+	transformTrackPositions(trackPoints.data(), lines.positions.size(), normalizationCenter, normalizationScale, lines.positions.data(), boundingBoxMin, boundingBoxMax);
+	lines.trackOffsets = trackOffsets;
+}
+
+//! \brief read the track points (and first scalars if the dataset has scalars) of a chunk
+static bool readChunk(LineChunk *chunk, bool datasetHasScalars)
+{
+	bool sourceHasScalars = chunk->source->getHeader().n_scalars > 0;
+	chunk->pointsRead = chunk->source->readTracks(chunk->firstTrack, chunk->numTracks, chunk->trackPoints, chunk->trackOffsets,
+												  datasetHasScalars && sourceHasScalars ? &chunk->trackScalars : NULL);
+	return chunk->pointsRead;
+}
+
+//! \brief reads one chunk and its position stats on the thread pool, used when the normalization depends on all points
+class LineChunkReader : public QRunnable
+{
+public:
+	LineChunkReader(LineChunk *chunk, const TrkLoader *loader, bool datasetHasScalars)
+		: chunk(chunk), loader(loader), datasetHasScalars(datasetHasScalars)
+	{
+	}
+
+	void run()
+	{
+		if (loader->isCancelled() || !readChunk(chunk, datasetHasScalars))
+			return;
+		reducePositions(chunk->trackPoints.data(), chunk->trackPoints.size() / 3, chunk->positionStats);
+	}
+
+private:
+	LineChunk *chunk;
+	const TrkLoader *loader;
+	bool datasetHasScalars;
+};
+
+//! \brief decodes one chunk on the thread pool and signals when done
+class LineChunkDecoder : public QRunnable
+{
+public:
+	LineChunkDecoder(LineChunk *chunk, const TrkLoader *loader, const glm::vec3 &normalizationCenter, float normalizationScale, float resampleStep, bool datasetHasScalars,
+					 QMutex *mutex, QWaitCondition *chunkDone)
+		: chunk(chunk), loader(loader), normalizationCenter(normalizationCenter), normalizationScale(normalizationScale), resampleStep(resampleStep),
+		  datasetHasScalars(datasetHasScalars), mutex(mutex), chunkDone(chunkDone)
+	{
+	}
+
+	void run()
+	{
+		// skip the work if loading was cancelled or failed, the chunk is still marked done so nobody waits forever
+		bool success = !loader->isCancelled() && decode();
+
+		QMutexLocker locker(mutex);
+		chunk->success = success;
+		chunk->done = true;
+		chunkDone->wakeAll();
+	}
+
+private:
+	bool decode()
+	{
+		// the points may already have been read while computing the normalization
+		if (!chunk->pointsRead && !readChunk(chunk, datasetHasScalars))
+			return false;
+
+		const std::vector<float> &trackPoints = chunk->trackPoints;
+		const std::vector<float> &trackScalars = chunk->trackScalars;
+		bool sourceHasScalars = chunk->source->getHeader().n_scalars > 0;
+
+		chunk->lines = LineDataChunk(new LineData());
+		generateChunkLines(trackPoints, chunk->trackOffsets, normalizationCenter, normalizationScale, *chunk->lines, chunk->boundingBoxMin, chunk->boundingBoxMax);
+
+		if (datasetHasScalars) {
+			// first column holds the first scalar of all points in the chunk, files without scalars get 0
+			size_t numPoints = trackPoints.size() / 3;
+			if (sourceHasScalars) {
+				for (size_t i = 0; i < numPoints; ++i) {
+					chunk->scalarMin = std::min(chunk->scalarMin, trackScalars[i]);
+					chunk->scalarMax = std::max(chunk->scalarMax, trackScalars[i]);
+				}
+				generateLineScalars(trackScalars.data(), numPoints, chunk->lines->scalars);
+			}
+			else {
+				chunk->lines->scalars.assign(numPoints, 0);
+			}
+		}
+
+		// uniform arc-length step, resampleStep is in normalized line position units
+		if (resampleStep > 0) {
+			LineDataChunk resampled(new LineData());
+			const float usedStep = resampleTracks(*chunk->lines, resampleStep, *resampled);
+			if (usedStep > resampleStep)
+				qDebug() << "resample step enlarged from" << resampleStep << "to" << usedStep << "to bound the track points of a chunk";
+			chunk->lines = resampled;
+		}
+
+		// the points are not needed anymore
+		std::vector<float>().swap(chunk->trackPoints);
+		std::vector<float>().swap(chunk->trackScalars);
+		std::vector<int64_t>().swap(chunk->trackOffsets);
+		return true;
+	}
+
+	LineChunk *chunk;
+	const TrkLoader *loader;
+	glm::vec3 normalizationCenter;
+	float normalizationScale;
+	float resampleStep;
+	bool datasetHasScalars;
+	QMutex *mutex;
+	QWaitCondition *chunkDone;
+};
+
+TrkLoader::TrkLoader(const QString &filename, QObject *parent)
+		: TrkLoader(QStringList(filename), parent)
+{
+}
+
+TrkLoader::TrkLoader(const QStringList &filenames, QObject *parent)
+		: QObject(parent)
+{
+	this->filenames = filenames;
+	useCache = true;
+	resampleStep = 0;
+	boundingBoxMin = glm::vec3(std::numeric_limits<float>::max());
+	boundingBoxMax = glm::vec3(-std::numeric_limits<float>::max());
+	scalarMin = std::numeric_limits<float>::max();
+	scalarMax = -std::numeric_limits<float>::max();
+	normalizationCenter = glm::vec3(0, 0, 0);
+	normalizationScale = 1;
+}
+
+void TrkLoader::load()
+{
+	if (filenames.isEmpty()) {
+		emit finished(false, "no file");
+		return;
+	}
+
+	// preprocessed line positions of earlier loads of a single file are used directly if still valid
+	QString cacheFilename;
+	if (useCache && filenames.size() == 1) {
+		cacheFilename = lineCacheFilename(filenames[0]);
+		if (loadFromCache(cacheFilename))
+			return;
+	}
+
+	// decodes the chunks of all files in parallel, the destructor waits for running tasks
+	QThreadPool threadPool;
+
+	// open all files in parallel, without a valid sidecar index the whole file is scanned once
+	std::vector<QSharedPointer<TrackSource> > sources;
+	QVector<bool> sourceOpened(filenames.size(), false);
+	for (int i = 0; i < filenames.size(); ++i) {
+		sources.push_back(QSharedPointer<TrackSource>(createTrackSource(filenames[i])));
+		threadPool.start(new TrackSourceOpener(sources.back().data(), &sourceOpened[i]));
+	}
+	threadPool.waitForDone();
+	for (int i = 0; i < filenames.size(); ++i) {
+		if (!sourceOpened[i]) {
+			emit finished(false, "could not open file " + filenames[i]);
+			return;
+		}
+	}
+
+	// each file becomes one contiguous range of tracks and line points in the dataset
+	TrkFileRanges fileRanges;
+	int64_t numTracksTotal = 0; // number of tractography tracks (lines of traced nerves) in all files
+	int64_t numPointsTotal = 0; // total count of points (vertices) in tracks
+	bool datasetHasScalars = false;
+	for (size_t i = 0; i < sources.size(); ++i) {
+		TrkFileRange fileRange;
+		fileRange.filename = filenames[static_cast<int>(i)];
+		fileRange.firstTrack = numTracksTotal;
+		fileRange.numTracks = sources[i]->getNumTracks();
+		fileRange.firstPoint = numPointsTotal;
+		for (size_t track = 0; track < sources[i]->getNumTracks(); ++track) {
+			numPointsTotal += sources[i]->getNumPoints(track);
+		}
+		fileRange.numPoints = numPointsTotal - fileRange.firstPoint;
+		numTracksTotal += fileRange.numTracks;
+		datasetHasScalars = datasetHasScalars || sources[i]->getHeader().n_scalars > 0;
+		fileRanges.push_back(fileRange);
+	}
+	if (numPointsTotal == 0) {
+		emit finished(false, "file contains no tracks");
+		return;
+	}
+
+	// split all files into chunks of whole tracks:
+	// a small first chunk so something is shown quickly, then enough chunks to keep all threads busy
+	int64_t maxChunkNumPoints = numPointsTotal / (4 * std::max(threadPool.maxThreadCount(), 1));
+	maxChunkNumPoints = std::max(FIRST_CHUNK_NUM_POINTS, std::min(maxChunkNumPoints, MAX_CHUNK_NUM_POINTS));
+	int64_t chunkNumPoints = FIRST_CHUNK_NUM_POINTS;
+	std::vector<LineChunk> chunks;
+	for (size_t i = 0; i < sources.size(); ++i) {
+		size_t numTracks = sources[i]->getNumTracks();
+		size_t firstTrack = 0;
+		while (firstTrack < numTracks) {
+
+			// collect whole tracks until the chunk is full
+			LineChunk chunk;
+			chunk.source = sources[i].data();
+			chunk.fileIndex = static_cast<int>(i);
+			chunk.firstTrack = firstTrack;
+			chunk.numTracks = 0;
+			chunk.numPoints = 0;
+			while (firstTrack + chunk.numTracks < numTracks && (chunk.numTracks == 0 || chunk.numPoints < chunkNumPoints)) {
+				chunk.numPoints += sources[i]->getNumPoints(firstTrack + chunk.numTracks);
+				++chunk.numTracks;
+			}
+			chunk.pointsRead = false;
+			chunk.done = false;
+			chunk.success = false;
+			chunk.boundingBoxMin = glm::vec3(std::numeric_limits<float>::max());
+			chunk.boundingBoxMax = glm::vec3(-std::numeric_limits<float>::max());
+			chunk.scalarMin = std::numeric_limits<float>::max();
+			chunk.scalarMax = -std::numeric_limits<float>::max();
+			chunks.push_back(chunk);
+
+			firstTrack += chunk.numTracks;
+			chunkNumPoints = std::min(2*chunkNumPoints, maxChunkNumPoints);
+		}
+	}
+
+	// the volumes stored in the headers define the normalization.
+	// without a valid volume, all chunks are read and reduced to mean and bounds on the thread pool first,
+	// their points are kept so each file is still read only once.
+	if (!computeNormalizationFromHeaders(sources)) {
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			threadPool.start(new LineChunkReader(&chunks[i], this, datasetHasScalars));
+		}
+		threadPool.waitForDone();
+		if (isCancelled()) {
+			emit finished(false, "cancelled");
+			return;
+		}
+
+		PositionStats positionStats;
+		for (size_t i = 0; i < chunks.size(); ++i) {
+			if (!chunks[i].pointsRead) {
+				emit finished(false, "error reading tracks");
+				return;
+			}
+			positionStats.merge(chunks[i].positionStats);
+		}
+		computeNormalization(positionStats);
+	}
+
+	emit fileRangesChanged(fileRanges);
+	emit loadStarted(numTracksTotal, numPointsTotal);
+
+	// write the normalized line positions to the line cache while loading
+	// the cache does not store scalars, files with scalars are always decoded
+	LineCacheWriter cacheWriter;
+	bool writeCache = !cacheFilename.isEmpty() && !datasetHasScalars && cacheWriter.begin(cacheFilename, filenames[0], getSettingsKey());
+	std::vector<qint64> trackPointOffsets; // first point of each track in the line position stream
+	if (writeCache) {
+		trackPointOffsets.reserve(numTracksTotal + 1);
+		trackPointOffsets.push_back(0);
+	}
+
+	// decode all chunks on the thread pool, they are queued in file order
+	QMutex mutex;
+	QWaitCondition chunkDone;
+	for (size_t i = 0; i < chunks.size(); ++i) {
+		threadPool.start(new LineChunkDecoder(&chunks[i], this, normalizationCenter, normalizationScale, resampleStep * normalizationScale, datasetHasScalars, &mutex, &chunkDone));
+	}
+
+	// hand out the chunks in file order as soon as each one is done
+	QString errorMessage;
+	int64_t numPointsLoaded = 0;
+	std::vector<int64_t> fileNumPoints(fileRanges.size(), 0); // line points of each file after resampling
+	for (size_t i = 0; i < chunks.size(); ++i) {
+
+		LineChunk &chunk = chunks[i];
+		{
+			QMutexLocker locker(&mutex);
+			while (!chunk.done)
+				chunkDone.wait(&mutex);
+		}
+
+		if (isCancelled()) {
+			errorMessage = "cancelled";
+			break;
+		}
+		if (!chunk.success) {
+			errorMessage = "error reading tracks";
+			cancel(); // skip the remaining chunks
+			break;
+		}
+
+		boundingBoxMin = glm::min(boundingBoxMin, chunk.boundingBoxMin);
+		boundingBoxMax = glm::max(boundingBoxMax, chunk.boundingBoxMax);
+
+		if (datasetHasScalars) {
+			scalarMin = std::min(scalarMin, chunk.scalarMin);
+			scalarMax = std::max(scalarMax, chunk.scalarMax);
+			emit scalarRangeChanged(scalarMin, scalarMax);
+		}
+		emit chunkLoaded(chunk.lines);
+		fileNumPoints[chunk.fileIndex] += chunk.lines->positions.size();
+
+		if (writeCache) {
+			const std::vector<int64_t> &trackOffsets = chunk.lines->trackOffsets;
+			for (size_t t = 1; t < trackOffsets.size(); ++t) {
+				trackPointOffsets.push_back(trackPointOffsets.back() + trackOffsets[t] - trackOffsets[t-1]);
+			}
+			writeCache = cacheWriter.appendPositions(chunk.lines->positions);
+		}
+
+		// the receivers hold their own references
+		chunk.lines.reset();
+
+		numPointsLoaded += chunk.numPoints;
+		emit progressChanged(static_cast<int>((100*numPointsLoaded) / numPointsTotal));
+	}
+
+	// chunks and sources must outlive the decoders
+	threadPool.waitForDone();
+
+	if (!errorMessage.isEmpty()) {
+		emit finished(false, errorMessage);
+		return;
+	}
+
+	if (writeCache && !cacheWriter.finish(trackPointOffsets, boundingBoxMin, boundingBoxMax))
+		qDebug() << "could not write line cache" << cacheFilename;
+
+	// resampling changed the number of line points of each file
+	if (resampleStep > 0) {
+		int64_t numPointsResampled = 0;
+		for (int i = 0; i < fileRanges.size(); ++i) {
+			fileRanges[i].firstPoint = numPointsResampled;
+			fileRanges[i].numPoints = fileNumPoints[i];
+			numPointsResampled += fileNumPoints[i];
+		}
+		qDebug() << "Resampled tracks to" << resampleStep << "mm steps:" << numPointsTotal << "track points before," << numPointsResampled << "after";
+		emit fileRangesChanged(fileRanges);
+	}
+
+	emit finished(true, QString());
+}
+
+bool TrkLoader::loadFromCache(const QString &cacheFilename)
+{
+	LineCacheReader cacheReader;
+	if (!cacheReader.open(cacheFilename, filenames[0], getSettingsKey()))
+		return false;
+
+	const LineCacheHeader &header = cacheReader.getHeader();
+	const glm::vec3 *positions = cacheReader.getPositions();
+	const qint64 *trackOffsets = cacheReader.getTrackOffsets();
+	boundingBoxMin = glm::vec3(header.boundingBoxMin[0], header.boundingBoxMin[1], header.boundingBoxMin[2]);
+	boundingBoxMax = glm::vec3(header.boundingBoxMax[0], header.boundingBoxMax[1], header.boundingBoxMax[2]);
+
+	TrkFileRange fileRange;
+	fileRange.filename = filenames[0];
+	fileRange.firstTrack = 0;
+	fileRange.numTracks = header.numTracks;
+	fileRange.firstPoint = 0;
+	fileRange.numPoints = header.numPoints;
+	emit fileRangesChanged(TrkFileRanges() << fileRange);
+	emit loadStarted(header.numTracks, header.numPoints);
+
+	// hand out the mapped positions in chunks of whole tracks, same as when decoding the .trk file
+	int64_t chunkNumPoints = FIRST_CHUNK_NUM_POINTS;
+	qint64 firstTrack = 0;
+	while (firstTrack < header.numTracks) {
+
+		if (isCancelled()) {
+			emit finished(false, "cancelled");
+			return true;
+		}
+
+		qint64 lastTrack = firstTrack + 1;
+		while (lastTrack < header.numTracks && trackOffsets[lastTrack] - trackOffsets[firstTrack] < chunkNumPoints) {
+			++lastTrack;
+		}
+
+		LineDataChunk chunk(new LineData());
+		chunk->positions.assign(positions + trackOffsets[firstTrack], positions + trackOffsets[lastTrack]);
+		chunk->trackOffsets.resize(lastTrack - firstTrack + 1);
+		for (qint64 t = firstTrack; t <= lastTrack; ++t) {
+			chunk->trackOffsets[t - firstTrack] = trackOffsets[t] - trackOffsets[firstTrack];
+		}
+		emit chunkLoaded(chunk);
+
+		firstTrack = lastTrack;
+		chunkNumPoints = std::min(2*chunkNumPoints, MAX_CHUNK_NUM_POINTS);
+
+		emit progressChanged(static_cast<int>((100*trackOffsets[firstTrack]) / std::max<qint64>(header.numPoints, 1)));
+	}
+
+	emit finished(true, QString());
+	return true;
+}
+
+quint64 TrkLoader::getSettingsKey() const
+{
+	// the resampling step changes the line positions, 0 (no resampling) keeps the key of earlier caches
+	quint32 resampleStepBits = 0;
+	memcpy(&resampleStepBits, &resampleStep, sizeof(resampleStepBits));
+	return resampleStepBits;
+}
+
+bool TrkLoader::computeNormalizationFromHeaders(const std::vector<QSharedPointer<TrackSource> > &sources)
+{
+	// the header stores the extent of the image volume the tracks were traced in, tracks are in voxelmm coordinates.
+	// shards of one dataset share the volume, otherwise the largest extent of all files is used.
+	// note we swap y and z (we use different coords)
+	glm::vec3 volumeExtent = glm::vec3(std::numeric_limits<float>::max());
+	glm::vec3 volumeExtentMax = glm::vec3(0, 0, 0);
+	for (size_t i = 0; i < sources.size(); ++i) {
+		const TrkFileHeader &header = sources[i]->getHeader();
+		glm::vec3 extent = glm::vec3(header.dim[0] * header.voxel_size[0], header.dim[2] * header.voxel_size[2], header.dim[1] * header.voxel_size[1]);
+		volumeExtent = glm::min(volumeExtent, extent);
+		volumeExtentMax = glm::max(volumeExtentMax, extent);
+	}
+	if (volumeExtent.x <= 0 || volumeExtent.y <= 0 || volumeExtent.z <= 0)
+		return false;
+
+	// center volume and scale such that largest direction of the volume is in [-1,1]
+	normalizationCenter = volumeExtentMax / 2.0f;
+	normalizationScale = 2.0f / glm::max(volumeExtentMax.x, glm::max(volumeExtentMax.y, volumeExtentMax.z));
+	return true;
+}
+
+void TrkLoader::computeNormalization(const PositionStats &positionStats)
+{
+	// stats are in file coords, note we swap y and z (we use different coords)
+	glm::dvec3 meanPos = glm::dvec3(positionStats.sum.x, positionStats.sum.z, positionStats.sum.y) / static_cast<double>(positionStats.count);
+	glm::vec3 boundingBoxMin = glm::vec3(positionStats.min.x, positionStats.min.z, positionStats.min.y);
+	glm::vec3 boundingBoxMax = glm::vec3(positionStats.max.x, positionStats.max.z, positionStats.max.y);
+
+	// move bounding box such that mean pos is at origin
+	boundingBoxMin -= glm::vec3(meanPos);
+	boundingBoxMax -= glm::vec3(meanPos);
+
+	// scale data such that largest direction of bounding box is in [-1,1]
+	// i.e. map [minValue, maxValue] of that direction to [-1,1] or boundingBoxLengthMax to 2
+	glm::vec3 boundingBoxLength = boundingBoxMax - boundingBoxMin;
+	float boundingBoxLengthMax = glm::max(boundingBoxLength.x, glm::max(boundingBoxLength.y, boundingBoxLength.z));
+	float minValue = 0;
+	if (boundingBoxLengthMax == boundingBoxLength.x) { minValue = boundingBoxMin.x; }
+	if (boundingBoxLengthMax == boundingBoxLength.y) { minValue = boundingBoxMin.y; }
+	if (boundingBoxLengthMax == boundingBoxLength.z) { minValue = boundingBoxMin.z; }
+
+	normalizationCenter = glm::vec3(meanPos) + glm::vec3(minValue + boundingBoxLengthMax/2.0f);
+	normalizationScale = 2.0f / boundingBoxLengthMax;
+}
@@ -0,0 +1,163 @@
+#ifndef TRKLOADER_H
+#define TRKLOADER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+#include <vector>
+#include <glm/glm.hpp>
+
+#include "libtrkfileio/trkfileio.h"
+#include "libtrkfileio/trkzfileio.h"
+#include "linedata.h"
+
+class TrackSource;
+struct PositionStats;
+
+//! a chunk of whole tracks with normalized line positions (and scalars), shared between loader thread and gui thread without copying
+typedef QSharedPointer<LineData> LineDataChunk;
+Q_DECLARE_METATYPE(LineDataChunk)
+
+//! \brief The TrkFileRange struct.
+//! Tracks and line points of one input file inside the merged dataset.
+struct TrkFileRange
+{
+	QString filename;
+	qint64 firstTrack; //!< index of the first track of the file in the dataset
+	qint64 numTracks;
+	qint64 firstPoint; //!< index of the first line point of the file in the dataset
+	qint64 numPoints;
+};
+typedef QVector<TrkFileRange> TrkFileRanges;
+Q_DECLARE_METATYPE(TrkFileRanges)
+
+//! \brief The TrkLoader class.
+//!
+//! Loads TrackVis .trk (or compressed .trkz) tractography track line data on a worker thread.
+//! Several files can be loaded at once into a single dataset with a shared normalization transform.
+//! Tracks of all files are split into chunks which are decoded in parallel on a thread pool,
+//! finished chunks are handed out via chunkLoaded() in file order, so each file ends up as one
+//! contiguous range of the dataset and can be rendered while the rest is still loading.
+//! If the files store scalars at each track point, the first scalar is decoded in the same pass
+//! and handed out as part of the chunk, the scalar range loaded so far is reported via scalarRangeChanged().
+//! Move the loader to a QThread and start load() from there, cancel() may be called from any thread.
+//!
+//! This uses libtrkfileio by lheric from https://github.com/lheric/libtrkfileio.
+class TrkLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	explicit TrkLoader(const QString &filename, QObject *parent = 0);
+	explicit TrkLoader(const QStringList &filenames, QObject *parent = 0);
+
+	//! \brief request the loader to stop as soon as possible, may be called from any thread
+	inline void cancel()
+	{
+		cancelRequested.storeRelease(1);
+	}
+
+	inline bool isCancelled() const
+	{
+		return cancelRequested.loadAcquire() != 0;
+	}
+
+	inline QStringList getFilenames() const
+	{
+		return filenames;
+	}
+
+	//! \brief enable reading/writing the render-ready line cache (enabled by default)
+	//! if a valid cache exists for the file, the .trk file is not decoded at all.
+	//! only single file loads are cached.
+	inline void setUseCache(bool useCache)
+	{
+		this->useCache = useCache;
+	}
+
+	//! \brief resample each track to a uniform arc-length step while decoding (disabled by default)
+	//! \param step max distance between consecutive track points in track file units (usually mm), 0 keeps the points of the files
+	//! the number of line points changes, chunkLoaded() may hand out more or fewer points than announced by loadStarted(),
+	//! fileRangesChanged() is emitted again with the resampled point ranges before finished().
+	inline void setResampleStep(float step)
+	{
+		resampleStep = step;
+	}
+
+public slots:
+
+	//! \brief load the files chunk by chunk, emits loadStarted(), chunkLoaded() and progressChanged(), and finally finished()
+	void load();
+
+signals:
+
+	//! \brief emitted once the number of tracks and points is known, before the first chunk
+	//! \param numTracks number of tracks in all files
+	//! \param numPoints total number of track points in the files (before resampling)
+	void loadStarted(qint64 numTracks, qint64 numPoints);
+
+	//! \brief emitted right before loadStarted() with the track and point range of each file in the dataset,
+	//! and again before finished() if the tracks were resampled
+	void fileRangesChanged(TrkFileRanges fileRanges);
+
+	//! \brief emitted for each finished chunk of whole tracks, chunks are emitted in file order
+	//! \param chunk normalized line positions and track offsets of the chunk,
+	//! for datasets with scalars also the first scalar of each point (0 for files without scalars)
+	void chunkLoaded(LineDataChunk chunk);
+
+	//! \brief emitted for each chunk of a dataset with scalars, before chunkLoaded() of the same chunk
+	//! \param scalarMin min scalar loaded so far
+	//! \param scalarMax max scalar loaded so far
+	void scalarRangeChanged(float scalarMin, float scalarMax);
+
+	//! \brief loading progress in percent
+	void progressChanged(int percent);
+
+	//! \brief emitted when loading is done, failed or was cancelled
+	//! \param success true if all files were loaded
+	//! \param message error message if not successful
+	void finished(bool success, QString message);
+
+private:
+
+	//! \brief try to load the line positions from the line cache instead of the .trk file
+	//! \return true if the cache was valid and loading is done (or was cancelled)
+	bool loadFromCache(const QString &cacheFilename);
+
+	//! \brief identifies the settings affecting the generated line positions, caches built with other settings are not used
+	quint64 getSettingsKey() const;
+
+	//! \brief determine the transform mapping track points of all sources into [-1,1] from the volume extents stored in the .trk headers
+	//! \return false if a header does not contain a valid volume
+	//!
+	//! this allows showing the first chunk immediately, without reading all tracks first.
+	bool computeNormalizationFromHeaders(const std::vector<QSharedPointer<TrackSource> > &sources);
+
+	//! \brief determine the transform mapping track points into [-1,1] from mean and bounds of all track points
+	//! \param positionStats stats of all track points in file coords
+	void computeNormalization(const PositionStats &positionStats);
+
+	QStringList filenames;
+	QAtomicInt cancelRequested;
+	bool useCache;
+	float resampleStep; //!< in track file units, 0 if disabled
+
+	// bounds of the normalized line positions loaded so far
+	glm::vec3 boundingBoxMin;
+	glm::vec3 boundingBoxMax;
+
+	// range of the scalars loaded so far
+	float scalarMin;
+	float scalarMax;
+
+	// normalized position = (swizzled file position - normalizationCenter) * normalizationScale
+	glm::vec3 normalizationCenter;
+	float normalizationScale;
+
+};
+
+#endif // TRKLOADER_H
@@ -0,0 +1,179 @@
+//! round trip test of the compressed track format (.trkz):
+//! compresses a .trk file at an error bound, decodes it again and checks that track and point numbers,
+//! scalars and properties match exactly and that no position is further off than the error bound.
+//! The same is done for a copy of the file with synthetic scalars and properties.
+//! Also reports the compression ratio and the time to read the tracks from both files.
+//!
+//! usage: trkz_roundtrip file.trk error_bound
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../src/libtrkfileio/trkfileio.h"
+#include "../src/libtrkfileio/trkzfileio.h"
+
+//! \brief all tracks of a file in the CSR layout of readTracks()
+struct Tracks
+{
+	std::vector<float> positions;
+	std::vector<int64_t> trackOffsets;
+	std::vector<float> scalars;
+	std::vector<float> properties;
+};
+
+static bool readTrk(const std::string &filename, Tracks &tracks, TrkFileHeader *header = nullptr)
+{
+	std::string path = filename;
+	TrkFileReader reader(path);
+	reader.setUseSidecarIndex(false);
+	if (!reader.openMapped() && !reader.open()) // like the loader does
+		return false;
+	if (header)
+		*header = reader.getHeader();
+	return reader.readTracks(0, reader.getTotalTrkNum(), tracks.positions, tracks.trackOffsets, &tracks.scalars, &tracks.properties);
+}
+
+static bool readTrkz(const std::string &filename, Tracks &tracks)
+{
+	std::string path = filename;
+	TrkzFileReader reader(path);
+	if (!reader.open())
+		return false;
+	return reader.readTracks(0, reader.getTotalTrkNum(), tracks.positions, tracks.trackOffsets, &tracks.scalars, &tracks.properties);
+}
+
+static long getFileSize(const std::string &filename)
+{
+	FILE *file = fopen(filename.c_str(), "rb");
+	if (!file)
+		return -1;
+	fseek(file, 0, SEEK_END);
+	long size = ftell(file);
+	fclose(file);
+	return size;
+}
+
+//! \brief best time of several runs in milliseconds, the files are in the page cache after the first one
+template<typename Function>
+static double getBestTime(Function function)
+{
+	double bestTime = 1e30;
+	for (int run = 0; run < 5; ++run) {
+		auto start = std::chrono::steady_clock::now();
+		function();
+		bestTime = std::min(bestTime, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	return bestTime;
+}
+
+//! \brief compress, decode and compare one file
+//! \return false if the decoded tracks do not match
+static bool testRoundTrip(const std::string &trkFilename, float errorBound)
+{
+	const std::string trkzFilename = "trkz_roundtrip.trkz";
+	float maxError = 0;
+	if (!compressTrkFile(trkFilename, trkzFilename, errorBound, &maxError)) {
+		printf("FAIL: could not compress %s\n", trkFilename.c_str());
+		return false;
+	}
+
+	Tracks original, decoded;
+	if (!readTrk(trkFilename, original) || !readTrkz(trkzFilename, decoded)) {
+		printf("FAIL: could not read %s or %s\n", trkFilename.c_str(), trkzFilename.c_str());
+		return false;
+	}
+
+	bool success = true;
+	if (decoded.trackOffsets != original.trackOffsets) {
+		printf("FAIL: track or point numbers differ (%zu tracks instead of %zu)\n", decoded.trackOffsets.size() - 1, original.trackOffsets.size() - 1);
+		success = false;
+	}
+	if (decoded.scalars != original.scalars || decoded.properties != original.properties) {
+		printf("FAIL: scalars or properties differ\n");
+		success = false;
+	}
+	double positionError = 0;
+	if (decoded.positions.size() != original.positions.size()) {
+		printf("FAIL: %zu coordinates instead of %zu\n", decoded.positions.size(), original.positions.size());
+		success = false;
+	} else {
+		for (size_t i = 0; i < original.positions.size(); ++i)
+			positionError = std::max(positionError, std::fabs(double(decoded.positions[i]) - original.positions[i]));
+	}
+	if (positionError > errorBound || maxError > errorBound) {
+		printf("FAIL: max position error %g, error bound %g, error reported by the writer %g\n", positionError, errorBound, maxError);
+		success = false;
+	}
+
+	// reading includes opening the files, both have no sidecar index
+	Tracks tracks;
+	const double trkTime = getBestTime([&]() { readTrk(trkFilename, tracks); });
+	const double trkzTime = getBestTime([&]() { readTrkz(trkzFilename, tracks); });
+	const long trkSize = getFileSize(trkFilename);
+	const long trkzSize = getFileSize(trkzFilename);
+	printf("%s: %zu tracks, %zu points, %zu scalars, %zu properties\n", trkFilename.c_str(), original.trackOffsets.size() - 1,
+		   original.positions.size() / 3, original.scalars.size(), original.properties.size());
+	printf("  error bound %g, max error %g, %ld -> %ld bytes (%.2fx), read .trk %.2f ms, read and decode .trkz %.2f ms\n",
+		   errorBound, positionError, trkSize, trkzSize, double(trkSize) / trkzSize, trkTime, trkzTime);
+
+	remove(trkzFilename.c_str());
+	return success;
+}
+
+//! \brief write a copy of a track file with 2 scalars per point and 3 properties per track
+static bool writeCopyWithScalars(const std::string &trkFilename, const std::string &copyFilename)
+{
+	Tracks tracks;
+	TrkFileHeader header;
+	if (!readTrk(trkFilename, tracks, &header))
+		return false;
+
+	const size_t numPoints = tracks.positions.size() / 3;
+	const size_t numTracks = tracks.trackOffsets.size() - 1;
+	std::vector<float> scalars(2 * numPoints);
+	for (size_t i = 0; i < numPoints; ++i) {
+		scalars[2 * i] = float(i) * 0.25f;
+		scalars[2 * i + 1] = std::sin(float(i));
+	}
+	std::vector<float> properties(3 * numTracks);
+	for (size_t i = 0; i < properties.size(); ++i)
+		properties[i] = float(i) / 7.0f;
+
+	header.n_scalars = 2;
+	header.n_properties = 3;
+	std::string path = copyFilename;
+	TrkFileWriter writer(path);
+	writer.copyHeader(header, true);
+	if (!writer.create() || !writer.appendTracks(tracks.positions, tracks.trackOffsets, scalars.data(), properties.data()))
+		return false;
+	writer.close();
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 3) {
+		printf("usage: %s file.trk error_bound\n", argv[0]);
+		return 2;
+	}
+	const std::string trkFilename = argv[1];
+	const float errorBound = float(atof(argv[2]));
+
+	bool success = testRoundTrip(trkFilename, errorBound);
+
+	const std::string copyFilename = "trkz_roundtrip_scalars.trk";
+	if (!writeCopyWithScalars(trkFilename, copyFilename)) {
+		printf("FAIL: could not write %s\n", copyFilename.c_str());
+		success = false;
+	} else {
+		success = testRoundTrip(copyFilename, errorBound) && success;
+		remove(copyFilename.c_str());
+	}
+
+	printf(success ? "PASS\n" : "FAIL\n");
+	return success ? 0 : 1;
+}